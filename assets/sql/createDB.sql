@@ -27,6 +27,38 @@ CREATE TABLE IF NOT EXISTS MessagesHistory (
     FOREIGN KEY (chat_id) REFERENCES Chat(id) ON DELETE CASCADE
 );
 
+CREATE INDEX IF NOT EXISTS idx_messages_chat_history
+    ON MessagesHistory(chat_id, id, sender_id, text);
+
+CREATE VIEW IF NOT EXISTS MessagesSearchContent AS
+    SELECT id, text, 'c' || chat_id AS chat FROM MessagesHistory;
+
+CREATE VIRTUAL TABLE IF NOT EXISTS MessagesSearch USING fts5(
+    text,
+    chat,
+    content = 'MessagesSearchContent',
+    content_rowid = 'id'
+);
+
+INSERT INTO MessagesSearch(MessagesSearch, rank) VALUES ('rank', 'bm25(1.0, 0.0)');
+
+CREATE TRIGGER IF NOT EXISTS messages_search_insert AFTER INSERT ON MessagesHistory BEGIN
+    INSERT INTO MessagesSearch(rowid, text, chat) 
+        VALUES (new.id, new.text, 'c' || new.chat_id);
+END;
+
+CREATE TRIGGER IF NOT EXISTS messages_search_delete AFTER DELETE ON MessagesHistory BEGIN
+    INSERT INTO MessagesSearch(MessagesSearch, rowid, text, chat) 
+        VALUES ('delete', old.id, old.text, 'c' || old.chat_id);
+END;
+
+CREATE TRIGGER IF NOT EXISTS messages_search_update AFTER UPDATE OF text, chat_id ON MessagesHistory BEGIN
+    INSERT INTO MessagesSearch(MessagesSearch, rowid, text, chat) 
+        VALUES ('delete', old.id, old.text, 'c' || old.chat_id);
+    INSERT INTO MessagesSearch(rowid, text, chat) 
+        VALUES (new.id, new.text, 'c' || new.chat_id);
+END;
+
 CREATE TABLE IF NOT EXISTS ChatMembers (
     id INTEGER PRIMARY KEY AUTOINCREMENT,
     chat_id INTEGER NOT NULL,
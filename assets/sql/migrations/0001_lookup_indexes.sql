@@ -0,0 +1,8 @@
+CREATE INDEX IF NOT EXISTS idx_chat_members_chat
+    ON ChatMembers(chat_id, user_id);
+
+CREATE INDEX IF NOT EXISTS idx_chat_members_user
+    ON ChatMembers(user_id, chat_id);
+
+CREATE INDEX IF NOT EXISTS idx_messages_chat_history
+    ON MessagesHistory(chat_id, id, sender_id, text);
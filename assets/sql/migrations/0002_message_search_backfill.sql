@@ -0,0 +1,2 @@
+-- сообщения, сохранённые до появления MessagesSearch
+INSERT INTO MessagesSearch(MessagesSearch) VALUES ('rebuild');
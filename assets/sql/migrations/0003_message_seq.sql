@@ -0,0 +1,19 @@
+-- seq - номер сообщения в чате, старые сообщения нумеруются по id.
+-- DEFAULT только для ADD COLUMN: новые сообщения всегда вставляются с seq
+ALTER TABLE MessagesHistory ADD COLUMN seq INTEGER NOT NULL DEFAULT 0;
+
+UPDATE MessagesHistory SET seq = numbered.seq
+    FROM (
+        SELECT id, ROW_NUMBER() OVER (PARTITION BY chat_id ORDER BY id) AS seq 
+        FROM MessagesHistory
+    ) AS numbered
+    WHERE MessagesHistory.id = numbered.id;
+
+-- страницы истории и RESYNC читают seq из индекса, без обращения к таблице
+DROP INDEX IF EXISTS idx_messages_chat_history;
+
+CREATE INDEX idx_messages_chat_history
+    ON MessagesHistory(chat_id, id, seq, sender_id, text);
+
+CREATE UNIQUE INDEX idx_messages_chat_seq
+    ON MessagesHistory(chat_id, seq);
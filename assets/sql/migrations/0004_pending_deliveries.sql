@@ -0,0 +1,17 @@
+-- кадры для получателей не в сети, по порядку id. seq > 0 - сообщение чата,
+-- удаляется подтверждением клиента, seq = 0 - удаляется сразу после отправки
+CREATE TABLE IF NOT EXISTS PendingDeliveries (
+    id INTEGER PRIMARY KEY AUTOINCREMENT,
+    user_id INTEGER NOT NULL,
+    chat_id INTEGER NOT NULL DEFAULT 0,
+    seq INTEGER NOT NULL DEFAULT 0,
+    frame BLOB NOT NULL,
+    FOREIGN KEY (user_id) REFERENCES User(id)
+);
+
+-- выборка очереди: user_id, затем rowid
+CREATE INDEX IF NOT EXISTS idx_pending_deliveries_user
+    ON PendingDeliveries(user_id);
+
+CREATE INDEX IF NOT EXISTS idx_pending_deliveries_ack
+    ON PendingDeliveries(user_id, chat_id, seq);
@@ -0,0 +1,35 @@
+-- непрочитанное пользователя в чате: read_seq - докуда прочитано, last_seq - 
+-- последнее учтённое сообщение. Обновляется пачками сервера, а не на каждую вставку
+CREATE TABLE IF NOT EXISTS UnreadCounters (
+    user_id INTEGER NOT NULL,
+    chat_id INTEGER NOT NULL,
+    unread INTEGER NOT NULL DEFAULT 0,
+    read_seq INTEGER NOT NULL DEFAULT 0,
+    last_seq INTEGER NOT NULL DEFAULT 0,
+    PRIMARY KEY (user_id, chat_id),
+    FOREIGN KEY (user_id) REFERENCES User(id),
+    FOREIGN KEY (chat_id) REFERENCES Chat(id) ON DELETE CASCADE
+) WITHOUT ROWID;
+
+-- новые сообщения чата увеличивают счётчики всех его участников
+CREATE INDEX IF NOT EXISTS idx_unread_counters_chat
+    ON UnreadCounters(chat_id);
+
+CREATE TRIGGER IF NOT EXISTS unread_counters_member AFTER INSERT ON ChatMembers BEGIN
+    INSERT OR IGNORE INTO UnreadCounters(user_id, chat_id) VALUES (new.user_id, new.chat_id);
+END;
+
+-- уже существующие чаты: прочитано всё до последнего своего или отмеченного сообщения
+INSERT OR IGNORE INTO UnreadCounters(user_id, chat_id, read_seq, last_seq)
+    SELECT m.user_id, m.chat_id,
+        IFNULL((SELECT MAX(h.seq) FROM MessagesHistory h 
+            WHERE h.chat_id = m.chat_id AND (h.sender_id = m.user_id OR h.is_read = 1)), 0),
+        IFNULL((SELECT MAX(h.seq) FROM MessagesHistory h WHERE h.chat_id = m.chat_id), 0)
+    FROM ChatMembers m;
+
+UPDATE UnreadCounters SET unread = (
+    SELECT COUNT(*) FROM MessagesHistory h 
+    WHERE h.chat_id = UnreadCounters.chat_id 
+        AND h.seq > UnreadCounters.read_seq 
+        AND h.sender_id != UnreadCounters.user_id
+);
@@ -0,0 +1,135 @@
+#include "db/db.hpp"
+#include "db/message_store.hpp"
+#include "db/segmented_log_store.hpp"
+#include "chat/chat.hpp"
+#include "usr/user.hpp"
+#include "message/message.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/// Сравнение MessagesHistory и сегментированного лога: запись пачками
+/// и чтение страниц истории. Аргументы: сообщений, чатов, размер пачки
+/// ./message_store_bench 200000 100 512
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct BenchOptions {
+        size_t messages = 200000;
+        size_t chats = 100;
+        size_t batch = 512;
+        size_t pages = 2000;
+    };
+
+    struct BenchResult {
+        double writesPerSecond;
+        double firstPageMicros;
+        double olderPageMicros;
+    };
+
+    double seconds(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    BenchResult run(MessageStore& store, const std::vector<ID_t>& chatIDs, const BenchOptions& options) {
+        std::string text(64, 'x');
+
+        auto start = Clock::now();
+        std::vector<Message> batch;
+        batch.reserve(options.batch);
+        for (size_t i = 0; i < options.messages; ++i) {
+            batch.emplace_back(chatIDs[i % chatIDs.size()], 1, text);
+            if (batch.size() == options.batch || i + 1 == options.messages) {
+                store.saveBatch(batch);
+                batch.clear();
+            }
+        }
+        double writeTime = seconds(start);
+
+        std::mt19937 random(42);
+        std::uniform_int_distribution<size_t> pick(0, chatIDs.size() - 1);
+
+        double firstPage = 0;
+        double olderPage = 0;
+        for (size_t i = 0; i < options.pages; ++i) {
+            ID_t chatID = chatIDs[pick(random)];
+
+            start = Clock::now();
+            auto page = store.fetchHistory(chatID, std::numeric_limits<ID_t>::max(), HISTORY_PAGE_SIZE);
+            firstPage += seconds(start);
+
+            if (page.empty()) continue;
+            start = Clock::now();
+            store.fetchHistory(chatID, *page.back().getID(), HISTORY_PAGE_SIZE);
+            olderPage += seconds(start);
+        }
+
+        return BenchResult{
+            options.messages / writeTime,
+            firstPage * 1e6 / options.pages,
+            olderPage * 1e6 / options.pages
+        };
+    }
+
+    void print(const std::string& name, const BenchResult& result) {
+        std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << result.writesPerSecond
+                  << std::setw(16) << result.firstPageMicros
+                  << std::setw(16) << result.olderPageMicros << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (argc > 1) options.messages = std::stoul(argv[1]);
+    if (argc > 2) options.chats = std::max<size_t>(1, std::stoul(argv[2]));
+    if (argc > 3) options.batch = std::max<size_t>(1, std::stoul(argv[3]));
+
+    auto dir = std::filesystem::temp_directory_path() / "consolet_message_store_bench";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    auto db = std::make_shared<DB>();
+    db->init((dir / "bench.db").string(), std::string(PROJECT_SOURCE_DIR) + "/assets/sql/createDB.sql");
+
+    std::vector<User> users;
+    users.emplace_back("bench_alice", "password");
+    users.emplace_back("bench_bob", "password");
+    for (User& user : users) db->save(user);
+
+    /// у SQLite внешний ключ на Chats, лог пишем в те же ID чатов
+    std::vector<ID_t> chatIDs;
+    for (size_t i = 0; i < options.chats; ++i) {
+        Chat chat(db, users, ChatType::Type::GROUP, "bench " + std::to_string(i));
+        db->save(chat);
+        chatIDs.push_back(*chat.getID());
+    }
+
+    std::cout << options.messages << " messages, " << options.chats << " chats, batches of "
+              << options.batch << ", durability NORMAL\n";
+    std::cout << std::left << std::setw(12) << "backend" << std::right
+              << std::setw(14) << "writes/s"
+              << std::setw(16) << "page, us"
+              << std::setw(16) << "older page, us" << "\n";
+
+    {
+        SQLiteMessageStore store(db, Durability::NORMAL);
+        print("sqlite", run(store, chatIDs, options));
+    }
+    {
+        SegmentedLogStore store(dir / "log");
+        print("log", run(store, chatIDs, options));
+    }
+
+    db.reset();
+    std::filesystem::remove_all(dir);
+    return 0;
+}
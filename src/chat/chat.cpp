@@ -1,5 +1,6 @@
 #include "chat.hpp"
 #include "user.hpp"
+#include "message.hpp"
 
 #include <algorithm>
 
@@ -56,14 +57,10 @@ Chat::Chat(
     if (type == ChatType::Type::PERSONAL && userIDs.size() != 2) 
         throw std::invalid_argument(std::string("Personal chat has no ") + std::to_string(userIDs.size()) + " != 2 users");
 
-    std::for_each(userIDs.begin(), userIDs.end(), [this] (ID_t& userID)
-    {
-        auto user = db_->findUser(userID);
-        if (!user) {
-            std::cout << "User is not saved in DB" << std::endl;
-            db_->save(*user);
-        }
-    });
+    /// один запрос на всех участников вместо findUser() на каждого
+    if (db_->findUsers(userIDs).size() != userIDs.size()) {
+        std::cout << "User is not saved in DB" << std::endl;
+    }
 }
 
 void Chat::sendMessage(const std::string& message, ID_t senderId) {
@@ -75,10 +72,8 @@ void Chat::receiveMessage(const std::string& message, ID_t receiverId) {
 }
 
 void Chat::addMessage(const std::string& message, ID_t senderId) {
-    db_->execute(
-        "INSERT INTO MessagesHistory (sender_id, chat_id, text) VALUES (?, ?, ?);",
-        senderId, chatID_, message
-    );
+    /// seq чата назначает DB::save()
+    db_->save(Message(*chatID_, senderId, message));
 }
 
 // bool Chat::operator==(const Chat& other) const {
@@ -46,6 +46,7 @@ public:
     ChatType::Type getType() const { return type_.getType(); }
     std::optional<std::string> getName() const { return name_; }
     std::optional<ID_t> getID() const { return chatID_; }
+    const std::vector<ID_t>& getUserIDs() const { return userIDs_; }
 
     bool operator==(const Chat& other) const = default;
 };
@@ -1,120 +1,222 @@
-#include "client.hpp"
-
-Connection::Connection(const std::string& server_ip_address, const std::string& server_port) 
-    : 
-        ip_address(server_ip_address), 
-        port(server_port)
-    {  
-        init();
-    }
-
-Connection::~Connection() {
-    freeaddrinfo(client_info);
-    close(socket_fd);
-}
-
-void Connection::init() {
-    struct addrinfo hints;
-    memset(&hints, 0, sizeof(hints));
-
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
-
-
-    int status;
-    if ((status = getaddrinfo(ip_address.c_str(), port.c_str(), &hints, &client_info)) != 0) {
-        std::cerr << "getaddrinfo error: %s\n", gai_strerror(status);
-        std::flush(std::cerr);
-
-        stop();
-    }
-    
-    
-}
-
-void Connection::connect() {
-    struct addrinfo * p;
-    for (p = client_info; p != NULL; p = p->ai_next) {
-        if ((socket_fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) == -1) {
-            std::perror("client socket error");
-            continue;
-        }
-
-        if (::connect(socket_fd, p->ai_addr, p->ai_addrlen) == -1) {
-            std::perror("connecting error");
-            continue;
-        }
-        break;
-    }
-
-    if (p == NULL) {
-        std::cerr << "server: failed to connect\n";
-        std::exit(2);
-    }
-
-    char server_ip[SIZE];
-    inet_ntop(
-        p->ai_family, 
-        &(((struct sockaddr_in *)p->ai_addr)->sin_addr), 
-        server_ip,
-        sizeof(server_ip)
-    );
-    std::cout << "client: connecting to " << server_ip << std::endl;;
-}
-
-void Connection::start() {
-    connect();
-
-    std::thread send_thread([&] () {
-        while (is_active) {
-            std::cout << "Enter message to server: \n";
-            std::getline(std::cin, message);
-            send();
-        }
-    });
-
-    std::thread recv_thread([&] () {
-        while (is_active) {
-            recieve();
-            printMsg();
-        }
-    });
-        
-    if (send_thread.joinable()) send_thread.join();
-    if (recv_thread.joinable()) recv_thread.join();
-}
-
-void Connection::stop() {
-    is_active = false;
-}
-
-void Connection::recieve() {
-    std::fill(recv_buf.begin(), recv_buf.end(), 0);
-    
-    if ((recv_len = ::recv(socket_fd, recv_buf.data(), SIZE, 0)) == -1) {
-        std::cerr << "client recieve error\n";
-        stop();
-    }
-    else if (recv_len == 0) {
-        std::cout << "The connection was closed by server\n";
-        stop();
-    }
-}
-
-void Connection::send() {
-    int sent_len = 0; 
-    
-    if ((sent_len = ::send(socket_fd, message.c_str(), strlen(message.c_str()), 0)) == -1) {
-        std::cerr << "Client sending error\n";
-        stop();
-    }
-
-}
-
-void Connection::printMsg() {
-    std::cout << "Client recieved message: ";
-    for (size_t i = 0; i < recv_len; ++i) {
-        printf("%c", recv_buf[i]);
-    }
-    printf("\n");
-}
+#include "client.hpp"
+
+#include <errno.h>
+#include <sstream>
+
+Connection::Connection(const std::string& server_ip_address, const std::string& server_port) 
+    : 
+        ip_address(server_ip_address), 
+        port(server_port)
+    {  
+        init();
+    }
+
+Connection::~Connection() {
+    freeaddrinfo(client_info);
+    close(socket_fd);
+}
+
+void Connection::init() {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+
+    int status;
+    if ((status = getaddrinfo(ip_address.c_str(), port.c_str(), &hints, &client_info)) != 0) {
+        std::cerr << "getaddrinfo error: %s\n", gai_strerror(status);
+        std::flush(std::cerr);
+
+        stop();
+    }
+    
+    
+}
+
+void Connection::connect() {
+    struct addrinfo * p;
+    for (p = client_info; p != NULL; p = p->ai_next) {
+        if ((socket_fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) == -1) {
+            std::perror("client socket error");
+            continue;
+        }
+
+        if (::connect(socket_fd, p->ai_addr, p->ai_addrlen) == -1) {
+            std::perror("connecting error");
+            continue;
+        }
+        break;
+    }
+
+    if (p == NULL) {
+        std::cerr << "server: failed to connect\n";
+        std::exit(2);
+    }
+
+    char server_ip[SIZE];
+    inet_ntop(
+        p->ai_family, 
+        &(((struct sockaddr_in *)p->ai_addr)->sin_addr), 
+        server_ip,
+        sizeof(server_ip)
+    );
+    std::cout << "client: connecting to " << server_ip << std::endl;;
+
+    /// без PING от сервера дольше таймаута соединение считается мёртвым
+    struct timeval timeout{SERVER_TIMEOUT_SEC, 0};
+    setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+void Connection::start() {
+    std::thread send_thread([&] () {
+        while (is_active) {
+            std::cout << "Enter message to server: \n";
+            if (!std::getline(std::cin, message)) {
+                stop();
+                shutdown(socket_fd, SHUT_RDWR);
+                break;
+            }
+            if (!message.empty()) send();
+        }
+    });
+
+    std::thread recv_thread([&] () {
+        while (is_active) {
+            recieve();
+
+            while (auto frame = parser.next()) {
+                if (frame->header.type == FrameType::PING) {
+                    sendFrame(encodeFrame(FrameType::PONG, ""));
+                    continue;
+                }
+                printMsg(*frame);
+            }
+            if (parser.hasError()) {
+                std::cerr << "Protocol error: too long frame from server\n";
+                stop();
+            }
+        }
+    });
+        
+    if (send_thread.joinable()) send_thread.join();
+    if (recv_thread.joinable()) recv_thread.join();
+}
+
+void Connection::stop() {
+    is_active = false;
+}
+
+void Connection::recieve() {
+    auto buf = parser.prepare(SIZE);
+    ssize_t recv_len = ::recv(socket_fd, buf.data(), buf.size(), 0);
+    
+    if (recv_len == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            std::cerr << "Server is not responding\n";
+        }
+        else {
+            std::cerr << "client recieve error\n";
+        }
+        stop();
+    }
+    else if (recv_len == 0) {
+        std::cout << "The connection was closed by server\n";
+        stop();
+    }
+    else {
+        parser.commit(static_cast<size_t>(recv_len));
+    }
+}
+
+void Connection::send() {
+    /// /resync chat_id seq и /read chat_id seq - не команды сервера, а отдельные кадры
+    bool resync = message.rfind("/resync ", 0) == 0;
+    if (resync || message.rfind("/read ", 0) == 0) {
+        std::istringstream input{message.substr(message.find(' ') + 1)};
+        ID_t chatID = 0;
+        uint64_t seq = 0;
+        if (!(input >> chatID >> seq)) {
+            std::cout << (resync ? "Usage: /resync chat_id last_seq" : "Usage: /read chat_id seq") << std::endl;
+            return;
+        }
+        sendFrame(encodeFrame(resync ? FrameType::RESYNC : FrameType::READ, "", chatID, 0, seq));
+        return;
+    }
+
+    /// /to chat_id text - сообщение в чат, где пользователь участник
+    if (message.rfind("/to ", 0) == 0) {
+        std::istringstream input{message.substr(4)};
+        ID_t chatID = 0;
+        std::string text;
+        if (!(input >> chatID) || !std::getline(input >> std::ws, text) || text.empty()) {
+            std::cout << "Usage: /to chat_id message" << std::endl;
+            return;
+        }
+        sendFrame(encodeFrame(FrameType::MESSAGE, text, chatID));
+        return;
+    }
+
+    FrameType type = (message.front() == '/') ? FrameType::COMMAND : FrameType::MESSAGE;
+    sendFrame(encodeFrame(type, message));
+}
+
+bool Connection::sendFrame(const std::string& frame) {
+    std::scoped_lock lock(send_mtx);
+    size_t sent = 0;
+
+    while (sent < frame.size()) {
+        ssize_t sent_len = ::send(socket_fd, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+        
+        if (sent_len == -1) {
+            if (errno == EINTR) continue;
+
+            std::cerr << "Client sending error\n";
+            stop();
+            return false;
+        }
+        sent += static_cast<size_t>(sent_len);
+    }
+    return true;
+}
+
+void Connection::printMsg(const FrameView& frame) {
+    switch (frame.header.type) {
+    case FrameType::AUTH_OK:
+        std::cout << "Logged in as " << frame.payload << std::endl;
+        break;
+    case FrameType::AUTH_FAIL:
+        std::cout << "Login failed: " << frame.payload << std::endl;
+        break;
+    case FrameType::NOTICE:
+        std::cout << "server: " << frame.payload << std::endl;
+        break;
+    case FrameType::MESSAGE:
+        std::cout << "[chat " << frame.header.chatID << "] user " 
+                  << frame.header.senderID << ": " << frame.payload << std::endl;
+        /// пришло из офлайн-очереди: подтверждаем, иначе придёт снова при следующем входе
+        if (frame.header.flags & MESSAGE_QUEUED) {
+            sendFrame(encodeFrame(FrameType::ACK, "", frame.header.chatID, 0, frame.header.seq));
+        }
+        break;
+    case FrameType::DELTA: {
+        std::vector<DeltaEntry> entries;
+        if (!decodeDelta(frame.payload, entries)) {
+            std::cerr << "Malformed delta of chat " << frame.header.chatID << std::endl;
+            break;
+        }
+        for (const DeltaEntry& entry : entries) {
+            std::cout << "[chat " << frame.header.chatID << " #" << entry.seq << "] user " 
+                      << entry.senderID << ": " << entry.text << std::endl;
+        }
+        if (frame.header.flags & DELTA_TRUNCATED) {
+            std::cout << "More: /resync " << frame.header.chatID << " " << frame.header.seq << std::endl;
+        }
+        break;
+    }
+    default:
+        std::cout << "Client recieved message: " << frame.payload << std::endl;
+        break;
+    }
+}
@@ -16,8 +16,11 @@
 #include <termios.h>
 
 #include "user.hpp"
+#include "frame_parser.hpp"
 
 #define SIZE 4096
+/// сервер шлёт PING каждые 30 секунд тишины
+#define SERVER_TIMEOUT_SEC 90
 
 
 class Connection {
@@ -26,12 +29,13 @@ class Connection {
     std::string ip_address;
     std::string port;
 
-    std::vector<char> recv_buf = std::vector<char>(SIZE);
-    int recv_len;
+    FrameParser parser;
     
     std::string message;
     std::atomic<bool> is_active{true};
 
+    std::mutex send_mtx; // кадры из потока отправки и PONG не должны перемешаться
+
 public:
     Connection(
         const std::string& server_ip_address, 
@@ -47,7 +51,10 @@ public:
     void recieve();
     void send();
 
-    void printMsg();
+    /// @brief Sends the whole encoded frame, retrying partial writes
+    bool sendFrame(const std::string& frame);
+
+    void printMsg(const FrameView& frame);
 };
 
 
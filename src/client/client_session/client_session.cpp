@@ -5,9 +5,6 @@ ClientSession::ClientSession(const std::string& ip_address, const std::string& p
 }
 
 void ClientSession::auth() {
-    std::string login;
-    std::string password;
-
     std::cout << "Enter login: \n";
     std::getline(std::cin, login);
 
@@ -19,6 +16,13 @@ void ClientSession::auth() {
 
 
 void ClientSession::start() {
+    client->connect();
+
+    std::string credentials = login;
+    credentials.push_back('\0');
+    credentials += password;
+    client->sendFrame(encodeFrame(FrameType::AUTH, credentials));
+
     client->start();
 }
 
@@ -8,6 +8,9 @@
 class ClientSession {
     std::unique_ptr<User> user;
     std::unique_ptr<Connection> client;
+
+    std::string login;
+    std::string password;
     
 public:
     ClientSession(
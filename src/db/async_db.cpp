@@ -0,0 +1,103 @@
+#include "async_db.hpp"
+
+#include <algorithm>
+
+AsyncDB::AsyncDB(std::shared_ptr<DB> db, size_t threads) 
+    : 
+        db_(std::move(db)),
+        workers_(threads ? threads : db_->readersCount() + 1)
+{}
+
+AsyncDB::~AsyncDB() {
+    /// задачи держат this - дожидаемся их до разрушения счётчиков
+    workers_.stop();
+}
+
+std::future<std::optional<User> > AsyncDB::findUserAsync(std::string name) {
+    return submit([name = std::move(name)] (DB& db) { return db.findUser(name); });
+}
+
+std::future<std::optional<User> > AsyncDB::findUserAsync(ID_t id) {
+    return submit([id] (DB& db) { return db.findUser(id); });
+}
+
+std::future<std::optional<ID_t> > AsyncDB::saveAsync(User user) {
+    return submit([user = std::move(user)] (DB& db) mutable -> std::optional<ID_t> {
+        if (!db.save(user)) return std::nullopt;
+        return user.getID();
+    });
+}
+
+std::future<std::optional<ID_t> > AsyncDB::saveAsync(Message message) {
+    return submit([message = std::move(message)] (DB& db) mutable -> std::optional<ID_t> {
+        if (!db.save(message)) return std::nullopt;
+        return message.getID();
+    });
+}
+
+std::future<std::optional<ID_t> > AsyncDB::findPersonalChatIDAsync(ID_t firstUserID, ID_t secondUserID) {
+    return submit([firstUserID, secondUserID] (DB& db) {
+        return db.findPersonalChatID(firstUserID, secondUserID);
+    });
+}
+
+std::future<std::vector<Message> > AsyncDB::fetchHistoryAsync(ID_t chatID, ID_t beforeID, size_t limit) {
+    return submit([=] (DB& db) { return db.fetchHistory(chatID, beforeID, limit); });
+}
+
+std::future<std::vector<Message> > AsyncDB::fetchSinceAsync(ID_t chatID, ID_t afterID, size_t limit) {
+    return submit([=] (DB& db) { return db.fetchSince(chatID, afterID, limit); });
+}
+
+std::future<std::vector<SearchResult> > AsyncDB::searchMessagesAsync(
+    ID_t chatID, 
+    std::string query, 
+    size_t limit
+) {
+    return submit([=, query = std::move(query)] (DB& db) { 
+        return db.searchMessages(chatID, query, limit); 
+    });
+}
+
+AsyncDBMetrics AsyncDB::metrics() const {
+    AsyncDBMetrics metrics;
+    metrics.queueDepth = queued_.load();
+    metrics.peakQueueDepth = peakQueued_.load();
+    metrics.completed = completed_.load();
+
+    if (metrics.completed > 0) {
+        metrics.avgWait = std::chrono::microseconds(waitMicros_.load() / metrics.completed);
+        metrics.avgExecute = std::chrono::microseconds(executeMicros_.load() / metrics.completed);
+    }
+    metrics.maxExecute = std::chrono::microseconds(maxExecuteMicros_.load());
+
+    return metrics;
+}
+
+void AsyncDB::onQueued() {
+    size_t depth = queued_.fetch_add(1) + 1;
+
+    size_t peak = peakQueued_.load();
+    while (depth > peak && !peakQueued_.compare_exchange_weak(peak, depth)) {}
+}
+
+AsyncDB::Clock::time_point AsyncDB::onStarted() {
+    queued_.fetch_sub(1);
+    return Clock::now();
+}
+
+void AsyncDB::onDone(Clock::time_point queued, Clock::time_point started) {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+
+    auto finished = Clock::now();
+    uint64_t wait = duration_cast<microseconds>(started - queued).count();
+    uint64_t execute = duration_cast<microseconds>(finished - started).count();
+
+    completed_.fetch_add(1);
+    waitMicros_.fetch_add(wait);
+    executeMicros_.fetch_add(execute);
+
+    uint64_t peak = maxExecuteMicros_.load();
+    while (execute > peak && !maxExecuteMicros_.compare_exchange_weak(peak, execute)) {}
+}
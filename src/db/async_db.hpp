@@ -0,0 +1,148 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "db.hpp"
+#include "exec/executor.hpp"
+#include "exec/offload.hpp"
+#include "message/message.hpp"
+#include "usr/user.hpp"
+
+struct AsyncDBMetrics {
+    size_t queueDepth = 0;       // поставлено, но ещё не начато
+    size_t peakQueueDepth = 0;
+    uint64_t completed = 0;
+    std::chrono::microseconds avgWait{0};    // в очереди
+    std::chrono::microseconds avgExecute{0}; // на потоке БД
+    std::chrono::microseconds maxExecute{0};
+};
+
+/// @brief Runs the callback once after the delay, e.g. on a reactor's TimerWheel.
+/// Write-behind buffers (DeliveryQueue, UnreadTracker) debounce their flushes with it
+using FlushTimer = std::function<void(std::chrono::milliseconds, std::function<void()>)>;
+
+/// @brief Asynchronous facade over DB: queries run on dedicated DB threads,
+/// results come back as std::future or, inside a coroutine, through co_await async()
+class AsyncDB {
+    using Clock = std::chrono::steady_clock;
+
+    std::shared_ptr<DB> db_;
+    Executor workers_;
+
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> peakQueued_{0};
+    std::atomic<uint64_t> completed_{0};
+    std::atomic<uint64_t> waitMicros_{0};
+    std::atomic<uint64_t> executeMicros_{0};
+    std::atomic<uint64_t> maxExecuteMicros_{0};
+
+public:
+    /// @brief threads: по одному на читающее соединение и писателя
+    explicit AsyncDB(std::shared_ptr<DB> db, size_t threads = 0);
+    ~AsyncDB();
+
+    AsyncDB(const AsyncDB& other) = delete;
+    AsyncDB& operator=(const AsyncDB& other) = delete;
+
+    /// @brief Runs fn(DB&) on a DB thread
+    template <typename Fn>
+    auto submit(Fn&& fn) -> std::future<std::invoke_result_t<Fn&, DB&> >;
+
+    /// @brief co_await db.async(home, fn): fn(DB&) runs on a DB thread, 
+    /// the coroutine resumes on the thread of home (see Offload)
+    template <typename Home, typename Fn>
+    auto async(Home& home, Fn&& fn);
+
+    std::future<std::optional<User> > findUserAsync(std::string name);
+    std::future<std::optional<User> > findUserAsync(ID_t id);
+
+    /// @brief ID of the saved user or message, std::nullopt on failure
+    std::future<std::optional<ID_t> > saveAsync(User user);
+    std::future<std::optional<ID_t> > saveAsync(Message message);
+
+    std::future<std::optional<ID_t> > findPersonalChatIDAsync(ID_t firstUserID, ID_t secondUserID);
+
+    std::future<std::vector<Message> > fetchHistoryAsync(
+        ID_t chatID, 
+        ID_t beforeID = std::numeric_limits<ID_t>::max(), 
+        size_t limit = HISTORY_PAGE_SIZE
+    );
+    std::future<std::vector<Message> > fetchSinceAsync(ID_t chatID, ID_t afterID, size_t limit = HISTORY_PAGE_SIZE);
+    std::future<std::vector<SearchResult> > searchMessagesAsync(
+        ID_t chatID, 
+        std::string query, 
+        size_t limit = SEARCH_LIMIT
+    );
+
+    AsyncDBMetrics metrics() const;
+
+    DB& sync() { return *db_; }
+
+private:
+    /// @brief fn(DB&) with the queue and latency accounting around it
+    template <typename Fn>
+    auto measured(Fn&& fn);
+
+    void onQueued();
+    Clock::time_point onStarted();
+    void onDone(Clock::time_point queued, Clock::time_point started);
+};
+
+
+template <typename Fn>
+auto AsyncDB::measured(Fn&& fn) {
+    onQueued();
+    return [this, fn = std::forward<Fn>(fn), queued = Clock::now()] () mutable {
+        auto started = onStarted();
+        /// метрики обновляются и при исключении
+        struct Done {
+            AsyncDB* self; 
+            Clock::time_point queued; 
+            Clock::time_point started;
+            ~Done() { self->onDone(queued, started); }
+        } done{this, queued, started};
+
+        return fn(*db_);
+    };
+}
+
+template <typename Fn>
+auto AsyncDB::submit(Fn&& fn) -> std::future<std::invoke_result_t<Fn&, DB&> > {
+    using Result = std::invoke_result_t<Fn&, DB&>;
+
+    auto promise = std::make_shared<std::promise<Result> >();
+    auto result = promise->get_future();
+
+    /// std::function требует копируемости, а fn может быть только перемещаемым
+    auto job = measured(std::forward<Fn>(fn));
+    auto shared = std::make_shared<decltype(job)>(std::move(job));
+
+    workers_.submit([promise, shared] () {
+        try {
+            if constexpr (std::is_void_v<Result>) {
+                (*shared)();
+                promise->set_value();
+            }
+            else {
+                promise->set_value((*shared)());
+            }
+        }
+        catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return result;
+}
+
+template <typename Home, typename Fn>
+auto AsyncDB::async(Home& home, Fn&& fn) {
+    return offload(workers_, home, measured(std::forward<Fn>(fn)));
+}
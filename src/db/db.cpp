@@ -5,11 +5,18 @@
 
 #include <array>
 #include <iterator>
+#include <filesystem>
 #include <functional>
 #include <fstream>
+#include <map>
 #include <sstream>
+#include <unordered_map>
 
 DB::~DB() {
+    closeReaders();
+
+    /// sqlite3_close() не закроет соединение с живыми prepared statements
+    statements_.clear();
     int res = sqlite3_close(db_);
     if (res != SQLITE_OK) {
         std::cerr << "SQLite3 close error" << std::endl;
@@ -17,12 +24,20 @@ DB::~DB() {
     db_ = nullptr;
 }
 
-DB::DB(DB&& other) noexcept : db_(other.db_) {
+DB::DB(DB&& other) noexcept 
+    : 
+        db_(other.db_), 
+        statements_(std::move(other.statements_)), 
+        readers_(std::move(other.readers_)),
+        cache_(std::move(other.cache_))
+{
     other.db_ = nullptr;
 }
 
 DB& DB::operator=(DB&& other) noexcept {
     if (this != &other) {
+        closeReaders();
+        statements_.clear();
         if (db_) {
             int res = sqlite3_close(db_);
             if (res != SQLITE_OK) {
@@ -31,15 +46,100 @@ DB& DB::operator=(DB&& other) noexcept {
         }
         
         db_ = other.db_;
+        statements_ = std::move(other.statements_);
+        readers_ = std::move(other.readers_);
+        cache_ = std::move(other.cache_);
         other.db_ = nullptr;
     }
     return *this;
 }
 
-void DB::init(const std::string& db_name, const std::string& sqlFile) {
+void DB::init(const std::string& db_name, const std::string& sqlFile, const DBOptions& options) {
     std::vector<std::string> sql = readSqlQuery(sqlFile);
 
     createDB(db_name, sql);
+
+    cache_.reset();
+    if (options.entityCacheCapacity > 0) {
+        cache_ = std::make_unique<EntityCache>(options.entityCacheCapacity);
+    }
+
+    bool pooled = options.readers > 0;
+
+    /// у каждого соединения с ":memory:" своя пустая база
+    if (pooled && (db_name.empty() || db_name.find(":memory:") != std::string::npos)) {
+        std::cerr << "DB: in-memory database, connection pool is disabled\n";
+        pooled = false;
+    }
+
+    if (pooled) configureWriter(options);
+
+    if (!options.migrations.empty()) {
+        migrate(options.migrations);
+    }
+
+    /// читатели открываются по уже мигрированной схеме
+    if (pooled) openReaders(db_name, options);
+}
+
+void DB::configureWriter(const DBOptions& options) {
+    sqlite3_busy_timeout(db_, options.busyTimeoutMs);
+
+    /// читатели WAL не блокируют писателя и друг друга
+    execute("PRAGMA journal_mode = WAL;");
+    execute("PRAGMA synchronous = " + options.synchronous + ";");
+    execute("PRAGMA mmap_size = " + std::to_string(options.mmapSize) + ";");
+}
+
+void DB::openReaders(const std::string& db_name, const DBOptions& options) {
+    readers_.reserve(options.readers);
+
+    for (size_t i = 0; i < options.readers; ++i) {
+        auto reader = std::make_unique<ReaderConnection>();
+
+        /// NOMUTEX: доступ к соединению и так под reader->mutex
+        int flags = SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX;
+        if (sqlite3_open_v2(db_name.c_str(), &reader->db, flags, nullptr) != SQLITE_OK) {
+            std::cerr << "Error: cannot open reader connection: " << sqlite3_errmsg(reader->db) << std::endl;
+            sqlite3_close(reader->db);
+            closeReaders();
+            throw std::logic_error("Failed to open reader connection");
+        }
+
+        sqlite3_busy_timeout(reader->db, options.busyTimeoutMs);
+        std::string mmap = "PRAGMA mmap_size = " + std::to_string(options.mmapSize) + ";";
+        sqlite3_exec(reader->db, mmap.c_str(), nullptr, nullptr, nullptr);
+
+        reader->statements.attach(reader->db);
+        readers_.emplace_back(std::move(reader));
+    }
+}
+
+void DB::closeReaders() {
+    for (auto& reader : readers_) {
+        reader->statements.clear();
+        if (sqlite3_close(reader->db) != SQLITE_OK) {
+            std::cerr << "SQLite3 close error" << std::endl;
+        }
+    }
+    readers_.clear();
+}
+
+DB::ReaderConnection* DB::lockReader(std::unique_lock<std::mutex>& lock) {
+    if (readers_.empty()) return nullptr;
+
+    size_t start = nextReader_.fetch_add(1, std::memory_order_relaxed);
+
+    /// сначала свободный читатель, иначе ждём очередного по кругу
+    for (size_t i = 0; i < readers_.size(); ++i) {
+        ReaderConnection& reader = *readers_[(start + i) % readers_.size()];
+        lock = std::unique_lock<std::mutex>(reader.mutex, std::try_to_lock);
+        if (lock.owns_lock()) return &reader;
+    }
+
+    ReaderConnection& reader = *readers_[start % readers_.size()];
+    lock = std::unique_lock<std::mutex>(reader.mutex);
+    return &reader;
 }
 
 void DB::createDB(const std::string& db_name, const std::vector<std::string>& sql) {
@@ -49,18 +149,83 @@ void DB::createDB(const std::string& db_name, const std::vector<std::string>& sq
         db_ = nullptr;
         throw std::logic_error("Failed to open database");
     }
+    statements_.attach(db_);
     
     execute("PRAGMA foreign_keys = ON;");
 
-    if (!sql.empty()) {
-        for (const auto& query : sql) {
-            execute(query);
-        }
-    }
-    else {
+    if (sql.empty()) {
         db_ = nullptr;
         throw std::logic_error("Create query was not executed");
     }
+
+    /// базовая схема уже создана, дальше её меняют только миграции
+    if (schemaVersion() > 0) return;
+
+    for (const auto& query : sql) {
+        if (!execute(query)) {
+            throw std::runtime_error("Base schema query failed: " + query);
+        }
+    }
+}
+
+int64_t DB::schemaVersion() {
+    auto row = queryOne<int64_t>("PRAGMA user_version;");
+    return row ? std::get<0>(*row) : 0;
+}
+
+size_t DB::migrate(const std::string& dir) {
+    namespace fs = std::filesystem;
+
+    std::map<int64_t, fs::path> migrations;
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".sql") continue;
+
+        std::string name = entry.path().filename().string();
+        size_t digits = name.find_first_not_of("0123456789");
+        if (digits == 0) {
+            throw std::runtime_error("Migration without a version number: " + name);
+        }
+        if (!migrations.emplace(std::stoll(name.substr(0, digits)), entry.path()).second) {
+            throw std::runtime_error("Duplicate migration version: " + name);
+        }
+    }
+
+    int64_t current = schemaVersion();
+    size_t applied = 0;
+
+    for (const auto& [version, path] : migrations) {
+        if (version <= current) continue;
+
+        std::ifstream file(path);
+        std::stringstream script;
+        script << file.rdbuf();
+
+        applyMigration(version, script.str(), path.filename().string());
+        ++applied;
+    }
+    return applied;
+}
+
+void DB::applyMigration(int64_t version, const std::string& script, const std::string& name) {
+    /// версия пишется в той же транзакции: миграция применяется целиком и ровно один раз
+    std::string transaction = 
+        "BEGIN IMMEDIATE;\n" + script + 
+        "\n;\nPRAGMA user_version = " + std::to_string(version) + ";\nCOMMIT;";
+
+    std::scoped_lock<std::mutex> lock(executionMutex_);
+
+    char* error = nullptr;
+    if (sqlite3_exec(db_, transaction.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+        std::string message = error ? error : sqlite3_errmsg(db_);
+        sqlite3_free(error);
+
+        if (!sqlite3_get_autocommit(db_)) {
+            sqlite3_exec(db_, "ROLLBACK;", nullptr, nullptr, nullptr);
+        }
+        throw std::runtime_error("Migration " + name + " failed: " + message);
+    }
+
+    std::cerr << "DB: applied migration " << name << std::endl;
 }
 
 std::vector<std::string> DB::readSqlQuery(const std::string& filename) {
@@ -74,45 +239,53 @@ std::vector<std::string> DB::readSqlQuery(const std::string& filename) {
         return {};
     }
 
+    auto flush = [&res] (std::string& statement) {
+        statement.erase(0, statement.find_first_not_of(" \t\n\r"));
+        statement.erase(statement.find_last_not_of(" \t\n\r") + 1);
+    
+        if (!statement.empty() && statement != ";") {
+            res.emplace_back(std::move(statement));
+        }
+        statement.clear();
+    };
+
     std::string line;
+    std::string statement;
     while (std::getline(file, line, ';')) {
-        line.erase(0, line.find_first_not_of(" \t\n\r"));
-        line.erase(line.find_last_not_of(" \t\n\r") + 1);
-    
-        if (!line.empty()) {
-            res.emplace_back(line);
+        statement += line;
+        if (file.eof()) break;
+        statement += ';';
+
+        /// тело триггера содержит ';' - копим, пока оператор не закончится
+        if (sqlite3_complete(statement.c_str())) {
+            flush(statement);
         }
     }
+    flush(statement);
 
     return res;
 }
 
 ssize_t DB::getTableSize(const std::string& tableName) {
-    std::optional<ssize_t> res;
-    executeWithCallback(
-        [this, &res] (sqlite3_stmt* stmt) {
-            res = sqlite3_column_int64(stmt, 0);
-            return false; // exit from execute immidiately
-        },
-        std::string("SELECT COUNT(*) FROM ") + tableName
-    );
+    auto res = queryOne<int64_t>(std::string("SELECT COUNT(*) FROM ") + tableName);
 
     if (!res.has_value()) {
         throw std::invalid_argument("Empty res");
     }
-    return res.value();
+    return std::get<0>(*res);
 }
 
 bool DB::save(User& user) {
-    bool res = execute(
+    auto id = insert(
         "INSERT INTO User (name, password) VALUES(?, ?)", 
         user.getName(), user.getPassword()
     );
-    if (res) {
-        user.setID(sqlite3_last_insert_rowid(db_));
+    if (id) {
+        user.setID(*id);
+        if (cache_) cache_->usersByName.erase(user.getName());
     }
 
-    return res;
+    return id.has_value();
 }
 
 bool DB::save(User&& user) {
@@ -120,24 +293,35 @@ bool DB::save(User&& user) {
         "INSERT INTO User (name, password) VALUES(?, ?)", 
         user.getName(), user.getPassword()
     );
+    if (res && cache_) cache_->usersByName.erase(user.getName());
 
     return res;
 }
 
-void DB::addMemberToChat(ID_t userID, ID_t chatID) {
-    auto user = findUser(userID);
-    if (!user.has_value()) {
-        std::cerr << "Error: user not found" << std::endl;
-        execute(
+size_t DB::saveUsers(std::span<User> users) {
+    size_t saved = insertBatch(users, [this] (User& user) {
+        return executeUnlocked(
             "INSERT INTO User (name, password) VALUES(?, ?)", 
-            user->getName(), user->getPassword()
+            user.getName(), user.getPassword()
         );
+    });
+
+    if (cache_) {
+        for (const User& user : users) {
+            if (user.getID()) cache_->usersByName.erase(user.getName());
+        }
     }
+    return saved;
+}
 
-    execute(
-        "INSERT INTO ChatMembers (chat_id, user_id) VALUES(?, ?)",
-        chatID, userID
-    );
+std::string DB::toJsonArray(std::span<const ID_t> ids) {
+    std::string json = "[";
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (i > 0) json += ',';
+        json += std::to_string(ids[i]);
+    }
+    json += ']';
+    return json;
 }
 
 std::optional<Chat> DB::makePulledChat(
@@ -161,105 +345,278 @@ std::optional<Chat> DB::makePulledChat(
     return pulled_chat;
 }
 
+std::optional<Chat> DB::makePulledChat(ChatRecord record) {
+    return makePulledChat(record.userIDs, record.type, record.name, record.id);
+}
+
+void DB::invalidateChat(ID_t chatID, const std::optional<std::string>& chatName) {
+    if (!cache_) return;
+
+    auto cached = cache_->chatsByID.erase(chatID);
+    if (chatName) cache_->chatsByName.erase(*chatName);
+    if (cached && cached->name && cached->name != chatName) {
+        cache_->chatsByName.erase(*cached->name);
+    }
+}
+
 std::optional<User> DB::findUser(const std::string& name) {
-    ID_t id;
-    std::string password;
-    
-    executeWithCallback([&] (sqlite3_stmt* stmt) {
-        id = sqlite3_column_int(stmt, 0);
-        password = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+    uint64_t epoch = 0;
+    if (cache_) {
+        if (auto cached = cache_->usersByName.get(name)) {
+            return std::make_optional<User>(cached->name, cached->password, cached->id);
+        }
+        epoch = cache_->usersByName.epoch();
+    }
 
-        return true;
-    }, 
-    "SELECT id, password FROM User WHERE name = ?;", name);
+    auto row = queryOne<ID_t, std::string>("SELECT id, password FROM User WHERE name = ?;", name);
+    if (!row) return std::nullopt;
 
+    auto& [id, password] = *row;
+    if (cache_) cache_->usersByName.put(name, UserRecord{id, name, password}, epoch);
     return std::make_optional<User>(name, password, id);    
 }
 
 std::optional<User> DB::findUser(ID_t id) {
-    std::string name;
-    std::string password;
+    uint64_t epoch = 0;
+    if (cache_) {
+        if (auto cached = cache_->usersByID.get(id)) {
+            return std::make_optional<User>(cached->name, cached->password, cached->id);
+        }
+        epoch = cache_->usersByID.epoch();
+    }
 
-    executeWithCallback([&] (sqlite3_stmt* stmt) {
-        name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        password = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-
-        return true;
-    }, 
-    "SELECT name, password FROM User WHERE id = ?", id);
+    auto row = queryOne<std::string, std::string>("SELECT name, password FROM User WHERE id = ?", id);
+    if (!row) return std::nullopt;
 
+    auto& [name, password] = *row;
+    if (cache_) cache_->usersByID.put(id, UserRecord{id, name, password}, epoch);
     return std::make_optional<User>(name, password, id);
 }
 
 bool DB::save(Message& message) {
-    if (!chatExistsInDB(message.getChatID())) {
-        std::cerr << "Save message error: chat does not exists\n";
+    /// существование чата проверяет внешний ключ chat_id, без отдельного SELECT;
+    /// ID от SnowflakeGenerator и seq от MessagePersister сохраняются как есть,
+    /// иначе ID назначит SQLite, а seq - следующий в чате
+    std::optional<std::tuple<ID_t, int64_t> > row;
+    writeWithCallback([&row] (sqlite3_stmt* stmt) {
+        row = readRow<ID_t, int64_t>(stmt);
         return false;
-    }
-
-    bool res = execute(
-        "INSERT INTO MessagesHistory (sender_id, chat_id, text) VALUES (?, ?, ?)",
-        message.getSenderID(), message.getChatID(), message.getText() 
+    }, 
+        INSERT_MESSAGE_QUERY,
+        message.getID(), message.getSenderID(), message.getChatID(), message.getText(),
+        message.getSeq(), message.getChatID()
     );
+    if (!row) return false;
 
-    if (res)
-        message.setID(sqlite3_last_insert_rowid(db_));
-
-    return res;
+    message.setID(std::get<0>(*row));
+    message.setSeq(std::get<1>(*row));
+    return true;
 }
 
 bool DB::save(Message&& message) {
     return save(message);
 }
 
-std::optional<Message> DB::findMessage(ID_t chatID, ID_t msgID) {
-    std::string text;
-    ID_t senderID = 0;
+size_t DB::saveBatch(std::span<Message> messages) {
+    return insertBatch(messages, [this] (Message& message) {
+        auto lease = statements_.acquire(INSERT_MESSAGE_QUERY);
+        if (!lease) return false;
+
+        std::optional<int64_t> seq;
+        bool inserted = stepRows(db_, lease.get(), [&seq] (sqlite3_stmt* stmt) {
+            seq = ColumnReader<int64_t>::read(stmt, 1);
+            return false;
+        }, 
+            message.getID(), message.getSenderID(), message.getChatID(), message.getText(),
+            message.getSeq(), message.getChatID()
+        );
 
-    bool exec_res = executeWithCallback([&] (sqlite3_stmt* stmt) -> bool {
-        senderID = sqlite3_column_int64(stmt, 0);
-        text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        return true;
-    }, 
-        "SELECT sender_id, text FROM MessagesHistory WHERE chat_id = ? AND id = ?",
+        if (inserted && seq) message.setSeq(*seq);
+        return inserted && seq.has_value();
+    });
+}
+
+int64_t DB::lastSeq(ID_t chatID) {
+    auto row = queryOne<int64_t>(
+        "SELECT IFNULL(MAX(seq), 0) FROM MessagesHistory WHERE chat_id = ?", chatID
+    );
+    return row ? std::get<0>(*row) : 0;
+}
+
+std::vector<User> DB::findUsers(std::span<const ID_t> ids) {
+    std::unordered_map<ID_t, UserRecord> found;
+    std::vector<ID_t> missing;
+
+    uint64_t epoch = 0;
+    if (cache_) {
+        epoch = cache_->usersByID.epoch();
+        for (ID_t id : ids) {
+            if (auto cached = cache_->usersByID.get(id)) {
+                found.emplace(id, std::move(*cached));
+            }
+            else {
+                missing.push_back(id);
+            }
+        }
+    }
+    else {
+        missing.assign(ids.begin(), ids.end());
+    }
+
+    if (!missing.empty()) {
+        forEachRow<ID_t, std::string_view, std::string_view>(
+            [&] (ID_t id, std::string_view name, std::string_view password) {
+                UserRecord record{id, std::string(name), std::string(password)};
+                if (cache_) cache_->usersByID.put(id, record, epoch);
+                found.emplace(id, std::move(record));
+            }, 
+            "SELECT id, name, password FROM User WHERE id IN (SELECT value FROM json_each(?))",
+            toJsonArray(missing)
+        );
+    }
+
+    std::vector<User> users;
+    users.reserve(ids.size());
+    for (ID_t id : ids) {
+        auto it = found.find(id);
+        if (it == found.end()) continue;
+        users.emplace_back(it->second.name, it->second.password, it->second.id);
+    }
+    return users;
+}
+
+std::optional<Message> DB::findMessage(ID_t chatID, ID_t msgID) {
+    auto row = queryOne<ID_t, std::string, int64_t>(
+        "SELECT sender_id, text, seq FROM MessagesHistory WHERE chat_id = ? AND id = ?",
         chatID, msgID
     );
 
-    if (!exec_res || !senderID || text.empty()) {
+    if (!row || !std::get<0>(*row) || std::get<1>(*row).empty()) {
         std::cerr << "Message not found\n";
         return std::nullopt;
     }
 
+    auto& [senderID, text, seq] = *row;
     Message msg(chatID, senderID, text);
     msg.setID(msgID);
+    msg.setSeq(seq);
 
     return std::make_optional<Message>(std::move(msg));
 }
 
 std::optional<Message> DB::findMessage(ID_t chatID, const std::string& text) {
-    ID_t senderID = 0;
-    ID_t msgID = 0;
-
-    bool exec_res = executeWithCallback([&] (sqlite3_stmt* stmt) -> bool {
-        senderID = sqlite3_column_int64(stmt, 0);
-        msgID = sqlite3_column_int64(stmt, 1);
-        return true;
-    },
-        "SELECT sender_id, id FROM MessagesHistory WHERE chat_id = ? AND text = ?", 
+    auto row = queryOne<ID_t, ID_t, int64_t>(
+        "SELECT sender_id, id, seq FROM MessagesHistory WHERE chat_id = ? AND text = ?", 
         chatID, text
     );
 
-    if (!exec_res || !(senderID || msgID)) {
+    if (!row) {
         std::cerr << "Message not found\n";
         return std::nullopt;
     }
 
+    auto [senderID, msgID, seq] = *row;
     Message msg(chatID, senderID, text);
     msg.setID(msgID);
+    msg.setSeq(seq);
 
     return std::make_optional<Message>(msg);
 }
 
+std::vector<Message> DB::fetchHistory(ID_t chatID, ID_t beforeID, size_t limit) {
+    /// только idx_messages_chat_history: поиск по (chat_id, id) и обход без сортировки
+    return fetchMessages(
+        R"(SELECT id, seq, sender_id, text FROM MessagesHistory 
+        WHERE chat_id = ? AND id < ? 
+        ORDER BY id DESC LIMIT ?;)", 
+        chatID, beforeID, limit
+    );
+}
+
+std::vector<Message> DB::fetchSince(ID_t chatID, ID_t afterID, size_t limit) {
+    return fetchMessages(
+        R"(SELECT id, seq, sender_id, text FROM MessagesHistory 
+        WHERE chat_id = ? AND id > ? 
+        ORDER BY id ASC LIMIT ?;)", 
+        chatID, afterID, limit
+    );
+}
+
+std::vector<Message> DB::fetchSinceSeq(ID_t chatID, int64_t afterSeq, size_t limit) {
+    /// idx_messages_chat_seq: seq и id в чате растут вместе
+    return fetchMessages(
+        R"(SELECT id, seq, sender_id, text FROM MessagesHistory 
+        WHERE chat_id = ? AND seq > ? 
+        ORDER BY seq ASC LIMIT ?;)", 
+        chatID, afterSeq, limit
+    );
+}
+
+std::vector<Message> DB::fetchMessages(const std::string& query, ID_t chatID, int64_t bound, size_t limit) {
+    std::vector<Message> messages;
+    messages.reserve(limit);
+
+    forEachRow<ID_t, int64_t, ID_t, std::string_view>(
+        [&] (ID_t id, int64_t seq, ID_t senderID, std::string_view text) {
+            Message& message = messages.emplace_back(chatID, senderID, std::string(text));
+            message.setID(id);
+            message.setSeq(seq);
+        }, 
+        query, chatID, bound, static_cast<int64_t>(limit)
+    );
+
+    return messages;
+}
+
+std::vector<SearchResult> DB::searchMessages(ID_t chatID, const std::string& query, size_t limit) {
+    std::string match = makeMatchQuery(query);
+    if (match.empty()) return {};
+
+    /// чат - тоже токен индекса: FTS пересекает списки, не читая чужие чаты
+    return queryAs<SearchResult, ID_t, int64_t, ID_t, ID_t, std::string, double>(
+        R"(SELECT m.id, m.seq, m.chat_id, m.sender_id, 
+            snippet(MessagesSearch, 0, '[', ']', '...', 12), MessagesSearch.rank
+        FROM MessagesSearch 
+        JOIN MessagesHistory m ON m.id = MessagesSearch.rowid
+        WHERE MessagesSearch MATCH ? 
+        ORDER BY MessagesSearch.rank LIMIT ?;)",
+        "chat : c" + std::to_string(chatID) + " AND " + match, static_cast<int64_t>(limit)
+    );
+}
+
+std::vector<SearchResult> DB::searchUserMessages(ID_t userID, const std::string& query, size_t limit) {
+    std::string match = makeMatchQuery(query);
+    if (match.empty()) return {};
+
+    return queryAs<SearchResult, ID_t, int64_t, ID_t, ID_t, std::string, double>(
+        R"(SELECT m.id, m.seq, m.chat_id, m.sender_id, 
+            snippet(MessagesSearch, 0, '[', ']', '...', 12), MessagesSearch.rank
+        FROM MessagesSearch 
+        JOIN MessagesHistory m ON m.id = MessagesSearch.rowid
+        WHERE MessagesSearch MATCH ? 
+            AND m.chat_id IN (SELECT chat_id FROM ChatMembers WHERE user_id = ?)
+        ORDER BY MessagesSearch.rank LIMIT ?;)",
+        match, userID, static_cast<int64_t>(limit)
+    );
+}
+
+std::string DB::makeMatchQuery(const std::string& text) {
+    std::string match;
+    std::istringstream words(text);
+    std::string word;
+
+    while (words >> word) {
+        if (!match.empty()) match += " AND ";
+        match += "text : \"";
+        for (char c : word) {
+            if (c == '"') match += '"';
+            match += c;
+        }
+        match += '"';
+    }
+    return match;
+}
+
 bool DB::deleteMessage(ID_t chatID, ID_t msgID) {
     if (findMessage(chatID, msgID)) {
         bool res = execute(
@@ -272,16 +629,7 @@ bool DB::deleteMessage(ID_t chatID, ID_t msgID) {
 }
 
 bool DB::chatExistsInDB(ID_t chatID) {
-    bool exists = false;
-
-    executeWithCallback([&exists] (sqlite3_stmt* stmt) {
-            exists = sqlite3_column_int(stmt, 0);
-            return true;
-        },
-        "SELECT 1 FROM Chat WHERE id = ?", chatID
-    );
-        
-    return exists;
+    return queryOne<int>("SELECT 1 FROM Chat WHERE id = ?", chatID).has_value();
 }
 
 bool DB::save(Chat& chat) {
@@ -290,17 +638,35 @@ bool DB::save(Chat& chat) {
         return true;
     }
     
-    bool exec_res = execute(
-        "INSERT INTO Chat (name, type) VALUES (?, ?)", 
-        chat.getName(), chat.getStringType()
-    );
-
-    if (exec_res) chat.setID(sqlite3_last_insert_rowid(db_));
+    ID_t chatID = 0;
+    {
+        std::scoped_lock<std::mutex> lock(executionMutex_);
+        if (!executeUnlocked("BEGIN IMMEDIATE;")) return false;
+
+        bool exec_res = executeUnlocked(
+            "INSERT INTO Chat (name, type) VALUES (?, ?)", 
+            chat.getName(), chat.getStringType()
+        );
+        if (exec_res) {
+            chatID = sqlite3_last_insert_rowid(db_);
+
+            /// все участники - одним INSERT ... SELECT, внешний ключ проверит каждого
+            exec_res = executeUnlocked(
+                "INSERT INTO ChatMembers (chat_id, user_id) SELECT ?, value FROM json_each(?)",
+                chatID, toJsonArray(chat.userIDs_)
+            );
+        }
 
-    for (const auto& userID : chat.userIDs_) {
-        addMemberToChat(userID, *chat.getID());
+        if (!exec_res || !executeUnlocked("COMMIT;")) {
+            executeUnlocked("ROLLBACK;");
+            return false;
+        }
     }
-    return exec_res;
+
+    chat.setID(chatID);
+    invalidateChat(chatID, chat.getName());
+
+    return true;
 }
 
 bool DB::save(Chat&& chat) {
@@ -308,27 +674,27 @@ bool DB::save(Chat&& chat) {
 }
 
 std::optional<Chat> DB::findChat(ID_t chatID) {
+    uint64_t epoch = 0;
+    if (cache_) {
+        if (auto cached = cache_->chatsByID.get(chatID)) {
+            return makePulledChat(std::move(*cached));
+        }
+        epoch = cache_->chatsByID.epoch();
+    }
+
     std::string chatType;
     std::optional<std::string> chatName;
     std::vector<ID_t> userIDs;
 
-    bool exec_res = executeWithCallback([&] (sqlite3_stmt* stmt) {
-        const unsigned char* type = sqlite3_column_text(stmt, 0);
-        if (!type) return true;
-
-        chatType = reinterpret_cast<const char*>(type);
-                
-        const unsigned char* nameText = sqlite3_column_text(stmt, 1);
-        if (nameText) {
-            chatName = std::string(reinterpret_cast<const char*>(nameText));
-        } 
-        else { 
-            chatName = std::nullopt;
-        }
-
-        userIDs.emplace_back(sqlite3_column_int64(stmt, 2));
-        return true;
-    }, 
+    /// тип и имя одинаковы во всех строках - копируются один раз
+    bool exec_res = forEachRow<std::string_view, std::optional<std::string_view>, ID_t>(
+        [&] (std::string_view type, std::optional<std::string_view> name, ID_t userID) {
+            if (userIDs.empty()) {
+                chatType = type;
+                if (name) chatName = std::string(*name);
+            }
+            userIDs.emplace_back(userID);
+        }, 
         R"(SELECT 
             c.type AS c_type,
             c.name AS c_name,
@@ -342,24 +708,33 @@ std::optional<Chat> DB::findChat(ID_t chatID) {
 
     if (!exec_res) return std::nullopt;
 
+    if (cache_ && !chatType.empty()) {
+        cache_->chatsByID.put(chatID, ChatRecord{chatID, chatType, chatName, userIDs}, epoch);
+    }
     return makePulledChat(userIDs, chatType, chatName, chatID);
 }
 
 std::optional<Chat> DB::findChat(const std::string& chatName) {
+    uint64_t epoch = 0;
+    if (cache_) {
+        if (auto cached = cache_->chatsByName.get(chatName)) {
+            return makePulledChat(std::move(*cached));
+        }
+        epoch = cache_->chatsByName.epoch();
+    }
+
     std::string chatType;
-    ID_t chatID;
+    ID_t chatID = 0;
     std::vector<ID_t> userIDs;
 
-    bool exec_res = executeWithCallback([&] (sqlite3_stmt* stmt) {
-        const unsigned char* type = sqlite3_column_text(stmt, 0);
-        if (!type) return true;
-
-        chatType = reinterpret_cast<const char*>(type);
-        chatID = sqlite3_column_int64(stmt, 1);
-            
-        userIDs.emplace_back(sqlite3_column_int64(stmt, 2));
-        return true;
-    }, 
+    bool exec_res = forEachRow<std::string_view, ID_t, ID_t>(
+        [&] (std::string_view type, ID_t id, ID_t userID) {
+            if (userIDs.empty()) {
+                chatType = type;
+                chatID = id;
+            }
+            userIDs.emplace_back(userID);
+        }, 
         R"(SELECT 
             c.type AS c_type,
             c.id AS c_id,
@@ -373,29 +748,228 @@ std::optional<Chat> DB::findChat(const std::string& chatName) {
 
     if (!exec_res || chatType.empty()) return std::nullopt;
 
-    if (userIDs.empty()) {  
-        throw std::invalid_argument("Can not find chat members - usersIDs is empty");
+    if (cache_) {
+        cache_->chatsByName.put(chatName, ChatRecord{chatID, chatType, chatName, userIDs}, epoch);
     }
+    return makePulledChat(userIDs, chatType, chatName, chatID);
+}
 
-    auto pulled_chat = std::make_optional<Chat>(
-        shared_from_this(),
-        userIDs,
-        ChatType::fromString(chatType),
-        chatName
-    );
-    pulled_chat->setID(chatID);
-    
-    return pulled_chat;
+bool DB::isChatMember(ID_t chatID, ID_t userID) {
+    if (cache_) {
+        if (auto cached = cache_->chatsByID.get(chatID)) {
+            const auto& members = cached->userIDs;
+            return std::find(members.begin(), members.end(), userID) != members.end();
+        }
+    }
+    return queryOne<int>(
+        "SELECT 1 FROM ChatMembers WHERE chat_id = ? AND user_id = ?", chatID, userID
+    ).has_value();
+}
+
+std::optional<ID_t> DB::findPersonalChatID(ID_t firstUserID, ID_t secondUserID) {
+    auto row = queryOne<ID_t>(PERSONAL_CHAT_QUERY, firstUserID, secondUserID);
+
+    if (!row) return std::nullopt;
+    return std::get<0>(*row);
+}
+
+std::optional<ID_t> DB::openPersonalChat(ID_t firstUserID, ID_t secondUserID) {
+    /// обычно чат уже есть - читатель, без блокировки писателя
+    if (auto existing = findPersonalChatID(firstUserID, secondUserID)) return existing;
+
+    std::optional<ID_t> chatID;
+    bool created = false;
+    {
+        std::scoped_lock<std::mutex> lock(executionMutex_);
+        if (!executeUnlocked("BEGIN IMMEDIATE;")) return std::nullopt;
+
+        /// повторный поиск внутри транзакции: встречный /msg ждёт её конца и найдёт этот чат
+        bool exec_res = false;
+        if (auto lease = statements_.acquire(PERSONAL_CHAT_QUERY)) {
+            exec_res = stepRows(db_, lease.get(), [&chatID] (sqlite3_stmt* stmt) {
+                chatID = std::get<0>(readRow<ID_t>(stmt));
+                return false;
+            }, 
+                firstUserID, secondUserID
+            );
+        }
+
+        if (exec_res && !chatID) {
+            exec_res = executeUnlocked("INSERT INTO Chat (name, type) VALUES (NULL, 'personal')");
+            if (exec_res) {
+                chatID = sqlite3_last_insert_rowid(db_);
+                created = true;
+                exec_res = executeUnlocked(
+                    "INSERT INTO ChatMembers (chat_id, user_id) VALUES (?, ?), (?, ?)",
+                    *chatID, firstUserID, *chatID, secondUserID
+                );
+            }
+        }
+
+        if (!exec_res || !executeUnlocked("COMMIT;")) {
+            executeUnlocked("ROLLBACK;");
+            return std::nullopt;
+        }
+    }
+
+    if (created) invalidateChat(*chatID, std::nullopt);
+    return chatID;
 }
 
 bool DB::deleteChat(ID_t chatID) {
-    return execute("DELETE FROM Chat WHERE id = ?", chatID);
+    std::optional<std::string> chatName;
+
+    bool res = writeWithCallback([&chatName] (sqlite3_stmt* stmt) {
+        chatName = ColumnReader<std::optional<std::string> >::read(stmt, 0);
+        return true;
+    }, 
+        "DELETE FROM Chat WHERE id = ? RETURNING name", chatID
+    );
+
+    /// кэш сбрасывается после удаления: иначе параллельный findChat вернёт его обратно
+    invalidateChat(chatID, chatName);
+    return res;
 }
 
-bool DB::prepareExecution(const std::string& query, sqlite3_stmt** stmt) {
-    if (sqlite3_prepare_v2(db_, query.c_str(), -1, stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "Preparing statement error: " << sqlite3_errmsg(db_) << std::endl;
-        return false;
+size_t DB::queueDeliveries(std::span<PendingDelivery> deliveries) {
+    return insertBatch(deliveries, [this] (PendingDelivery& delivery) {
+        auto frame = std::as_bytes(std::span(delivery.frame));
+        return executeUnlocked(
+            "INSERT INTO PendingDeliveries (user_id, chat_id, seq, frame) VALUES (?, ?, ?, ?)",
+            delivery.userID, delivery.chatID, delivery.seq, frame
+        );
+    });
+}
+
+std::vector<PendingDelivery> DB::fetchDeliveries(ID_t userID, ID_t afterID, size_t limit) {
+    std::vector<PendingDelivery> deliveries;
+    forEachRow<ID_t, ID_t, int64_t, std::span<const std::byte> >(
+        [&] (ID_t id, ID_t chatID, int64_t seq, std::span<const std::byte> frame) {
+            deliveries.push_back(PendingDelivery{
+                id, userID, chatID, seq, 
+                std::string(reinterpret_cast<const char*>(frame.data()), frame.size())
+            });
+        },
+        R"(SELECT id, chat_id, seq, frame FROM PendingDeliveries 
+        WHERE user_id = ? AND id > ? 
+        ORDER BY id ASC LIMIT ?;)", 
+        userID, afterID, static_cast<int64_t>(limit)
+    );
+    return deliveries;
+}
+
+size_t DB::clearDeliveries(std::span<const DeliveryAck> acks, std::span<const ID_t> sent) {
+    if (!db_) {
+        throw std::runtime_error("Database not initialized");
     }
-    return true;
+    if (acks.empty() && sent.empty()) return 0;
+
+    std::scoped_lock<std::mutex> lock(executionMutex_);
+    if (!executeUnlocked("BEGIN IMMEDIATE;")) return 0;
+
+    size_t removed = 0;
+    for (const DeliveryAck& ack : acks) {
+        /// подтверждение накопительное: все сообщения чата до seq включительно
+        if (executeUnlocked(
+            "DELETE FROM PendingDeliveries WHERE user_id = ? AND chat_id = ? AND seq BETWEEN 1 AND ?",
+            ack.userID, ack.chatID, ack.seq
+        )) {
+            removed += static_cast<size_t>(sqlite3_changes(db_));
+        }
+    }
+    if (!sent.empty() && executeUnlocked(
+        "DELETE FROM PendingDeliveries WHERE seq = 0 AND id IN (SELECT value FROM json_each(?))",
+        toJsonArray(sent)
+    )) {
+        removed += static_cast<size_t>(sqlite3_changes(db_));
+    }
+
+    if (!executeUnlocked("COMMIT;")) {
+        executeUnlocked("ROLLBACK;");
+        return 0;
+    }
+    return removed;
+}
+
+size_t DB::countDeliveries(ID_t userID) {
+    auto row = queryOne<int64_t>("SELECT COUNT(*) FROM PendingDeliveries WHERE user_id = ?", userID);
+    return row ? static_cast<size_t>(std::get<0>(*row)) : 0;
+}
+
+size_t DB::updateUnread(std::span<const UnreadIncrement> posted, std::span<const ReadReceipt> reads) {
+    if (!db_) {
+        throw std::runtime_error("Database not initialized");
+    }
+    if (posted.empty() && reads.empty()) return 0;
+
+    std::scoped_lock<std::mutex> lock(executionMutex_);
+    if (!executeUnlocked("BEGIN IMMEDIATE;")) return 0;
+
+    size_t updated = 0;
+    for (const UnreadIncrement& increment : posted) {
+        if (increment.seqs.empty()) continue;
+        int64_t last = *std::max_element(increment.seqs.begin(), increment.seqs.end());
+
+        /// отправителю не прибавляется, прочитанное раньше прихода сообщения не считается
+        if (executeUnlocked(
+            "UPDATE UnreadCounters SET "
+                "unread = unread + CASE WHEN user_id = ?1 THEN 0 ELSE "
+                    "(SELECT COUNT(*) FROM json_each(?2) WHERE value > UnreadCounters.read_seq) END, "
+                "last_seq = MAX(last_seq, ?3) "
+            "WHERE chat_id = ?4",
+            increment.senderID, toJsonArray(increment.seqs), last, increment.chatID
+        )) {
+            updated += static_cast<size_t>(sqlite3_changes(db_));
+        }
+    }
+
+    for (const ReadReceipt& receipt : reads) {
+        /// диапазон (read_seq, seq] по idx_messages_chat_seq, до сдвига read_seq
+        executeUnlocked(
+            "UPDATE MessagesHistory SET is_read = 1 "
+            "WHERE chat_id = ?1 AND seq <= ?3 AND sender_id != ?2 AND is_read = 0 AND seq > "
+                "IFNULL((SELECT read_seq FROM UnreadCounters WHERE user_id = ?2 AND chat_id = ?1), 0)",
+            receipt.chatID, receipt.userID, receipt.seq
+        );
+
+        /// между seq и last_seq непрочитанных не больше, чем номеров
+        if (executeUnlocked(
+            "UPDATE UnreadCounters SET "
+                "unread = CASE WHEN ?1 >= last_seq THEN 0 ELSE MIN(unread, last_seq - ?1) END, "
+                "read_seq = ?1 "
+            "WHERE user_id = ?2 AND chat_id = ?3 AND read_seq < ?1",
+            receipt.seq, receipt.userID, receipt.chatID
+        )) {
+            updated += static_cast<size_t>(sqlite3_changes(db_));
+        }
+    }
+
+    if (!executeUnlocked("COMMIT;")) {
+        executeUnlocked("ROLLBACK;");
+        return 0;
+    }
+    return updated;
+}
+
+std::vector<ChatUnread> DB::listChats(ID_t userID) {
+    /// по первичному ключу (user_id, chat_id), собеседник - по idx_chat_members_chat
+    return queryAs<ChatUnread, ID_t, std::string, int64_t, int64_t>(
+        "SELECT u.chat_id, IFNULL(c.name, IFNULL(p.name, '')), u.unread, u.last_seq "
+        "FROM UnreadCounters u "
+        "JOIN Chat c ON c.id = u.chat_id "
+        "LEFT JOIN ChatMembers m ON c.type = 'personal' AND m.chat_id = u.chat_id AND m.user_id != u.user_id "
+        "LEFT JOIN User p ON p.id = m.user_id "
+        "WHERE u.user_id = ? "
+        "ORDER BY u.chat_id ASC",
+        userID
+    );
+}
+
+EntityCacheStats DB::entityCacheStats() const {
+    return cache_ ? cache_->stats() : EntityCacheStats{};
+}
+
+StatementCacheStats DB::statementCacheStats() {
+    std::scoped_lock<std::mutex> lock(executionMutex_);
+    return statements_.stats();
 }
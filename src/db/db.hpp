@@ -1,29 +1,133 @@
 #pragma once
 #include <sqlite3.h>
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <limits>
 #include <type_traits>
 #include <optional>
 #include <memory>
 #include <mutex>
+#include <span>
+#include <string_view>
+#include <tuple>
 #include <vector>
 
 #include "chat/chat_type.hpp"
-
-using ID_t = int64_t;
+#include "entity_cache.hpp"
+#include "row_mapper.hpp"
+#include "statement_cache.hpp"
+#include "types.hpp"
+
+#define HISTORY_PAGE_SIZE 50
+#define SEARCH_LIMIT 20
+#define DELIVERY_BATCH 1024
+
+/// RETURNING id, seq: оба могут назначаться при вставке
+#define INSERT_MESSAGE_QUERY \
+    "INSERT INTO MessagesHistory (id, sender_id, chat_id, text, seq) VALUES (?, ?, ?, ?, " \
+    "COALESCE(?, (SELECT IFNULL(MAX(seq), 0) + 1 FROM MessagesHistory WHERE chat_id = ?))) " \
+    "RETURNING id, seq"
+
+#define PERSONAL_CHAT_QUERY \
+    "SELECT c.id FROM Chat c " \
+    "JOIN ChatMembers first ON first.chat_id = c.id AND first.user_id = ? " \
+    "JOIN ChatMembers second ON second.chat_id = c.id AND second.user_id = ? " \
+    "WHERE c.type = 'personal' LIMIT 1"
 
 class User;
 class Chat;
 class Message;
 class DBTest;
 
+/// @brief Connection settings of DB::init()
+struct DBOptions {
+    /// 0 - одно соединение на всё (единственный вариант для ":memory:"),
+    /// иначе WAL, писатель db_ и столько же читающих соединений
+    size_t readers = 0;
+
+    int busyTimeoutMs = 5000;
+    std::string synchronous = "NORMAL"; // в WAL NORMAL не теряет целостность, только последние коммиты при сбое ОС
+    int64_t mmapSize = 256 * 1024 * 1024;
+
+    /// каталог NNNN_name.sql для DB::migrate(), пусто - без миграций
+    std::string migrations;
+
+    /// записей на каждый кэш пользователей и чатов, 0 - всегда в SQLite
+    size_t entityCacheCapacity = ENTITY_CACHE_CAPACITY;
+};
+
+/// @brief Message found by DB::searchMessages(), best first
+struct SearchResult {
+    ID_t messageID;
+    int64_t seq;
+    ID_t chatID;
+    ID_t senderID;
+    std::string snippet; // совпавшие слова в [скобках]
+    double rank;         // bm25, меньше - лучше
+};
+
+/// @brief Frame in PendingDeliveries waiting for a recipient who was not connected
+struct PendingDelivery {
+    ID_t id = 0;
+    ID_t userID = 0;
+    ID_t chatID = 0;
+    int64_t seq = 0;   // 0 - не подтверждается, удаляется после отправки
+    std::string frame; // закодированный кадр целиком
+
+    void setID(ID_t deliveryID) { id = deliveryID; }
+};
+
+/// @brief The user has got messages of the chat up to seq
+struct DeliveryAck {
+    ID_t userID;
+    ID_t chatID;
+    int64_t seq;
+};
+
+/// @brief Messages of one sender in a chat, unread for the other members
+struct UnreadIncrement {
+    ID_t chatID;
+    ID_t senderID;
+    std::vector<int64_t> seqs;
+};
+
+/// @brief The user has read the chat up to seq
+struct ReadReceipt {
+    ID_t userID;
+    ID_t chatID;
+    int64_t seq;
+};
+
+/// @brief Chat of the user with its unread badge, see DB::listChats()
+struct ChatUnread {
+    ID_t chatID;
+    std::string title; // название группы или собеседник личного чата
+    int64_t unread;
+    int64_t lastSeq;
+};
+
 class DB : public std::enable_shared_from_this<DB> {
 public:
     friend class DBTest;
 
 protected:
-    sqlite3* db_ = nullptr;
+    /// @brief Read-only connection of the pool with its own statements
+    struct ReaderConnection {
+        sqlite3* db = nullptr;
+        std::mutex mutex;
+        StatementCache statements;
+    };
+
+    sqlite3* db_ = nullptr; // писатель, в режиме одного соединения - и читатель
     std::mutex executionMutex_;
+    StatementCache statements_; // под executionMutex_
+
+    std::vector<std::unique_ptr<ReaderConnection> > readers_;
+    std::atomic<size_t> nextReader_{0};
+
+    std::unique_ptr<EntityCache> cache_; // nullptr - кэш выключен
 
 public:
     DB() = default;
@@ -35,56 +139,210 @@ public:
     DB(DB&& other) noexcept;
     DB& operator=(DB&& other) noexcept;
 
-    void init(const std::string& db_name, const std::string& sqlFile);
+    void init(const std::string& db_name, const std::string& sqlFile, const DBOptions& options = {});
 
     template <typename... Args>
     bool execute(const std::string& query, Args&&... args);
     
+    /// @brief Read-only queries go to a reader connection of the pool,
+    /// in parallel with each other and with the writer
     template <typename Func, typename... Args>
     bool executeWithCallback(Func&& func,
         const std::string& query, Args&&... args);
 
+    /// @brief executeWithCallback() for writes with rows (RETURNING):
+    /// straight to the writer, readers never prepare them
+    template <typename Func, typename... Args>
+    bool writeWithCallback(Func&& func,
+        const std::string& query, Args&&... args);
+
+    /// @brief func(Ts...) for each row, columns decoded by ColumnReader<Ts>. 
+    /// string_view and span<const std::byte> columns point into the row
+    /// and are valid only inside func. func returning false stops the loop
+    template <typename... Ts, typename Func, typename... Args>
+    bool forEachRow(Func&& func, const std::string& query, Args&&... args);
+
+    /// @brief All rows as tuples of owned values, e.g. query<ID_t, std::string>(...)
+    template <typename... Ts, typename... Args>
+    std::vector<std::tuple<Ts...> > query(const std::string& query, Args&&... args);
+
+    /// @brief The first row only
+    template <typename... Ts, typename... Args>
+    std::optional<std::tuple<Ts...> > queryOne(const std::string& query, Args&&... args);
+
+    /// @brief All rows as T{Ts...}
+    template <typename T, typename... Ts, typename... Args>
+    std::vector<T> queryAs(const std::string& query, Args&&... args);
+
+    /// @brief execute() returning the rowid, read under the same lock
+    template <typename... Args>
+    std::optional<ID_t> insert(const std::string& query, Args&&... args);
+
+    /// @brief Applies NNNN_name.sql migrations of dir newer than schemaVersion() 
+    /// in version order, each in its own transaction together with the new version.
+    /// Scripts must not contain BEGIN/COMMIT. Throws std::runtime_error and
+    /// rolls the failed migration back
+    /// @return number of applied migrations
+    size_t migrate(const std::string& dir);
+
+    /// @brief PRAGMA user_version: the last applied migration, 0 - base schema only
+    int64_t schemaVersion();
+
+    /// @brief Writer connection only
+    StatementCacheStats statementCacheStats();
+
+    size_t readersCount() const { return readers_.size(); }
+
+    /// @brief Hits and misses of findUser() and findChat()
+    EntityCacheStats entityCacheStats() const;
+
     
     // -- User --
     bool save(User& user);
     bool save(User&& user);
 
+    /// @brief All users in one transaction, saved ones get their IDs.
+    /// A taken name fails alone
+    size_t saveUsers(std::span<User> users);
+
     std::optional<User> findUser(const std::string& name);
     std::optional<User> findUser(ID_t id);
+
+    /// @brief Found users in the order of ids, missing ones are skipped.
+    /// Cached users are not queried, the rest come in one SELECT
+    std::vector<User> findUsers(std::span<const ID_t> ids);
     
 
     // -- Message --
     bool save(Message& message);
     bool save(Message&& message);
 
+    /// @brief All messages in one transaction, saved ones get their IDs and seqs.
+    /// An ID (SnowflakeGenerator) or seq (MessagePersister) given beforehand is kept,
+    /// a missing seq is the next one of the chat.
+    /// A message of a missing chat fails alone, a failed commit fails all
+    size_t saveBatch(std::span<Message> messages);
+
     std::optional<Message> findMessage(ID_t chatID, ID_t msgID);
     std::optional<Message> findMessage(ID_t chatID, const std::string& text);
 
+    /// @brief Keyset page of the chat older than beforeID, newest first: 
+    /// the ID of the last one is the beforeID of the next page
+    std::vector<Message> fetchHistory(
+        ID_t chatID, 
+        ID_t beforeID = std::numeric_limits<ID_t>::max(), 
+        size_t limit = HISTORY_PAGE_SIZE
+    );
+
+    /// @brief Messages of the chat newer than afterID, oldest first
+    std::vector<Message> fetchSince(ID_t chatID, ID_t afterID, size_t limit = HISTORY_PAGE_SIZE);
+
+    /// @brief Messages of the chat with seq greater than afterSeq, oldest first
+    std::vector<Message> fetchSinceSeq(ID_t chatID, int64_t afterSeq, size_t limit = HISTORY_PAGE_SIZE);
+
+    /// @brief seq of the newest message of the chat, 0 - no messages
+    int64_t lastSeq(ID_t chatID);
+
+    /// @brief Full-text search in the chat ranked by bm25.
+    /// Words of the query are matched all together, case-insensitive
+    std::vector<SearchResult> searchMessages(ID_t chatID, const std::string& query, size_t limit = SEARCH_LIMIT);
+
+    /// @brief Full-text search in all chats of the user
+    std::vector<SearchResult> searchUserMessages(ID_t userID, const std::string& query, size_t limit = SEARCH_LIMIT);
+
     bool deleteMessage(ID_t chatID, ID_t msgID);
 
 
     // -- Chat --
+    /// @brief The chat and all its members in one transaction:
+    /// a missing member rolls back the whole chat
     bool save(Chat& chat);
     bool save(Chat&& chat);
 
     std::optional<Chat> findChat(ID_t id);
     std::optional<Chat> findChat(const std::string& name);
 
+    std::optional<ID_t> findPersonalChatID(ID_t firstUserID, ID_t secondUserID);
+
+    /// @brief The personal chat of the two users, created if there is none.
+    /// Lookup and insert share one writer transaction, so concurrent calls 
+    /// for the same pair in either order get the same chat
+    std::optional<ID_t> openPersonalChat(ID_t firstUserID, ID_t secondUserID);
+
+    /// @brief From the cached chat if there is one, otherwise one indexed lookup
+    bool isChatMember(ID_t chatID, ID_t userID);
+
     bool deleteChat(ID_t chatID);
+
+
+    // -- Delivery --
+    /// @brief All deliveries in one transaction, queued ones get their IDs
+    size_t queueDeliveries(std::span<PendingDelivery> deliveries);
+
+    /// @brief Deliveries of the user queued after afterID, oldest first
+    std::vector<PendingDelivery> fetchDeliveries(ID_t userID, ID_t afterID = 0, size_t limit = DELIVERY_BATCH);
+
+    /// @brief One transaction: removes acknowledged messages and sent 
+    /// deliveries with seq 0. Returns the number of removed rows
+    size_t clearDeliveries(std::span<const DeliveryAck> acks, std::span<const ID_t> sent);
+
+    size_t countDeliveries(ID_t userID);
+
+
+    // -- Unread --
+    /// @brief One transaction: counts new messages for the other members of 
+    /// their chats, then moves read_seq of the receipts and marks messages 
+    /// up to it as read. A message at or below read_seq is not counted, 
+    /// so a receipt may come before the message it covers
+    /// @return number of updated counters
+    size_t updateUnread(std::span<const UnreadIncrement> posted, std::span<const ReadReceipt> reads);
+
+    /// @brief Chats of the user with unread counters, one indexed query
+    std::vector<ChatUnread> listChats(ID_t userID);
     
 private:
-    void addMemberToChat(ID_t userID, ID_t chatId);
+    /// @brief One transaction, insert(item) per item under executionMutex_.
+    /// IDs are set only after a successful commit, failed messages lose theirs
+    template <typename T, typename Insert>
+    size_t insertBatch(std::span<T> items, Insert&& insert);
+
+    /// @brief "[1,2,3]" for json_each(): a whole list in one bound parameter
+    static std::string toJsonArray(std::span<const ID_t> ids);
+
+    std::vector<Message> fetchMessages(const std::string& query, ID_t chatID, int64_t bound, size_t limit);
+
+    /// @brief User input as an FTS5 expression: every word is a quoted phrase,
+    /// so operators and syntax errors can not come from the client
+    static std::string makeMatchQuery(const std::string& text);
 
     std::optional<Chat> makePulledChat(
         std::vector<ID_t>& userIDs, const std::string& chatType, 
         const std::optional<std::string>& chatName, ID_t chatID
     );
+    std::optional<Chat> makePulledChat(ChatRecord record);
+
+    void invalidateChat(ID_t chatID, const std::optional<std::string>& chatName);
     
     void createDB(const std::string& db_name, const std::vector<std::string>& sql);
 
+    void applyMigration(int64_t version, const std::string& script, const std::string& name);
+
+    void configureWriter(const DBOptions& options);
+    void openReaders(const std::string& db_name, const DBOptions& options);
+    void closeReaders();
+
+    /// @brief nullptr in single connection mode, otherwise a reader locked by lock
+    ReaderConnection* lockReader(std::unique_lock<std::mutex>& lock);
+
+    template <typename Func, typename... Args>
+    bool stepRows(sqlite3* connection, sqlite3_stmt* stmt, Func&& func, Args&&... args);
+
     std::vector<std::string> readSqlQuery(const std::string& filename);
 
     bool chatExistsInDB(ID_t chatID);
+
+    template <typename... Args>
+    bool executeUnlocked(const std::string& query, Args&&... args);
     
     template <typename T>
     void bind(sqlite3_stmt* stmt, unsigned int index, T&& arg);
@@ -92,8 +350,6 @@ private:
     template <typename... Args>
     void bindAll(sqlite3_stmt* stmt, unsigned int index, Args&&... args);
 
-    bool prepareExecution(const std::string& query, sqlite3_stmt** stmt);
-
     ssize_t getTableSize(const std::string& tableName); 
 };
 
@@ -105,11 +361,65 @@ bool DB::execute(const std::string& query, Args&&... args) {
     }
 
     std::scoped_lock<std::mutex> lock(executionMutex_);
+    return executeUnlocked(query, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+std::optional<ID_t> DB::insert(const std::string& query, Args&&... args) {
+    if (!db_) {
+        throw std::runtime_error("Database not initialized");
+    }
+
+    std::scoped_lock<std::mutex> lock(executionMutex_);
+    if (!executeUnlocked(query, std::forward<Args>(args)...)) {
+        return std::nullopt;
+    }
+    return sqlite3_last_insert_rowid(db_);
+}
+
+template <typename T, typename Insert>
+size_t DB::insertBatch(std::span<T> items, Insert&& insert) {
+    if (!db_) {
+        throw std::runtime_error("Database not initialized");
+    }
+    if (items.empty()) return 0;
+
+    std::scoped_lock<std::mutex> lock(executionMutex_);
+
+    std::vector<std::optional<ID_t> > ids(items.size());
+    if (executeUnlocked("BEGIN IMMEDIATE;")) {
+        for (size_t i = 0; i < items.size(); ++i) {
+            /// ошибка одного INSERT откатывает только его, транзакция продолжается
+            if (insert(items[i])) {
+                ids[i] = sqlite3_last_insert_rowid(db_);
+            }
+        }
 
-    sqlite3_stmt* stmt;
+        if (!executeUnlocked("COMMIT;")) {
+            executeUnlocked("ROLLBACK;");
+            std::fill(ids.begin(), ids.end(), std::nullopt);
+        }
+    }
 
-    if (!prepareExecution(query, &stmt)) return false;
+    size_t saved = 0;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (!ids[i]) {
+            /// заранее выданный ID не должен выдавать несохранённое за сохранённое
+            if constexpr (std::is_same_v<T, Message>) items[i].resetID();
+            continue;
+        }
+        items[i].setID(*ids[i]);
+        ++saved;
+    }
+    return saved;
+}
+
+template <typename... Args>
+bool DB::executeUnlocked(const std::string& query, Args&&... args) {
+    auto lease = statements_.acquire(query);
+    if (!lease) return false;
 
+    sqlite3_stmt* stmt = lease.get();
     unsigned int index = 1;
     bindAll(stmt, index, std::forward<Args>(args)...);
 
@@ -120,7 +430,6 @@ bool DB::execute(const std::string& query, Args&&... args) {
               << sqlite3_errstr(rc) << " | " << sqlite3_errmsg(db_) << std::endl;
     }
 
-    sqlite3_finalize(stmt);
     return success;
 }
 
@@ -133,12 +442,103 @@ bool DB::executeWithCallback(
     if (!db_) {
         throw std::runtime_error("Database not initialized");
     }
+
+    {
+        std::unique_lock<std::mutex> readerLock;
+        if (ReaderConnection* reader = lockReader(readerLock)) {
+            {
+                auto lease = reader->statements.acquire(query);
+                if (!lease) return false;
+
+                if (sqlite3_stmt_readonly(lease.get())) {
+                    return stepRows(reader->db, lease.get(), 
+                        std::forward<Func>(func), std::forward<Args>(args)...);
+                }
+            }
+            /// запись, не пришедшая через writeWithCallback(), в кэше читателя не остаётся
+            reader->statements.erase(query);
+        }
+    }
     
+    return writeWithCallback(std::forward<Func>(func), query, std::forward<Args>(args)...);
+}
+
+template <typename Func, typename... Args>
+bool DB::writeWithCallback(
+    Func&& func,
+    const std::string& query, 
+    Args&&... args
+) {
+    if (!db_) {
+        throw std::runtime_error("Database not initialized");
+    }
+
     std::scoped_lock<std::mutex> lock(executionMutex_);
-    sqlite3_stmt* stmt = nullptr;
+    auto lease = statements_.acquire(query);
+    if (!lease) return false;
+
+    return stepRows(db_, lease.get(), std::forward<Func>(func), std::forward<Args>(args)...);
+}
+
+template <typename... Ts, typename Func, typename... Args>
+bool DB::forEachRow(Func&& func, const std::string& query, Args&&... args) {
+    return executeWithCallback([&func] (sqlite3_stmt* stmt) {
+        if constexpr (std::is_void_v<std::invoke_result_t<Func&, Ts...> >) {
+            std::apply(func, readRow<Ts...>(stmt));
+            return true;
+        }
+        else {
+            return static_cast<bool>(std::apply(func, readRow<Ts...>(stmt)));
+        }
+    }, 
+        query, std::forward<Args>(args)...
+    );
+}
+
+template <typename... Ts, typename... Args>
+std::vector<std::tuple<Ts...> > DB::query(const std::string& query, Args&&... args) {
+    static_assert(!(is_column_view_v<Ts> || ...), "Column views outlive their row, use forEachRow()");
+
+    std::vector<std::tuple<Ts...> > rows;
+    executeWithCallback([&rows] (sqlite3_stmt* stmt) {
+        rows.emplace_back(readRow<Ts...>(stmt));
+        return true;
+    }, 
+        query, std::forward<Args>(args)...
+    );
+    return rows;
+}
+
+template <typename... Ts, typename... Args>
+std::optional<std::tuple<Ts...> > DB::queryOne(const std::string& query, Args&&... args) {
+    static_assert(!(is_column_view_v<Ts> || ...), "Column views outlive their row, use forEachRow()");
 
-    if (!prepareExecution(query, &stmt)) return false;
+    std::optional<std::tuple<Ts...> > row;
+    executeWithCallback([&row] (sqlite3_stmt* stmt) {
+        row = readRow<Ts...>(stmt);
+        return false;
+    }, 
+        query, std::forward<Args>(args)...
+    );
+    return row;
+}
 
+template <typename T, typename... Ts, typename... Args>
+std::vector<T> DB::queryAs(const std::string& query, Args&&... args) {
+    static_assert(!(is_column_view_v<Ts> || ...), "Column views outlive their row, use forEachRow()");
+
+    std::vector<T> rows;
+    executeWithCallback([&rows] (sqlite3_stmt* stmt) {
+        rows.emplace_back(std::make_from_tuple<T>(readRow<Ts...>(stmt)));
+        return true;
+    }, 
+        query, std::forward<Args>(args)...
+    );
+    return rows;
+}
+
+template <typename Func, typename... Args>
+bool DB::stepRows(sqlite3* connection, sqlite3_stmt* stmt, Func&& func, Args&&... args) {
     unsigned int index = 1;
     bindAll(stmt, index, std::forward<Args>(args)...);
 
@@ -151,16 +551,12 @@ bool DB::executeWithCallback(
     
     bool success = (rc == SQLITE_DONE || rc == SQLITE_ROW);
     if (!success) {
-        std::cerr << "Execution error: " << sqlite3_errmsg(db_) << std::endl;
+        std::cerr << "Execution error: " << sqlite3_errmsg(connection) << std::endl;
     }
     if (rc == SQLITE_ERROR || rc == SQLITE_MISUSE || rc == SQLITE_CONSTRAINT) {
-        sqlite3_finalize(stmt);
         return false;
     }
 
-    if (stmt) sqlite3_finalize(stmt);
-    else throw std::runtime_error("Empty stmt");
-
     return success;
 }
 
@@ -176,7 +572,10 @@ void DB::bind(sqlite3_stmt* stmt, unsigned int index, T&& arg) {
     using DecayedT = std::remove_cvref_t<T>;
     int r;
 
-    if constexpr (std::is_same_v<DecayedT, std::optional<std::string>>) {
+    if constexpr (
+                std::is_same_v<DecayedT, std::optional<std::string> > ||
+                std::is_same_v<DecayedT, std::optional<int64_t> >
+        ) {
         if (arg.has_value()) {
             bind(stmt, index, arg.value());
         } else {
@@ -193,20 +592,34 @@ void DB::bind(sqlite3_stmt* stmt, unsigned int index, T&& arg) {
     else if constexpr (std::is_same_v<DecayedT, int64_t>) {
         r = sqlite3_bind_int64(stmt, index, arg);
     }
-    else if constexpr (std::is_same_v<DecayedT, std::string>) {
-        r = sqlite3_bind_text(stmt, index, arg.c_str(), -1, SQLITE_TRANSIENT);
+    /// SQLITE_STATIC без копии: аргументы живут до конца вызова execute*(),
+    /// а Lease сбрасывает привязки раньше, чем они разрушатся
+    else if constexpr (
+                std::is_same_v<DecayedT, std::string> ||
+                std::is_same_v<DecayedT, std::string_view>
+        ) {
+        r = sqlite3_bind_text(stmt, index, arg.data(), static_cast<int>(arg.size()), SQLITE_STATIC);
         if (r != SQLITE_OK) {
             std::cerr << "bind_text failed rc=" << r << " (" << sqlite3_errstr(r)
                     << "): idx=" << index << " value='" << arg << "'\n";
         }
     }
-    else if constexpr (std::is_same_v<DecayedT, const char*> || std::is_same_v<DecayedT, char*>) {
-        r = sqlite3_bind_text(stmt, index, arg, -1, SQLITE_TRANSIENT);
+    else if constexpr (
+                std::is_same_v<std::decay_t<DecayedT>, const char*> || 
+                std::is_same_v<std::decay_t<DecayedT>, char*>
+        ) {
+        r = sqlite3_bind_text(stmt, index, arg, -1, SQLITE_STATIC);
         if (r != SQLITE_OK) {
             std::cerr << "bind_text failed rc=" << r << " (" << sqlite3_errstr(r)
                     << "): idx=" << index << " value='" << arg << "'\n";
         }
     }
+    else if constexpr (
+                std::is_same_v<DecayedT, std::span<const std::byte> > ||
+                std::is_same_v<DecayedT, std::vector<std::byte> >
+        ) {
+        r = sqlite3_bind_blob64(stmt, index, arg.data(), arg.size(), SQLITE_STATIC);
+    }
     else if constexpr (
                 std::is_same_v<DecayedT, nullptr_t> ||
                 std::is_same_v<DecayedT, std::nullopt_t>
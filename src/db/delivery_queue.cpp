@@ -0,0 +1,92 @@
+#include "delivery_queue.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+DeliveryQueue::DeliveryQueue(AsyncDB& db, std::chrono::milliseconds flushDelay, FlushTimer timer) 
+    : 
+        db_(db), 
+        flushDelay_(flushDelay), 
+        timer_(std::move(timer)) 
+{}
+
+DeliveryQueue::~DeliveryQueue() {
+    std::future<void> last;
+    {
+        std::scoped_lock<std::mutex> lock(mutex_);
+        last = std::move(lastFlush_);
+    }
+    if (last.valid()) last.wait();
+
+    flush(db_.sync());
+}
+
+void DeliveryQueue::push(PendingDelivery delivery) {
+    std::scoped_lock<std::mutex> lock(mutex_);
+    queued_.push_back(std::move(delivery));
+    schedule();
+}
+
+void DeliveryQueue::ack(ID_t userID, ID_t chatID, int64_t seq) {
+    if (seq <= 0) return;
+
+    std::scoped_lock<std::mutex> lock(mutex_);
+    int64_t& acked = acks_[{userID, chatID}];
+    acked = std::max(acked, seq);
+    schedule();
+}
+
+void DeliveryQueue::sent(ID_t deliveryID) {
+    std::scoped_lock<std::mutex> lock(mutex_);
+    sent_.push_back(deliveryID);
+    schedule();
+}
+
+void DeliveryQueue::flush(DB& db) {
+    std::scoped_lock<std::mutex> flushLock(flushMutex_);
+
+    std::vector<PendingDelivery> queued;
+    std::map<std::pair<ID_t, ID_t>, int64_t> acks;
+    std::vector<ID_t> sent;
+    {
+        std::scoped_lock<std::mutex> lock(mutex_);
+        queued.swap(queued_);
+        acks.swap(acks_);
+        sent.swap(sent_);
+        scheduled_ = false;
+    }
+    if (queued.empty() && acks.empty() && sent.empty()) return;
+
+    try {
+        /// сначала вставка: подтверждение могло обогнать запись своего кадра
+        size_t saved = db.queueDeliveries(queued);
+        if (saved < queued.size()) {
+            std::cerr << "DeliveryQueue: " << queued.size() - saved << " deliveries were not queued\n";
+        }
+
+        std::vector<DeliveryAck> cleared;
+        cleared.reserve(acks.size());
+        for (const auto& [key, seq] : acks) {
+            cleared.push_back(DeliveryAck{key.first, key.second, seq});
+        }
+        db.clearDeliveries(cleared, sent);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "DeliveryQueue: flush failed: " << e.what() << std::endl;
+    }
+}
+
+void DeliveryQueue::schedule() {
+    if (scheduled_) return;
+    scheduled_ = true;
+
+    if (!timer_ || flushDelay_.count() <= 0) {
+        lastFlush_ = db_.submit([this] (DB& db) { flush(db); });
+        return;
+    }
+    /// всё, что придёт до срабатывания, попадёт в ту же транзакцию
+    timer_(flushDelay_, [this] () {
+        std::scoped_lock<std::mutex> lock(mutex_);
+        lastFlush_ = db_.submit([this] (DB& db) { flush(db); });
+    });
+}
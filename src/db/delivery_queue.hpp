@@ -0,0 +1,63 @@
+#pragma once
+#include <chrono>
+#include <future>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "db.hpp"
+#include "async_db.hpp"
+
+/// @brief Write-behind of PendingDeliveries. Queued frames, acks and sent
+/// one-shot frames are buffered and applied on a DB thread together: 
+/// one flush is queued on AsyncDB at a time, whatever comes meanwhile 
+/// joins the next one. With a FlushTimer the flush starts flushDelay after
+/// the first change, so a burst costs one transaction. Acks of a chat 
+/// collapse into the highest seq
+class DeliveryQueue {
+    AsyncDB& db_;
+    std::chrono::milliseconds flushDelay_;
+    FlushTimer timer_;
+
+    std::mutex mutex_;
+    std::vector<PendingDelivery> queued_;
+    std::map<std::pair<ID_t, ID_t>, int64_t> acks_; // (user, chat) -> seq
+    std::vector<ID_t> sent_;
+    bool scheduled_ = false;
+    std::future<void> lastFlush_;
+
+    std::mutex flushMutex_; // буферы применяются в порядке поступления
+
+public:
+    /// @brief Without a timer every change submits a flush at once, with one
+    /// the changes of flushDelay go to the DB in one flush. Timer callbacks
+    /// must not outlive the queue
+    explicit DeliveryQueue(
+        AsyncDB& db, 
+        std::chrono::milliseconds flushDelay = std::chrono::milliseconds(0), 
+        FlushTimer timer = {}
+    );
+
+    /// @brief Applies what is left, db must still be alive
+    ~DeliveryQueue();
+
+    DeliveryQueue(const DeliveryQueue& other) = delete;
+    DeliveryQueue& operator=(const DeliveryQueue& other) = delete;
+
+    void push(PendingDelivery delivery);
+
+    /// @brief Messages of the chat up to seq reached the user
+    void ack(ID_t userID, ID_t chatID, int64_t seq);
+
+    /// @brief A delivery with seq 0 is sent and is not needed anymore
+    void sent(ID_t deliveryID);
+
+    /// @brief Applies everything buffered before the call on this thread. 
+    /// Called from a DB thread before reading the queue of a user
+    void flush(DB& db);
+
+private:
+    /// под mutex_
+    void schedule();
+};
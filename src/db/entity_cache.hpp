@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "lru_cache.hpp"
+#include "types.hpp"
+
+#define ENTITY_CACHE_CAPACITY 4096
+
+/// @brief Row of User as DB caches it
+struct UserRecord {
+    ID_t id;
+    std::string name;
+    std::string password;
+};
+
+/// @brief Chat with its members as DB caches it. Not a Chat itself:
+/// Chat holds shared_ptr<DB> and would keep its own DB alive
+struct ChatRecord {
+    ID_t id;
+    std::string type;
+    std::optional<std::string> name;
+    std::vector<ID_t> userIDs;
+};
+
+struct EntityCacheStats {
+    CacheStats users;
+    CacheStats chats;
+};
+
+/// @brief Read-through cache of users and chats in front of DB,
+/// by ID and by name. Users never change once saved, chats are
+/// invalidated by DB::save(Chat&) and DB::deleteChat()
+struct EntityCache {
+    ShardedLRUCache<ID_t, UserRecord> usersByID;
+    ShardedLRUCache<std::string, UserRecord> usersByName;
+    ShardedLRUCache<ID_t, ChatRecord> chatsByID;
+    ShardedLRUCache<std::string, ChatRecord> chatsByName; // только группы
+
+    explicit EntityCache(size_t capacity = ENTITY_CACHE_CAPACITY)
+        :
+            usersByID(capacity),
+            usersByName(capacity),
+            chatsByID(capacity),
+            chatsByName(capacity)
+    {}
+
+    EntityCacheStats stats() const {
+        auto sum = [] (CacheStats a, const CacheStats& b) {
+            a.hits += b.hits;
+            a.misses += b.misses;
+            a.evictions += b.evictions;
+            return a;
+        };
+        return EntityCacheStats{
+            sum(usersByID.stats(), usersByName.stats()),
+            sum(chatsByID.stats(), chatsByName.stats())
+        };
+    }
+};
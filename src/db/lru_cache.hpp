@@ -0,0 +1,168 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#define LRU_CACHE_SHARDS 16
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+
+    double hitRatio() const {
+        uint64_t total = hits + misses;
+        return total == 0 ? 0.0 : static_cast<double>(hits) / total;
+    }
+};
+
+/// @brief Thread-safe LRU cache split into independently locked shards,
+/// so lookups of different keys rarely wait for each other.
+/// Capacity is divided between the shards evenly
+template <typename Key, typename Value, typename Hash = std::hash<Key> >
+class ShardedLRUCache {
+    struct Shard {
+        std::mutex mutex;
+        std::list<std::pair<Key, Value> > lru; // в начале - недавно использованные
+        std::unordered_map<Key, typename std::list<std::pair<Key, Value> >::iterator, Hash> index;
+    };
+
+    std::vector<std::unique_ptr<Shard> > shards_;
+    size_t shardCapacity_;
+    Hash hash_;
+
+    std::atomic<uint64_t> epoch_{0};
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+
+public:
+    explicit ShardedLRUCache(size_t capacity, size_t shards = LRU_CACHE_SHARDS);
+
+    ShardedLRUCache(const ShardedLRUCache& other) = delete;
+    ShardedLRUCache& operator=(const ShardedLRUCache& other) = delete;
+
+    std::optional<Value> get(const Key& key);
+
+    /// @brief Read before loading a missing value, passed to put()
+    uint64_t epoch() const { return epoch_.load(std::memory_order_acquire); }
+
+    /// @brief Ignored if anything was erased after epoch was read:
+    /// a value loaded before an invalidation must not outlive it
+    void put(const Key& key, Value value, uint64_t epoch);
+
+    std::optional<Value> erase(const Key& key);
+    void clear();
+
+    size_t size();
+    size_t capacity() const { return shardCapacity_ * shards_.size(); }
+    CacheStats stats() const;
+
+private:
+    Shard& shardFor(const Key& key) { return *shards_[hash_(key) % shards_.size()]; }
+};
+
+
+template <typename Key, typename Value, typename Hash>
+ShardedLRUCache<Key, Value, Hash>::ShardedLRUCache(size_t capacity, size_t shards) {
+    if (shards == 0) shards = 1;
+    shardCapacity_ = std::max<size_t>(1, (capacity + shards - 1) / shards);
+
+    shards_.reserve(shards);
+    for (size_t i = 0; i < shards; ++i) {
+        shards_.emplace_back(std::make_unique<Shard>());
+    }
+}
+
+template <typename Key, typename Value, typename Hash>
+std::optional<Value> ShardedLRUCache<Key, Value, Hash>::get(const Key& key) {
+    Shard& shard = shardFor(key);
+    std::scoped_lock<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return it->second->second;
+}
+
+template <typename Key, typename Value, typename Hash>
+void ShardedLRUCache<Key, Value, Hash>::put(const Key& key, Value value, uint64_t epoch) {
+    Shard& shard = shardFor(key);
+    std::scoped_lock<std::mutex> lock(shard.mutex);
+
+    /// erase() меняет эпоху под замком шарда, так что проверка не опаздывает
+    if (epoch_.load(std::memory_order_acquire) != epoch) return;
+
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        it->second->second = std::move(value);
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+
+    if (shard.lru.size() >= shardCapacity_) {
+        shard.index.erase(shard.lru.back().first);
+        shard.lru.pop_back();
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    shard.lru.emplace_front(key, std::move(value));
+    shard.index.emplace(key, shard.lru.begin());
+}
+
+template <typename Key, typename Value, typename Hash>
+std::optional<Value> ShardedLRUCache<Key, Value, Hash>::erase(const Key& key) {
+    Shard& shard = shardFor(key);
+    std::scoped_lock<std::mutex> lock(shard.mutex);
+    epoch_.fetch_add(1, std::memory_order_acq_rel);
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) return std::nullopt;
+
+    std::optional<Value> value = std::move(it->second->second);
+    shard.lru.erase(it->second);
+    shard.index.erase(it);
+    return value;
+}
+
+template <typename Key, typename Value, typename Hash>
+void ShardedLRUCache<Key, Value, Hash>::clear() {
+    epoch_.fetch_add(1, std::memory_order_acq_rel);
+
+    for (auto& shard : shards_) {
+        std::scoped_lock<std::mutex> lock(shard->mutex);
+        shard->index.clear();
+        shard->lru.clear();
+    }
+}
+
+template <typename Key, typename Value, typename Hash>
+size_t ShardedLRUCache<Key, Value, Hash>::size() {
+    size_t total = 0;
+    for (auto& shard : shards_) {
+        std::scoped_lock<std::mutex> lock(shard->mutex);
+        total += shard->lru.size();
+    }
+    return total;
+}
+
+template <typename Key, typename Value, typename Hash>
+CacheStats ShardedLRUCache<Key, Value, Hash>::stats() const {
+    CacheStats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    stats.evictions = evictions_.load(std::memory_order_relaxed);
+    return stats;
+}
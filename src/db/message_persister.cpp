@@ -0,0 +1,226 @@
+#include "message_persister.hpp"
+
+#include <iostream>
+
+MessagePersister::MessagePersister(std::shared_ptr<DB> db, PersisterOptions options) 
+    : MessagePersister(
+        std::make_shared<SQLiteMessageStore>(std::move(db), options.durability), 
+        options
+    )
+{}
+
+MessagePersister::MessagePersister(std::shared_ptr<MessageStore> store, PersisterOptions options) 
+    : 
+        store_(std::move(store)), 
+        options_(options)
+{
+    if (!store_) {
+        throw std::invalid_argument("MessagePersister: store is null");
+    }
+    if (options_.batchSize == 0) options_.batchSize = 1;
+    if (options_.chatCapacity == 0) options_.chatCapacity = 1;
+
+    queue_.reserve(options_.batchSize);
+
+    thread_ = std::thread(&MessagePersister::run, this);
+}
+
+MessagePersister::~MessagePersister() {
+    stop();
+}
+
+void MessagePersister::persist(Message message, Completion done) {
+    while (true) {
+        {
+            std::scoped_lock<std::mutex> lock(mutex_);
+            if (stopping_) break;
+
+            if (chats_.contains(message.getChatID())) {
+                assignSeq(message);
+                queue_.push_back(Pending{std::move(message), std::move(done)});
+                wakeup_.notify_one();
+                return;
+            }
+        }
+        /// чат могли вытеснить сразу после чтения - тогда читаем снова
+        if (!loadChat(message.getChatID())) break;
+    }
+
+    message.resetID();
+    if (done) done(message);
+}
+
+MessagePersister::Enqueued MessagePersister::enqueue(Message& message, Completion done) {
+    if (!options_.ids) {
+        throw std::logic_error("MessagePersister: enqueue() needs PersisterOptions::ids");
+    }
+
+    {
+        std::scoped_lock<std::mutex> lock(mutex_);
+        if (stopping_) return Enqueued::STOPPING;
+        if (!chats_.contains(message.getChatID())) return Enqueued::UNKNOWN_CHAT;
+
+        message.setID(options_.ids->next());
+        assignSeq(message);
+        queue_.push_back(Pending{message, std::move(done)});
+    }
+    wakeup_.notify_one();
+    return Enqueued::QUEUED;
+}
+
+bool MessagePersister::loadChat(ID_t chatID) {
+    /// чат без записи в chats_ не имеет несохранённых сообщений, а коммиты
+    /// ждут storeMutex_: прочитанный seq последний
+    std::scoped_lock<std::mutex> storeLock(storeMutex_);
+    {
+        std::scoped_lock<std::mutex> lock(mutex_);
+        if (chats_.contains(chatID)) return true;
+    }
+
+    int64_t last = 0;
+    try {
+        last = store_->lastSeq(chatID);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "MessagePersister: can not read seq of chat " << chatID << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    std::scoped_lock<std::mutex> lock(mutex_);
+    ages_.push_front(chatID);
+    chats_.emplace(chatID, ChatSeq{last, 0, ages_.begin()});
+    trim();
+    return true;
+}
+
+std::future<std::optional<ID_t> > MessagePersister::persist(Message message) {
+    auto promise = std::make_shared<std::promise<std::optional<ID_t> > >();
+    auto result = promise->get_future();
+
+    persist(std::move(message), [promise] (const Message& saved) {
+        promise->set_value(saved.getID());
+    });
+    return result;
+}
+
+void MessagePersister::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    flushRequested_ = true;
+    wakeup_.notify_one();
+    drained_.wait(lock, [this] () { return queue_.empty() && !committing_; });
+}
+
+void MessagePersister::stop() {
+    {
+        std::scoped_lock<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        stopping_ = true;
+    }
+    wakeup_.notify_one();
+
+    if (thread_.joinable()) thread_.join();
+}
+
+PersisterStats MessagePersister::stats() {
+    std::scoped_lock<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void MessagePersister::run() {
+    std::vector<Pending> batch;
+    batch.reserve(options_.batchSize);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wakeup_.wait(lock, [this] () { return stopping_ || !queue_.empty(); });
+
+        /// первое сообщение пачки ждёт не дольше flushInterval
+        wakeup_.wait_for(lock, options_.flushInterval, [this] () {
+            return stopping_ || flushRequested_ || queue_.size() >= options_.batchSize;
+        });
+
+        if (queue_.empty()) {
+            if (stopping_) break;
+            continue;
+        }
+
+        size_t count = std::min(queue_.size(), options_.batchSize);
+        batch.assign(
+            std::make_move_iterator(queue_.begin()), 
+            std::make_move_iterator(queue_.begin() + count)
+        );
+        queue_.erase(queue_.begin(), queue_.begin() + count);
+        committing_ = true;
+
+        lock.unlock();
+        commit(batch);
+        batch.clear();
+        lock.lock();
+
+        committing_ = false;
+        if (queue_.empty()) {
+            flushRequested_ = false;
+            drained_.notify_all();
+        }
+    }
+    drained_.notify_all();
+}
+
+void MessagePersister::assignSeq(Message& message) {
+    ChatSeq& chat = chats_.at(message.getChatID());
+    ages_.splice(ages_.begin(), ages_, chat.age);
+    ++chat.unsaved;
+
+    if (message.getSeq() && *message.getSeq() > chat.last) {
+        chat.last = *message.getSeq();
+    }
+    else {
+        message.setSeq(++chat.last);
+    }
+}
+
+void MessagePersister::trim() {
+    /// самый недавний остаётся: его seq могли только что прочитать для enqueue()
+    auto it = ages_.end();
+    while (chats_.size() > options_.chatCapacity && --it != ages_.begin()) {
+        auto chat = chats_.find(*it);
+        if (chat->second.unsaved > 0) continue;
+
+        chats_.erase(chat);
+        it = ages_.erase(it);
+    }
+}
+
+void MessagePersister::commit(std::vector<Pending>& batch) {
+    std::vector<Message> messages;
+    messages.reserve(batch.size());
+    for (auto& pending : batch) {
+        messages.push_back(std::move(pending.message));
+    }
+
+    size_t saved = 0;
+    {
+        std::scoped_lock<std::mutex> storeLock(storeMutex_);
+        try {
+            saved = store_->saveBatch(messages);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "MessagePersister: batch failed: " << e.what() << std::endl;
+            for (auto& message : messages) message.resetID();
+        }
+
+        std::scoped_lock<std::mutex> lock(mutex_);
+        ++stats_.batches;
+        stats_.saved += saved;
+        stats_.failed += batch.size() - saved;
+
+        for (const auto& message : messages) {
+            --chats_.at(message.getChatID()).unsaved;
+        }
+        trim();
+    }
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (batch[i].done) batch[i].done(messages[i]);
+    }
+}
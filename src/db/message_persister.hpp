@@ -0,0 +1,133 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "db.hpp"
+#include "message_store.hpp"
+#include "snowflake.hpp"
+#include "message/message.hpp"
+
+#define PERSISTER_CHAT_CAPACITY 4096
+
+struct PersisterOptions {
+    size_t batchSize = 512;
+    size_t chatCapacity = PERSISTER_CHAT_CAPACITY; // чатов с известным последним seq
+    std::chrono::milliseconds flushInterval{5}; // максимальная задержка первого сообщения пачки
+    Durability durability = Durability::NORMAL; // только для конструктора от DB
+    std::shared_ptr<SnowflakeGenerator> ids; // для enqueue(), ID без записи в хранилище
+};
+
+struct PersisterStats {
+    uint64_t batches = 0;
+    uint64_t saved = 0;
+    uint64_t failed = 0;
+};
+
+/// @brief Write-behind persistence of messages: one thread commits what 
+/// was queued as a single transaction every batchSize messages or 
+/// flushInterval, whichever comes first. Completions run on that thread
+/// after the commit.
+///
+/// Queued messages get the next seq of their chat, so the persister must be
+/// the only writer of messages into its store. seq has gaps only where a
+/// write failed. The last seq is kept for at most chatCapacity chats, the
+/// least recently used chat without unsaved messages is forgotten and read
+/// from the store again by loadChat()
+class MessagePersister {
+public:
+    /// сообщение после коммита: getID() - std::nullopt, если оно не сохранено
+    using Completion = std::function<void(const Message&)>;
+
+    enum class Enqueued {
+        QUEUED,
+        STOPPING,
+        UNKNOWN_CHAT // нужен loadChat()
+    };
+
+private:
+    struct Pending {
+        Message message;
+        Completion done;
+    };
+
+    struct ChatSeq {
+        int64_t last = 0;    // последний выданный seq
+        size_t unsaved = 0;  // в очереди и в коммите, такой чат не вытесняется
+        std::list<ID_t>::iterator age;
+    };
+
+    std::shared_ptr<MessageStore> store_;
+    PersisterOptions options_;
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::condition_variable drained_;
+    std::vector<Pending> queue_;
+    std::unordered_map<ID_t, ChatSeq> chats_;
+    std::list<ID_t> ages_; // в начале - недавно использованные
+    bool stopping_ = false;
+    bool committing_ = false;
+    bool flushRequested_ = false;
+
+    PersisterStats stats_;
+
+    std::mutex storeMutex_; // коммит и чтение seq из хранилища не перемежаются
+
+    std::thread thread_;
+
+public:
+    /// @brief Persists into MessagesHistory of db with options.durability
+    explicit MessagePersister(std::shared_ptr<DB> db, PersisterOptions options = {});
+    explicit MessagePersister(std::shared_ptr<MessageStore> store, PersisterOptions options = {});
+    ~MessagePersister();
+
+    MessagePersister(const MessagePersister& other) = delete;
+    MessagePersister& operator=(const MessagePersister& other) = delete;
+
+    /// @brief Reads the store for a chat it does not know yet, so not for 
+    /// network threads: they use enqueue()
+    void persist(Message message, Completion done);
+
+    /// @brief Gives the message the next ID of options.ids and the next seq
+    /// of its chat and queues a copy under the same lock: queue order is ID
+    /// order, so IDs and seqs grow in every chat. The message can be fanned
+    /// out at once, done reports whether it was saved. Never touches the 
+    /// store: a chat without a known seq gives UNKNOWN_CHAT and the message 
+    /// is not queued until loadChat(). No done call unless QUEUED
+    Enqueued enqueue(Message& message, Completion done);
+    std::future<std::optional<ID_t> > persist(Message message);
+
+    /// @brief Reads the last seq of the chat from the store unless it is 
+    /// known. Blocks on the store between batch commits: called on a DB 
+    /// thread. false if the store failed
+    bool loadChat(ID_t chatID);
+
+    /// @brief Blocks until everything queued before the call is committed
+    void flush();
+
+    /// @brief Commits the rest of the queue and joins the thread
+    void stop();
+
+    PersisterStats stats();
+
+private:
+    void run();
+
+    /// под mutex_, чат известен
+    void assignSeq(Message& message);
+
+    /// под mutex_: забывает давние чаты сверх chatCapacity
+    void trim();
+
+    void commit(std::vector<Pending>& batch);
+};
@@ -0,0 +1,53 @@
+#include "message_store.hpp"
+
+#include <stdexcept>
+
+namespace {
+    const char* synchronousPragma(Durability durability) {
+        switch (durability) {
+        case Durability::FULL:
+            return "PRAGMA synchronous = FULL;";
+        case Durability::OFF:
+            return "PRAGMA synchronous = OFF;";
+        default:
+            return "PRAGMA synchronous = NORMAL;";
+        }
+    }
+}
+
+SQLiteMessageStore::SQLiteMessageStore(std::shared_ptr<DB> db, Durability durability) 
+    : db_(std::move(db)) 
+{
+    if (!db_) {
+        throw std::invalid_argument("SQLiteMessageStore: db is null");
+    }
+    db_->execute(synchronousPragma(durability));
+}
+
+size_t SQLiteMessageStore::saveBatch(std::span<Message> messages) {
+    return db_->saveBatch(messages);
+}
+
+std::vector<Message> SQLiteMessageStore::fetchHistory(ID_t chatID, ID_t beforeID, size_t limit) {
+    return db_->fetchHistory(chatID, beforeID, limit);
+}
+
+std::vector<Message> SQLiteMessageStore::fetchSince(ID_t chatID, ID_t afterID, size_t limit) {
+    return db_->fetchSince(chatID, afterID, limit);
+}
+
+std::vector<Message> SQLiteMessageStore::fetchSinceSeq(ID_t chatID, int64_t afterSeq, size_t limit) {
+    return db_->fetchSinceSeq(chatID, afterSeq, limit);
+}
+
+int64_t SQLiteMessageStore::lastSeq(ID_t chatID) {
+    return db_->lastSeq(chatID);
+}
+
+std::optional<Message> SQLiteMessageStore::findMessage(ID_t chatID, ID_t msgID) {
+    return db_->findMessage(chatID, msgID);
+}
+
+bool SQLiteMessageStore::deleteMessage(ID_t chatID, ID_t msgID) {
+    return db_->deleteMessage(chatID, msgID);
+}
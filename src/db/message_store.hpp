@@ -0,0 +1,64 @@
+#pragma once
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "db.hpp"
+#include "message/message.hpp"
+
+/// @brief How soon a saved batch reaches the disk
+enum class Durability {
+    FULL,   // fsync на каждую пачку
+    NORMAL, // переживает падение процесса, но не ОС
+    OFF     // без fsync, данные может потерять и падение процесса
+};
+
+/// @brief Storage of message bodies. Users, chats and membership stay in DB,
+/// messages go to a backend chosen per deployment
+class MessageStore {
+public:
+    virtual ~MessageStore() = default;
+
+    /// @brief All messages as one batch, saved ones get their IDs
+    virtual size_t saveBatch(std::span<Message> messages) = 0;
+
+    /// @brief Keyset page of the chat older than beforeID, newest first
+    virtual std::vector<Message> fetchHistory(
+        ID_t chatID, 
+        ID_t beforeID = std::numeric_limits<ID_t>::max(), 
+        size_t limit = HISTORY_PAGE_SIZE
+    ) = 0;
+
+    /// @brief Messages of the chat newer than afterID, oldest first
+    virtual std::vector<Message> fetchSince(ID_t chatID, ID_t afterID, size_t limit = HISTORY_PAGE_SIZE) = 0;
+
+    /// @brief Messages of the chat with seq greater than afterSeq, oldest first
+    virtual std::vector<Message> fetchSinceSeq(ID_t chatID, int64_t afterSeq, size_t limit = HISTORY_PAGE_SIZE) = 0;
+
+    /// @brief seq of the newest message of the chat, 0 - no messages
+    virtual int64_t lastSeq(ID_t chatID) = 0;
+
+    virtual std::optional<Message> findMessage(ID_t chatID, ID_t msgID) = 0;
+    virtual bool deleteMessage(ID_t chatID, ID_t msgID) = 0;
+};
+
+/// @brief MessagesHistory table of DB
+class SQLiteMessageStore : public MessageStore {
+    std::shared_ptr<DB> db_;
+
+public:
+    /// @brief Sets PRAGMA synchronous of the writer connection by durability
+    explicit SQLiteMessageStore(std::shared_ptr<DB> db, Durability durability = Durability::NORMAL);
+
+    size_t saveBatch(std::span<Message> messages) override;
+
+    std::vector<Message> fetchHistory(ID_t chatID, ID_t beforeID, size_t limit) override;
+    std::vector<Message> fetchSince(ID_t chatID, ID_t afterID, size_t limit) override;
+    std::vector<Message> fetchSinceSeq(ID_t chatID, int64_t afterSeq, size_t limit) override;
+    int64_t lastSeq(ID_t chatID) override;
+
+    std::optional<Message> findMessage(ID_t chatID, ID_t msgID) override;
+    bool deleteMessage(ID_t chatID, ID_t msgID) override;
+};
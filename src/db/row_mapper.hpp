@@ -0,0 +1,109 @@
+#pragma once
+#include <sqlite3.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// @brief Decodes one column of the current row as T. TEXT and BLOB views
+/// point into SQLite memory and are valid until the next step or reset
+template <typename T>
+struct ColumnReader {
+    static_assert(sizeof(T) == 0, "No ColumnReader for this column type");
+};
+
+template <>
+struct ColumnReader<int> {
+    static int read(sqlite3_stmt* stmt, int index) { return sqlite3_column_int(stmt, index); }
+};
+
+template <>
+struct ColumnReader<int64_t> {
+    static int64_t read(sqlite3_stmt* stmt, int index) { return sqlite3_column_int64(stmt, index); }
+};
+
+template <>
+struct ColumnReader<double> {
+    static double read(sqlite3_stmt* stmt, int index) { return sqlite3_column_double(stmt, index); }
+};
+
+template <>
+struct ColumnReader<bool> {
+    static bool read(sqlite3_stmt* stmt, int index) { return sqlite3_column_int(stmt, index) != 0; }
+};
+
+template <>
+struct ColumnReader<std::string_view> {
+    static std::string_view read(sqlite3_stmt* stmt, int index) {
+        /// сначала text, потом bytes: наоборот SQLite может перекодировать значение
+        auto text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, index));
+        if (!text) return {};
+        return std::string_view(text, static_cast<size_t>(sqlite3_column_bytes(stmt, index)));
+    }
+};
+
+template <>
+struct ColumnReader<std::string> {
+    static std::string read(sqlite3_stmt* stmt, int index) {
+        return std::string(ColumnReader<std::string_view>::read(stmt, index));
+    }
+};
+
+template <>
+struct ColumnReader<std::span<const std::byte> > {
+    static std::span<const std::byte> read(sqlite3_stmt* stmt, int index) {
+        auto data = static_cast<const std::byte*>(sqlite3_column_blob(stmt, index));
+        if (!data) return {};
+        return std::span<const std::byte>(data, static_cast<size_t>(sqlite3_column_bytes(stmt, index)));
+    }
+};
+
+template <>
+struct ColumnReader<std::vector<std::byte> > {
+    static std::vector<std::byte> read(sqlite3_stmt* stmt, int index) {
+        auto blob = ColumnReader<std::span<const std::byte> >::read(stmt, index);
+        return std::vector<std::byte>(blob.begin(), blob.end());
+    }
+};
+
+/// NULL - std::nullopt, иначе значение T
+template <typename T>
+struct ColumnReader<std::optional<T> > {
+    static std::optional<T> read(sqlite3_stmt* stmt, int index) {
+        if (sqlite3_column_type(stmt, index) == SQLITE_NULL) return std::nullopt;
+        return ColumnReader<T>::read(stmt, index);
+    }
+};
+
+
+/// @brief Column types that borrow SQLite memory instead of owning a copy
+template <typename T>
+inline constexpr bool is_column_view_v =
+    std::is_same_v<T, std::string_view> ||
+    std::is_same_v<T, std::span<const std::byte> >;
+
+template <typename T>
+inline constexpr bool is_column_view_v<std::optional<T> > = is_column_view_v<T>;
+
+
+namespace detail {
+
+template <typename... Ts, size_t... Is>
+std::tuple<Ts...> readRow(sqlite3_stmt* stmt, std::index_sequence<Is...>) {
+    return std::tuple<Ts...>{ColumnReader<Ts>::read(stmt, static_cast<int>(Is))...};
+}
+
+} // namespace detail
+
+/// @brief Columns 0..sizeof...(Ts)-1 of the current row
+template <typename... Ts>
+std::tuple<Ts...> readRow(sqlite3_stmt* stmt) {
+    return detail::readRow<Ts...>(stmt, std::index_sequence_for<Ts...>{});
+}
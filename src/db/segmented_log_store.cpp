@@ -0,0 +1,864 @@
+#include "segmented_log_store.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <system_error>
+
+#define LOG_RECORD_MAGIC 0x324c4f47u // "GOL2", запись с seq
+#define LOG_INDEX_MAGIC 0x32444e49u  // "IND2"
+
+namespace {
+    /// запись сегмента: заголовок и сразу за ним текст
+    struct RecordHeader {
+        uint32_t magic;
+        uint32_t size; // байт текста
+        int64_t id;
+        int64_t senderID;
+        int64_t seq;
+        uint32_t checksum; // FNV-1a полей выше и текста
+        uint32_t reserved;
+    };
+    static_assert(sizeof(RecordHeader) == 40);
+
+    /// заголовок .idx, за ним count записей (id, seq, offset)
+    struct IndexFileHeader {
+        uint32_t magic;
+        uint32_t reserved;
+        uint64_t size; // размер сегмента, для которого построен индекс
+        uint64_t records;
+        uint64_t count;
+    };
+
+    uint32_t fnv1a(const void* data, size_t size, uint32_t hash = 2166136261u) {
+        auto bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    uint32_t checksum(const RecordHeader& header, const void* text) {
+        uint32_t hash = fnv1a(&header.size, sizeof(header.size));
+        hash = fnv1a(&header.id, sizeof(header.id), hash);
+        hash = fnv1a(&header.senderID, sizeof(header.senderID), hash);
+        hash = fnv1a(&header.seq, sizeof(header.seq), hash);
+        return fnv1a(text, header.size, hash);
+    }
+
+    /// заголовок целой записи по offset или false, если дальше мусор.
+    /// Контрольная сумма проверяется при сканировании, индексированная часть уже проверена
+    bool readRecord(std::span<const std::byte> data, uint64_t offset, RecordHeader& header, bool verify) {
+        if (data.size() - offset < sizeof(RecordHeader)) return false;
+        std::memcpy(&header, data.data() + offset, sizeof(RecordHeader));
+
+        if (header.magic != LOG_RECORD_MAGIC) return false;
+        if (data.size() - offset - sizeof(RecordHeader) < header.size) return false;
+        return !verify || checksum(header, data.data() + offset + sizeof(RecordHeader)) == header.checksum;
+    }
+
+    /// func(header, offset) для каждой целой записи, возвращает длину целой части
+    template <typename Func>
+    uint64_t scanRecords(std::span<const std::byte> data, Func&& func) {
+        uint64_t offset = 0;
+        RecordHeader header;
+        while (offset < data.size() && readRecord(data, offset, header, true)) {
+            func(header, offset);
+            offset += sizeof(RecordHeader) + header.size;
+        }
+        return offset;
+    }
+
+    [[noreturn]] void throwErrno(const std::string& what) {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    void writeAll(int fd, const void* data, size_t size) {
+        auto bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t written = ::write(fd, bytes, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                throwErrno("SegmentedLogStore: write");
+            }
+            bytes += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+
+    void syncDirectory(const std::filesystem::path& dir) {
+        int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1) return;
+        ::fsync(fd);
+        ::close(fd);
+    }
+
+    std::string segmentName(ID_t baseID) {
+        std::ostringstream name;
+        name << std::setw(20) << std::setfill('0') << baseID << ".log";
+        return name.str();
+    }
+
+    bool isNumber(const std::string& text) {
+        return !text.empty() && std::all_of(text.begin(), text.end(), [] (unsigned char c) {
+            return std::isdigit(c);
+        });
+    }
+
+    bool idLess(const auto& entry, ID_t id) { return entry.id < id; }
+    bool idGreater(ID_t id, const auto& entry) { return id < entry.id; }
+    bool seqGreater(int64_t seq, const auto& entry) { return seq < entry.seq; }
+}
+
+
+SegmentedLogStore::Segment::~Segment() {
+    if (map) ::munmap(const_cast<std::byte*>(map), mapSize);
+}
+
+SegmentedLogStore::ChatLog::~ChatLog() {
+    if (fd != -1) ::close(fd);
+}
+
+SegmentedLogStore::SegmentedLogStore(const std::filesystem::path& dir, LogStoreOptions options)
+    :
+        root_(dir),
+        options_(options)
+{
+    if (options_.segmentBytes == 0) options_.segmentBytes = LOG_SEGMENT_BYTES;
+    if (options_.indexInterval == 0) options_.indexInterval = 1;
+    if (options_.maxOpenFiles == 0) options_.maxOpenFiles = 1;
+
+    std::filesystem::create_directories(root_);
+
+    /// сегменты чата читаются при первом обращении к нему, здесь только каталоги
+    for (const auto& entry : std::filesystem::directory_iterator(root_)) {
+        std::string name = entry.path().filename().string();
+        if (!entry.is_directory() || !isNumber(name)) continue;
+
+        auto log = std::make_unique<ChatLog>();
+        log->dir = entry.path();
+        chats_.emplace(std::stoll(name), std::move(log));
+    }
+    openIDs();
+}
+
+SegmentedLogStore::~SegmentedLogStore() {
+    if (options_.durability != Durability::OFF) {
+        for (auto& [chatID, log] : chats_) {
+            if (log->fd != -1) ::fdatasync(log->fd);
+        }
+    }
+    if (idsFd_ != -1) ::close(idsFd_);
+}
+
+size_t SegmentedLogStore::saveBatch(std::span<Message> messages) {
+    /// одна запись в файл на чат, в порядке прихода сообщений
+    std::map<ID_t, std::vector<Message*> > byChat;
+    for (auto& message : messages) {
+        byChat[message.getChatID()].push_back(&message);
+    }
+
+    size_t saved = 0;
+    for (auto& [chatID, chatMessages] : byChat) {
+        try {
+            ChatLog& log = openChat(chatID);
+            std::scoped_lock<std::mutex> lock(log.mutex);
+            saved += append(log, chatID, chatMessages);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "SegmentedLogStore: chat " << chatID << ": " << e.what() << std::endl;
+            for (Message* message : chatMessages) message->resetID();
+        }
+    }
+    return saved;
+}
+
+std::vector<Message> SegmentedLogStore::fetchHistory(ID_t chatID, ID_t beforeID, size_t limit) {
+    std::vector<Message> result;
+    ChatLog* log = findChat(chatID);
+    if (!log || limit == 0) return result;
+
+    std::scoped_lock<std::mutex> lock(log->mutex);
+    for (auto it = log->segments.rbegin(); it != log->segments.rend() && result.size() < limit; ++it) {
+        Segment& segment = **it;
+        if (segment.baseID >= beforeID) continue;
+        prepare(segment);
+
+        const auto& index = segment.index;
+        size_t start = std::lower_bound(index.begin(), index.end(), beforeID, idLess<IndexEntry>) - index.begin();
+        uint64_t to = start < index.size() ? index[start].offset : segment.size;
+
+        /// идём окнами от beforeID к началу сегмента, пока не наберём страницу
+        while (start > 0 && result.size() < limit) {
+            size_t step = (limit - result.size()) / options_.indexInterval + 1;
+            size_t from = start > step ? start - step : 0;
+
+            std::vector<Message> window;
+            collect(*log, segment, index[from].offset, to, 0, beforeID, chatID, window);
+            for (auto message = window.rbegin(); message != window.rend() && result.size() < limit; ++message) {
+                result.push_back(std::move(*message));
+            }
+
+            start = from;
+            to = index[from].offset;
+        }
+    }
+    return result;
+}
+
+std::vector<Message> SegmentedLogStore::fetchSince(ID_t chatID, ID_t afterID, size_t limit) {
+    ChatLog* log = findChat(chatID);
+    if (!log || limit == 0) return {};
+
+    std::scoped_lock<std::mutex> lock(log->mutex);
+    auto& segments = log->segments;
+    auto first = std::upper_bound(segments.begin(), segments.end(), afterID,
+        [] (ID_t id, const auto& segment) { return id < segment->baseID; }
+    );
+    if (first != segments.begin()) --first;
+
+    return since(*log, chatID, first, Key::ID, afterID, limit);
+}
+
+std::vector<Message> SegmentedLogStore::fetchSinceSeq(ID_t chatID, int64_t afterSeq, size_t limit) {
+    ChatLog* log = findChat(chatID);
+    if (!log || limit == 0) return {};
+
+    std::scoped_lock<std::mutex> lock(log->mutex);
+    if (afterSeq >= log->lastSeq) return {};
+
+    /// имена сегментов - по ID, первый seq известен после prepare().
+    /// Докачка обычно просит хвост, поэтому идём с конца
+    auto& segments = log->segments;
+    auto first = segments.end();
+    while (first != segments.begin()) {
+        --first;
+        prepare(**first);
+
+        const auto& index = (*first)->index;
+        if (!index.empty() && index.front().seq <= afterSeq + 1) break;
+    }
+
+    return since(*log, chatID, first, Key::SEQ, afterSeq, limit);
+}
+
+int64_t SegmentedLogStore::lastSeq(ID_t chatID) {
+    ChatLog* log = findChat(chatID);
+    if (!log) return 0;
+
+    std::scoped_lock<std::mutex> lock(log->mutex);
+    return log->lastSeq;
+}
+
+std::optional<Message> SegmentedLogStore::findMessage(ID_t chatID, ID_t msgID) {
+    ChatLog* log = findChat(chatID);
+    if (!log) return std::nullopt;
+
+    std::scoped_lock<std::mutex> lock(log->mutex);
+    return find(*log, chatID, msgID);
+}
+
+bool SegmentedLogStore::deleteMessage(ID_t chatID, ID_t msgID) {
+    ChatLog* log = findChat(chatID);
+    if (!log) return false;
+
+    std::scoped_lock<std::mutex> lock(log->mutex);
+    if (!find(*log, chatID, msgID)) return false;
+
+    /// сегменты не переписываются: удалённые ID копятся в отдельном файле
+    int fd = ::open((log->dir / "deleted").c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) throwErrno("SegmentedLogStore: open deleted");
+
+    int64_t id = msgID;
+    try {
+        writeAll(fd, &id, sizeof(id));
+    }
+    catch (...) {
+        ::close(fd);
+        throw;
+    }
+    if (options_.durability == Durability::FULL) ::fdatasync(fd);
+    ::close(fd);
+
+    log->deleted.insert(msgID);
+    return true;
+}
+
+size_t SegmentedLogStore::segmentCount(ID_t chatID) {
+    ChatLog* log = findChat(chatID);
+    if (!log) return 0;
+
+    std::scoped_lock<std::mutex> lock(log->mutex);
+    return log->segments.size();
+}
+
+SegmentedLogStore::ChatLog* SegmentedLogStore::findChat(ID_t chatID) {
+    ChatLog* log = nullptr;
+    {
+        std::shared_lock<std::shared_mutex> lock(chatsMutex_);
+        auto it = chats_.find(chatID);
+        if (it == chats_.end()) return nullptr;
+        log = it->second.get();
+    }
+
+    std::scoped_lock<std::mutex> lock(log->mutex);
+    if (!log->loaded) loadChat(*log);
+    return log;
+}
+
+SegmentedLogStore::ChatLog& SegmentedLogStore::openChat(ID_t chatID) {
+    if (ChatLog* log = findChat(chatID)) return *log;
+
+    std::unique_lock<std::shared_mutex> lock(chatsMutex_);
+    auto& log = chats_[chatID];
+    if (!log) {
+        auto created = std::make_unique<ChatLog>();
+        created->dir = root_ / std::to_string(chatID);
+        created->loaded = true;
+        std::filesystem::create_directories(created->dir);
+        log = std::move(created);
+    }
+    return *log;
+}
+
+void SegmentedLogStore::loadChat(ChatLog& log) {
+    /// повтор после неудачной загрузки начинается заново
+    forgetFile(log);
+    log.segments.clear();
+    log.deleted.clear();
+    log.lastID = log.lastSeq = 0;
+
+    std::vector<ID_t> baseIDs;
+    for (const auto& entry : std::filesystem::directory_iterator(log.dir)) {
+        const auto& path = entry.path();
+        if (path.extension() != ".log" || !isNumber(path.stem().string())) continue;
+        baseIDs.push_back(std::stoll(path.stem().string()));
+    }
+    std::sort(baseIDs.begin(), baseIDs.end());
+
+    for (ID_t baseID : baseIDs) {
+        auto segment = std::make_unique<Segment>();
+        segment->baseID = baseID;
+        segment->path = log.dir / segmentName(baseID);
+        log.segments.push_back(std::move(segment));
+    }
+
+    /// пустой последний сегмент остаётся после неудачной записи. Без него
+    /// активным становится предыдущий, и lastSeq берётся из его хвоста
+    std::error_code error;
+    while (log.segments.size() > 1 && std::filesystem::file_size(log.segments.back()->path, error) == 0) {
+        std::filesystem::remove(log.segments.back()->path, error);
+        log.segments.pop_back();
+    }
+    if (!log.segments.empty()) recoverActive(log);
+
+    auto deletedPath = log.dir / "deleted";
+    if (std::filesystem::exists(deletedPath, error)) {
+        int fd = ::open(deletedPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) throwErrno("SegmentedLogStore: open deleted");
+
+        int64_t id;
+        while (::read(fd, &id, sizeof(id)) == sizeof(id)) {
+            log.deleted.insert(id);
+        }
+        ::close(fd);
+    }
+    log.loaded = true;
+}
+
+void SegmentedLogStore::openIDs() {
+    auto path = root_ / "ids";
+    idsFd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (idsFd_ == -1) throwErrno("SegmentedLogStore: open " + path.string());
+
+    int64_t limit = 0;
+    if (::pread(idsFd_, &limit, sizeof(limit), 0) == sizeof(limit) && limit > 0) {
+        idLimit_ = limit;
+        nextID_.store(limit);
+        return;
+    }
+
+    /// лог без границы ID читается целиком один раз: ID общие на все чаты,
+    /// продолжаем после самого нового
+    ID_t lastID = 0;
+    for (auto& [chatID, log] : chats_) {
+        loadChat(*log);
+        lastID = std::max(lastID, log->lastID);
+    }
+    nextID_.store(lastID + 1);
+    reserveIDs(lastID);
+}
+
+void SegmentedLogStore::reserveIDs(ID_t lastID) {
+    std::scoped_lock<std::mutex> lock(idsMutex_);
+    if (lastID < idLimit_) return;
+
+    /// граница с запасом: файл переписывается раз на LOG_ID_RESERVE ID, а не на каждую пачку
+    ID_t limit = lastID + std::min<ID_t>(LOG_ID_RESERVE, std::numeric_limits<ID_t>::max() - lastID);
+
+    if (::pwrite(idsFd_, &limit, sizeof(limit), 0) != sizeof(limit)) {
+        throwErrno("SegmentedLogStore: write ids");
+    }
+    if (options_.durability == Durability::FULL && ::fdatasync(idsFd_) == -1) {
+        throwErrno("SegmentedLogStore: fdatasync ids");
+    }
+    idLimit_ = limit;
+}
+
+int SegmentedLogStore::activeFd(ChatLog& log) {
+    if (log.fd == -1) {
+        const Segment& active = *log.segments.back();
+        log.fd = ::open(active.path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+        if (log.fd == -1) throwErrno("SegmentedLogStore: open " + active.path.string());
+    }
+    touchFile(log);
+    return log.fd;
+}
+
+void SegmentedLogStore::touchFile(ChatLog& log) {
+    std::vector<ChatLog*> evicted;
+    {
+        std::scoped_lock<std::mutex> lock(filesMutex_);
+        if (log.lru) {
+            openFiles_.splice(openFiles_.begin(), openFiles_, *log.lru);
+        }
+        else {
+            log.lru = openFiles_.insert(openFiles_.begin(), &log);
+        }
+
+        /// замок чужого чата только пробуем: его держатель может ждать filesMutex_
+        auto it = openFiles_.end();
+        while (openFiles_.size() > options_.maxOpenFiles && it != openFiles_.begin()) {
+            ChatLog* victim = *--it;
+            if (victim == &log || !victim->mutex.try_lock()) continue;
+
+            victim->lru.reset();
+            it = openFiles_.erase(it);
+            evicted.push_back(victim);
+        }
+    }
+
+    for (ChatLog* victim : evicted) {
+        if (options_.durability != Durability::OFF) ::fdatasync(victim->fd);
+        ::close(victim->fd);
+        victim->fd = -1;
+        victim->mutex.unlock();
+    }
+}
+
+void SegmentedLogStore::forgetFile(ChatLog& log) {
+    if (log.fd == -1) return;
+    {
+        std::scoped_lock<std::mutex> lock(filesMutex_);
+        if (log.lru) openFiles_.erase(*log.lru);
+        log.lru.reset();
+    }
+    ::close(log.fd);
+    log.fd = -1;
+}
+
+size_t SegmentedLogStore::append(ChatLog& log, ID_t chatID, std::vector<Message*>& messages) {
+    if (messages.empty()) return 0;
+
+    /// свои ID берутся под замком чата: в чате они растут в порядке записи.
+    /// Заранее выданные (SnowflakeGenerator) тоже обязаны расти
+    auto missing = std::count_if(messages.begin(), messages.end(), [] (const Message* message) {
+        return !message->getID();
+    });
+    ID_t nextID = missing > 0 ? nextID_.fetch_add(missing) : 0;
+
+    std::vector<ID_t> ids(messages.size());
+    std::vector<int64_t> seqs(messages.size());
+    ID_t previous = log.lastID;
+    int64_t previousSeq = log.lastSeq;
+    for (size_t i = 0; i < messages.size(); ++i) {
+        ids[i] = messages[i]->getID() ? *messages[i]->getID() : nextID++;
+        if (ids[i] <= previous) {
+            throw std::invalid_argument("SegmentedLogStore: message IDs must grow within a chat");
+        }
+        previous = ids[i];
+
+        seqs[i] = messages[i]->getSeq() ? *messages[i]->getSeq() : previousSeq + 1;
+        if (seqs[i] <= previousSeq) {
+            throw std::invalid_argument("SegmentedLogStore: message seqs must grow within a chat");
+        }
+        previousSeq = seqs[i];
+    }
+    reserveIDs(ids.back());
+
+    std::vector<std::byte> buffer;
+    std::vector<IndexEntry> entries;
+    size_t pending = 0;
+    size_t written = 0; // сообщения [0, written) уже в сегментах
+
+    auto write = [&] () {
+        if (pending == 0) return;
+
+        Segment& active = *log.segments.back();
+        try {
+            writeAll(activeFd(log), buffer.data(), buffer.size());
+        }
+        catch (...) {
+            /// недописанный хвост не должен остаться перед следующей пачкой
+            if (::ftruncate(log.fd, static_cast<off_t>(active.size)) == -1) {
+                std::cerr << "SegmentedLogStore: chat " << chatID << ": can not truncate a torn write\n";
+            }
+            throw;
+        }
+        active.size += buffer.size();
+        active.records += pending;
+        active.index.insert(active.index.end(), entries.begin(), entries.end());
+
+        /// записанное остаётся в логе, даже если дальше пачка сорвётся
+        for (size_t i = written; i < written + pending; ++i) {
+            messages[i]->setID(ids[i]);
+            messages[i]->setSeq(seqs[i]);
+        }
+        written += pending;
+        log.lastID = ids[written - 1];
+        log.lastSeq = seqs[written - 1];
+
+        /// свой счётчик не должен выдать ID меньше чужого
+        ID_t expected = nextID_.load();
+        while (expected <= log.lastID && !nextID_.compare_exchange_weak(expected, log.lastID + 1)) {}
+
+        buffer.clear();
+        entries.clear();
+        pending = 0;
+    };
+
+    try {
+        for (size_t i = 0; i < messages.size(); ++i) {
+            ID_t id = ids[i];
+            std::string text = messages[i]->getText();
+            if (text.size() > std::numeric_limits<uint32_t>::max()) {
+                throw std::length_error("SegmentedLogStore: message is too long");
+            }
+            size_t recordSize = sizeof(RecordHeader) + text.size();
+
+            if (log.segments.empty() || !log.segments.back()->active) {
+                openSegment(log, id);
+            }
+            else {
+                Segment& active = *log.segments.back();
+                bool empty = active.records + pending == 0;
+                if (!empty && active.size + buffer.size() + recordSize > options_.segmentBytes) {
+                    write();
+                    sealActive(log);
+                    openSegment(log, id);
+                }
+            }
+
+            Segment& active = *log.segments.back();
+            if ((active.records + pending) % options_.indexInterval == 0) {
+                entries.push_back(IndexEntry{id, seqs[i], active.size + buffer.size()});
+            }
+
+            RecordHeader header{};
+            header.magic = LOG_RECORD_MAGIC;
+            header.size = static_cast<uint32_t>(text.size());
+            header.id = id;
+            header.senderID = messages[i]->getSenderID();
+            header.seq = seqs[i];
+            header.checksum = checksum(header, text.data());
+
+            size_t offset = buffer.size();
+            buffer.resize(offset + recordSize);
+            std::memcpy(buffer.data() + offset, &header, sizeof(header));
+            std::memcpy(buffer.data() + offset + sizeof(header), text.data(), text.size());
+            ++pending;
+        }
+        write();
+
+        if (options_.durability == Durability::FULL && ::fdatasync(log.fd) == -1) {
+            throwErrno("SegmentedLogStore: fdatasync");
+        }
+    }
+    catch (const std::exception& e) {
+        /// несохранёнными считаются только недописанные сообщения
+        std::cerr << "SegmentedLogStore: chat " << chatID << ": " << e.what() << std::endl;
+        for (size_t i = written; i < messages.size(); ++i) messages[i]->resetID();
+    }
+    return written;
+}
+
+void SegmentedLogStore::openSegment(ChatLog& log, ID_t baseID) {
+    auto segment = std::make_unique<Segment>();
+    segment->baseID = baseID;
+    segment->path = log.dir / segmentName(baseID);
+    segment->loaded = true;
+    segment->active = true;
+
+    log.fd = ::open(segment->path.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (log.fd == -1) throwErrno("SegmentedLogStore: open " + segment->path.string());
+    if (options_.durability == Durability::FULL) syncDirectory(log.dir);
+
+    log.segments.push_back(std::move(segment));
+    touchFile(log);
+}
+
+void SegmentedLogStore::sealActive(ChatLog& log) {
+    /// закрытый по LRU сегмент уже синхронизирован
+    if (log.fd != -1 && options_.durability != Durability::OFF) ::fdatasync(log.fd);
+    forgetFile(log);
+
+    log.segments.back()->active = false;
+    writeIndex(*log.segments.back());
+}
+
+void SegmentedLogStore::recoverActive(ChatLog& log) {
+    Segment& active = *log.segments.back();
+
+    log.fd = ::open(active.path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+    if (log.fd == -1) throwErrno("SegmentedLogStore: open " + active.path.string());
+    touchFile(log);
+
+    struct stat st;
+    if (::fstat(log.fd, &st) == -1) throwErrno("SegmentedLogStore: fstat");
+    size_t size = static_cast<size_t>(st.st_size);
+
+    log.lastID = active.baseID - 1;
+    uint64_t valid = 0;
+    if (size > 0) {
+        void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, log.fd, 0);
+        if (map == MAP_FAILED) throwErrno("SegmentedLogStore: mmap");
+
+        std::span<const std::byte> data(static_cast<const std::byte*>(map), size);
+        valid = scanRecords(data, [&] (const RecordHeader& header, uint64_t offset) {
+            if (active.records % options_.indexInterval == 0) {
+                active.index.push_back(IndexEntry{header.id, header.seq, offset});
+            }
+            ++active.records;
+            log.lastID = header.id;
+            log.lastSeq = header.seq;
+        });
+        ::munmap(map, size);
+    }
+
+    /// хвост, недописанный при падении, отрезается
+    if (valid < size) {
+        std::cerr << "SegmentedLogStore: " << active.path.string() << ": cut "
+                  << size - valid << " bytes of a torn tail\n";
+        if (::ftruncate(log.fd, static_cast<off_t>(valid)) == -1) {
+            throwErrno("SegmentedLogStore: ftruncate");
+        }
+    }
+    active.size = valid;
+    active.loaded = true;
+    active.active = true;
+}
+
+void SegmentedLogStore::prepare(Segment& segment) {
+    if (segment.active || segment.map) return;
+    if (segment.loaded && segment.size == 0) return;
+
+    int fd = ::open(segment.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) throwErrno("SegmentedLogStore: open " + segment.path.string());
+
+    struct stat st;
+    if (::fstat(fd, &st) == -1) {
+        ::close(fd);
+        throwErrno("SegmentedLogStore: fstat");
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+
+    if (size > 0) {
+        void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            ::close(fd);
+            throwErrno("SegmentedLogStore: mmap");
+        }
+        segment.map = static_cast<const std::byte*>(map);
+        segment.mapSize = size;
+    }
+    ::close(fd);
+
+    if (segment.loaded) return;
+    if (!readIndex(segment, size)) {
+        /// .idx нет или он от другой версии сегмента - строим заново
+        segment.index.clear();
+        segment.records = 0;
+        segment.size = scanRecords(
+            std::span<const std::byte>(segment.map, size), 
+            [&] (const RecordHeader& header, uint64_t offset) {
+                if (segment.records % options_.indexInterval == 0) {
+                    segment.index.push_back(IndexEntry{header.id, header.seq, offset});
+                }
+                ++segment.records;
+            }
+        );
+    }
+    segment.loaded = true;
+}
+
+bool SegmentedLogStore::readIndex(Segment& segment, size_t size) {
+    auto path = segment.path;
+    path.replace_extension(".idx");
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+
+    IndexFileHeader header;
+    bool valid = ::read(fd, &header, sizeof(header)) == sizeof(header)
+        && header.magic == LOG_INDEX_MAGIC
+        && header.size == size;
+
+    if (valid) {
+        segment.index.resize(header.count);
+        size_t bytes = header.count * sizeof(IndexEntry);
+        valid = ::read(fd, segment.index.data(), bytes) == static_cast<ssize_t>(bytes);
+    }
+    ::close(fd);
+
+    if (valid) {
+        segment.size = header.size;
+        segment.records = header.records;
+    }
+    return valid;
+}
+
+std::span<const std::byte> SegmentedLogStore::view(
+    ChatLog& log, Segment& segment,
+    uint64_t from, uint64_t to,
+    std::vector<std::byte>& buffer
+) {
+    if (!segment.active) {
+        return std::span<const std::byte>(segment.map + from, to - from);
+    }
+
+    int fd = activeFd(log);
+    buffer.resize(to - from);
+    size_t done = 0;
+    while (done < buffer.size()) {
+        ssize_t got = ::pread(fd, buffer.data() + done, buffer.size() - done, from + done);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            throwErrno("SegmentedLogStore: pread");
+        }
+        if (got == 0) break;
+        done += static_cast<size_t>(got);
+    }
+    return std::span<const std::byte>(buffer.data(), done);
+}
+
+std::vector<Message> SegmentedLogStore::since(
+    ChatLog& log, ID_t chatID,
+    std::vector<std::unique_ptr<Segment> >::iterator first,
+    Key key, int64_t after, size_t limit
+) {
+    std::vector<Message> result;
+    for (auto it = first; it != log.segments.end() && result.size() < limit; ++it) {
+        Segment& segment = **it;
+        prepare(segment);
+
+        const auto& index = segment.index;
+        auto bound = key == Key::SEQ
+            ? std::upper_bound(index.begin(), index.end(), after, seqGreater<IndexEntry>)
+            : std::upper_bound(index.begin(), index.end(), after, idGreater<IndexEntry>);
+        size_t start = bound - index.begin();
+        if (start > 0) --start;
+
+        while (start < index.size() && result.size() < limit) {
+            size_t step = (limit - result.size()) / options_.indexInterval + 1;
+            size_t to = std::min(start + step, index.size());
+            uint64_t end = to < index.size() ? index[to].offset : segment.size;
+
+            collect(log, segment, index[start].offset, end, after + 1,
+                std::numeric_limits<int64_t>::max(), chatID, result, key
+            );
+            start = to;
+        }
+    }
+    if (result.size() > limit) result.erase(result.begin() + limit, result.end());
+    return result;
+}
+
+void SegmentedLogStore::collect(
+    ChatLog& log, Segment& segment,
+    uint64_t from, uint64_t to,
+    int64_t lo, int64_t hi,
+    ID_t chatID, std::vector<Message>& out,
+    Key key
+) {
+    if (from >= to) return;
+
+    std::vector<std::byte> buffer;
+    auto data = view(log, segment, from, to, buffer);
+
+    uint64_t offset = 0;
+    RecordHeader header;
+    while (offset < data.size() && readRecord(data, offset, header, false)) {
+        /// внутри сегмента ID и seq только растут
+        int64_t value = key == Key::SEQ ? header.seq : header.id;
+        if (value >= hi) break;
+
+        if (value >= lo && !log.deleted.contains(header.id)) {
+            auto text = reinterpret_cast<const char*>(data.data() + offset + sizeof(RecordHeader));
+            Message message(chatID, header.senderID, std::string(text, header.size));
+            message.setID(header.id);
+            message.setSeq(header.seq);
+            out.push_back(std::move(message));
+        }
+        offset += sizeof(RecordHeader) + header.size;
+    }
+}
+
+std::optional<Message> SegmentedLogStore::find(ChatLog& log, ID_t chatID, ID_t msgID) {
+    if (log.deleted.contains(msgID)) return std::nullopt;
+
+    auto& segments = log.segments;
+    auto it = std::upper_bound(segments.begin(), segments.end(), msgID,
+        [] (ID_t id, const auto& segment) { return id < segment->baseID; }
+    );
+    if (it == segments.begin()) return std::nullopt;
+    Segment& segment = **--it;
+    prepare(segment);
+
+    const auto& index = segment.index;
+    size_t entry = std::upper_bound(index.begin(), index.end(), msgID, idGreater<IndexEntry>) - index.begin();
+    if (entry == 0) return std::nullopt;
+    --entry;
+
+    uint64_t to = entry + 1 < index.size() ? index[entry + 1].offset : segment.size;
+    std::vector<Message> found;
+    collect(log, segment, index[entry].offset, to, msgID, msgID + 1, chatID, found);
+
+    if (found.empty()) return std::nullopt;
+    return std::move(found.front());
+}
+
+void SegmentedLogStore::writeIndex(const Segment& segment) {
+    auto path = segment.path;
+    path.replace_extension(".idx");
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_TRUNC | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        std::cerr << "SegmentedLogStore: can not write " << path.string() << std::endl;
+        return;
+    }
+
+    IndexFileHeader header{LOG_INDEX_MAGIC, 0, segment.size, segment.records, segment.index.size()};
+    try {
+        writeAll(fd, &header, sizeof(header));
+        writeAll(fd, segment.index.data(), segment.index.size() * sizeof(IndexEntry));
+    }
+    catch (const std::exception& e) {
+        /// индекс только ускоряет открытие, без него сегмент перечитывается
+        std::cerr << e.what() << std::endl;
+        ::close(fd);
+        std::filesystem::remove(path);
+        return;
+    }
+    ::close(fd);
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "message_store.hpp"
+
+#define LOG_SEGMENT_BYTES (64 * 1024 * 1024)
+#define LOG_INDEX_INTERVAL 64
+#define LOG_MAX_OPEN_FILES 256
+#define LOG_ID_RESERVE (int64_t(1) << 32)
+
+struct LogStoreOptions {
+    size_t segmentBytes = LOG_SEGMENT_BYTES; // после него сегмент запечатывается
+    size_t indexInterval = LOG_INDEX_INTERVAL; // каждая N-я запись попадает в разреженный индекс
+    Durability durability = Durability::NORMAL;
+    size_t maxOpenFiles = LOG_MAX_OPEN_FILES; // открытых активных сегментов, остальные закрываются по LRU
+};
+
+/// @brief Append-only message log: a directory per chat with segment files
+/// named by the first message ID. Only the last segment of a chat is written,
+/// sealed ones are memory-mapped on first read. A sparse (ID, offset) index
+/// finds a page without reading the whole segment.
+///
+/// FULL - fdatasync once per chat per batch, NORMAL - on sealing and closing
+/// segments, OFF - never. IDs are unique over all chats and grow in every chat
+/// in the order messages were saved. A message with an ID keeps it, but the ID
+/// must be greater than the last one of its chat. The same holds for seq:
+/// a message without one gets the next seq of its chat.
+///
+/// A chat is read from disk on first use. The file "ids" keeps a bound of all
+/// IDs in the log, so the store opens without scanning the chats. Active
+/// segments of at most maxOpenFiles chats stay open, the least recently used
+/// are closed and reopened on the next write or read
+class SegmentedLogStore : public MessageStore {
+    struct IndexEntry {
+        ID_t id;
+        int64_t seq;
+        uint64_t offset;
+    };
+
+    /// по какому полю записи collect() отбирает диапазон
+    enum class Key { ID, SEQ };
+
+    struct Segment {
+        ID_t baseID;
+        std::filesystem::path path;
+        uint64_t size = 0;
+        size_t records = 0;
+        std::vector<IndexEntry> index;
+        bool loaded = false; // индекс запечатанного сегмента читается при первом чтении
+        bool active = false; // последний сегмент чата, в него дописывают
+
+        const std::byte* map = nullptr; // только у запечатанных
+        size_t mapSize = 0;
+
+        ~Segment();
+    };
+
+    struct ChatLog {
+        std::mutex mutex;
+        std::filesystem::path dir;
+        std::vector<std::unique_ptr<Segment> > segments; // последний - активный
+        int fd = -1; // активный сегмент, O_APPEND; закрывается, если чат давно не трогали
+        std::optional<std::list<ChatLog*>::iterator> lru; // место в openFiles_, пока fd открыт
+        bool loaded = false; // каталог прочитан при первом обращении к чату
+        ID_t lastID = 0;
+        int64_t lastSeq = 0;
+        std::unordered_set<ID_t> deleted;
+
+        ~ChatLog();
+    };
+
+    std::filesystem::path root_;
+    LogStoreOptions options_;
+
+    std::shared_mutex chatsMutex_;
+    std::unordered_map<ID_t, std::unique_ptr<ChatLog> > chats_;
+
+    std::atomic<ID_t> nextID_{1};
+
+    std::mutex idsMutex_;
+    int idsFd_ = -1;
+    ID_t idLimit_ = 0; // все ID лога меньше него, хранится в файле ids
+
+    std::mutex filesMutex_;
+    std::list<ChatLog*> openFiles_; // в начале - недавно использованные
+
+public:
+    /// @brief Opens or creates the log in dir, a torn tail of an active
+    /// segment is cut off
+    explicit SegmentedLogStore(const std::filesystem::path& dir, LogStoreOptions options = {});
+    ~SegmentedLogStore() override;
+
+    SegmentedLogStore(const SegmentedLogStore& other) = delete;
+    SegmentedLogStore& operator=(const SegmentedLogStore& other) = delete;
+
+    size_t saveBatch(std::span<Message> messages) override;
+
+    std::vector<Message> fetchHistory(ID_t chatID, ID_t beforeID, size_t limit) override;
+    std::vector<Message> fetchSince(ID_t chatID, ID_t afterID, size_t limit) override;
+    std::vector<Message> fetchSinceSeq(ID_t chatID, int64_t afterSeq, size_t limit) override;
+    int64_t lastSeq(ID_t chatID) override;
+
+    std::optional<Message> findMessage(ID_t chatID, ID_t msgID) override;
+    bool deleteMessage(ID_t chatID, ID_t msgID) override;
+
+    /// @brief Segments of the chat, sealed and active
+    size_t segmentCount(ID_t chatID);
+
+private:
+    ChatLog* findChat(ID_t chatID);
+    ChatLog& openChat(ID_t chatID);
+    void loadChat(ChatLog& log);
+
+    /// @brief Reads the ID bound of the log, an old log without one is scanned
+    void openIDs();
+    /// @brief Persists a bound above lastID before IDs up to it are written
+    void reserveIDs(ID_t lastID);
+
+    /// @brief fd of the active segment, reopened if it was closed by the LRU
+    int activeFd(ChatLog& log);
+    /// @brief Marks the fd of the chat as recently used and closes
+    /// the least recently used ones above maxOpenFiles
+    void touchFile(ChatLog& log);
+    void forgetFile(ChatLog& log);
+
+    size_t append(ChatLog& log, ID_t chatID, std::vector<Message*>& messages);
+    void openSegment(ChatLog& log, ID_t baseID);
+    void sealActive(ChatLog& log);
+    void recoverActive(ChatLog& log);
+    void writeIndex(const Segment& segment);
+
+    /// @brief Maps a sealed segment and loads its index on first use
+    void prepare(Segment& segment);
+    bool readIndex(Segment& segment, size_t size);
+
+    std::optional<Message> find(ChatLog& log, ID_t chatID, ID_t msgID);
+
+    /// @brief Bytes [from, to) of the segment: the mapping of a sealed one
+    /// or a pread of the active one into buffer
+    std::span<const std::byte> view(
+        ChatLog& log, Segment& segment,
+        uint64_t from, uint64_t to,
+        std::vector<std::byte>& buffer
+    );
+
+    /// @brief Messages of the chat after the given id or seq, oldest first,
+    /// starting from the segment first
+    std::vector<Message> since(
+        ChatLog& log, ID_t chatID,
+        std::vector<std::unique_ptr<Segment> >::iterator first,
+        Key key, int64_t after, size_t limit
+    );
+
+    /// @brief Messages of [from, to) with lo <= key < hi, oldest first
+    void collect(
+        ChatLog& log, Segment& segment,
+        uint64_t from, uint64_t to,
+        int64_t lo, int64_t hi,
+        ID_t chatID, std::vector<Message>& out,
+        Key key = Key::ID
+    );
+};
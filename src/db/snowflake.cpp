@@ -0,0 +1,46 @@
+#include "snowflake.hpp"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+SnowflakeGenerator::SnowflakeGenerator(int64_t node) 
+    : node_(node) 
+{
+    if (node < 0 || node > Max_Node) {
+        throw std::invalid_argument("SnowflakeGenerator: node must be in [0, " + std::to_string(Max_Node) + "]");
+    }
+}
+
+ID_t SnowflakeGenerator::next() {
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count() - SNOWFLAKE_EPOCH_MS;
+
+    ID_t last = last_.load(std::memory_order_relaxed);
+    ID_t id;
+    do {
+        int64_t lastMillis = last >> (SNOWFLAKE_NODE_BITS + SNOWFLAKE_SEQUENCE_BITS);
+        int64_t sequence = last & Max_Sequence;
+
+        if (now > lastMillis) {
+            id = compose(now, 0);
+        }
+        /// часы отстали или миллисекунда занята: продолжаем от последнего ID,
+        /// а кончившуюся последовательность берём у следующей миллисекунды
+        else if (sequence < Max_Sequence) {
+            id = compose(lastMillis, sequence + 1);
+        }
+        else {
+            id = compose(lastMillis + 1, 0);
+        }
+    } while (!last_.compare_exchange_weak(last, id, std::memory_order_relaxed));
+
+    return id;
+}
+
+ID_t SnowflakeGenerator::compose(int64_t millis, int64_t sequence) const {
+    return (millis << (SNOWFLAKE_NODE_BITS + SNOWFLAKE_SEQUENCE_BITS)) 
+        | (node_ << SNOWFLAKE_SEQUENCE_BITS) 
+        | sequence;
+}
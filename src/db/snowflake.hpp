@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#include "types.hpp"
+
+#define SNOWFLAKE_EPOCH_MS 1704067200000LL // 2024-01-01 00:00:00 UTC
+#define SNOWFLAKE_NODE_BITS 10
+#define SNOWFLAKE_SEQUENCE_BITS 12
+
+/// @brief 64-bit IDs made without the database: 41 bits of milliseconds since
+/// SNOWFLAKE_EPOCH_MS, 10 bits of node and 12 bits of sequence. Lock-free and
+/// strictly increasing for all threads of the generator, so IDs of different
+/// nodes never collide and sort by time
+class SnowflakeGenerator {
+    int64_t node_;
+    std::atomic<int64_t> last_{0};
+
+public:
+    static constexpr int64_t Max_Node = (1LL << SNOWFLAKE_NODE_BITS) - 1;
+    static constexpr int64_t Max_Sequence = (1LL << SNOWFLAKE_SEQUENCE_BITS) - 1;
+
+    /// @brief node must be unique among the servers writing the same chats
+    explicit SnowflakeGenerator(int64_t node = 0);
+
+    SnowflakeGenerator(const SnowflakeGenerator& other) = delete;
+    SnowflakeGenerator& operator=(const SnowflakeGenerator& other) = delete;
+
+    ID_t next();
+
+    int64_t node() const { return node_; }
+
+    /// @brief Unix time in milliseconds when id was made
+    static int64_t timestampOf(ID_t id) { 
+        return (id >> (SNOWFLAKE_NODE_BITS + SNOWFLAKE_SEQUENCE_BITS)) + SNOWFLAKE_EPOCH_MS; 
+    }
+    static int64_t nodeOf(ID_t id) { return (id >> SNOWFLAKE_SEQUENCE_BITS) & Max_Node; }
+    static int64_t sequenceOf(ID_t id) { return id & Max_Sequence; }
+
+private:
+    ID_t compose(int64_t millis, int64_t sequence) const;
+};
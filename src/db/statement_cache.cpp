@@ -0,0 +1,106 @@
+#include "statement_cache.hpp"
+
+#include <iostream>
+#include <utility>
+
+StatementCache::Lease::~Lease() {
+    if (stmt_) {
+        sqlite3_reset(stmt_);
+        sqlite3_clear_bindings(stmt_);
+    }
+}
+
+StatementCache::Lease::Lease(Lease&& other) noexcept 
+    : stmt_(std::exchange(other.stmt_, nullptr))
+{}
+
+StatementCache::StatementCache(size_t capacity) 
+    : capacity_(capacity == 0 ? 1 : capacity)
+{}
+
+StatementCache::~StatementCache() {
+    clear();
+}
+
+StatementCache::StatementCache(StatementCache&& other) noexcept 
+    : 
+        db_(std::exchange(other.db_, nullptr)),
+        capacity_(other.capacity_),
+        lru_(std::move(other.lru_)),
+        index_(std::move(other.index_)),
+        stats_(other.stats_)
+{
+    other.lru_.clear();
+    other.index_.clear();
+}
+
+StatementCache& StatementCache::operator=(StatementCache&& other) noexcept {
+    if (this != &other) {
+        clear();
+
+        db_ = std::exchange(other.db_, nullptr);
+        capacity_ = other.capacity_;
+        lru_ = std::move(other.lru_);
+        index_ = std::move(other.index_);
+        stats_ = other.stats_;
+
+        other.lru_.clear();
+        other.index_.clear();
+    }
+    return *this;
+}
+
+void StatementCache::attach(sqlite3* db) {
+    clear();
+    db_ = db;
+}
+
+StatementCache::Lease StatementCache::acquire(const std::string& query) {
+    auto found = index_.find(query);
+    if (found != index_.end()) {
+        ++stats_.hits;
+        lru_.splice(lru_.begin(), lru_, found->second);
+        return Lease(found->second->stmt);
+    }
+
+    ++stats_.misses;
+
+    sqlite3_stmt* stmt = nullptr;
+    /// PERSISTENT: подсказка SQLite, что оператор будет жить долго
+    if (sqlite3_prepare_v3(db_, query.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "Preparing statement error: " << sqlite3_errmsg(db_) << std::endl;
+        sqlite3_finalize(stmt);
+        return Lease();
+    }
+    if (!stmt) return Lease(); // пустой запрос
+
+    if (lru_.size() >= capacity_) {
+        Entry& oldest = lru_.back();
+        index_.erase(oldest.query);
+        sqlite3_finalize(oldest.stmt);
+        lru_.pop_back();
+        ++stats_.evictions;
+    }
+
+    lru_.push_front(Entry{query, stmt});
+    index_.emplace(query, lru_.begin());
+
+    return Lease(stmt);
+}
+
+void StatementCache::erase(const std::string& query) {
+    auto found = index_.find(query);
+    if (found == index_.end()) return;
+
+    sqlite3_finalize(found->second->stmt);
+    lru_.erase(found->second);
+    index_.erase(found);
+}
+
+void StatementCache::clear() {
+    for (auto& entry : lru_) {
+        sqlite3_finalize(entry.stmt);
+    }
+    lru_.clear();
+    index_.clear();
+}
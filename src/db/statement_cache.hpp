@@ -0,0 +1,81 @@
+#pragma once
+#include <sqlite3.h>
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#define STATEMENT_CACHE_CAPACITY 64
+
+struct StatementCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;    // подготовка через sqlite3_prepare_v3
+    uint64_t evictions = 0;
+};
+
+/// @brief LRU cache of the prepared statements of one connection, keyed by 
+/// the query text. Not thread-safe: the owner serializes access (DB does it 
+/// under its execution mutex)
+class StatementCache {
+public:
+    /// @brief A statement taken from the cache. Resets it and clears 
+    /// its bindings on destruction, so it is ready for the next acquire()
+    class Lease {
+        sqlite3_stmt* stmt_ = nullptr;
+
+    public:
+        Lease() = default;
+        explicit Lease(sqlite3_stmt* stmt) : stmt_(stmt) {}
+        ~Lease();
+
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) = delete;
+
+        Lease(const Lease& other) = delete;
+        Lease& operator=(const Lease& other) = delete;
+
+        sqlite3_stmt* get() const { return stmt_; }
+        explicit operator bool() const { return stmt_ != nullptr; }
+    };
+
+private:
+    struct Entry {
+        std::string query;
+        sqlite3_stmt* stmt;
+    };
+
+    sqlite3* db_ = nullptr;
+    size_t capacity_;
+
+    std::list<Entry> lru_; // в начале - недавно использованные
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+
+    StatementCacheStats stats_;
+
+public:
+    explicit StatementCache(size_t capacity = STATEMENT_CACHE_CAPACITY);
+    ~StatementCache();
+
+    StatementCache(const StatementCache& other) = delete;
+    StatementCache& operator=(const StatementCache& other) = delete;
+
+    StatementCache(StatementCache&& other) noexcept;
+    StatementCache& operator=(StatementCache&& other) noexcept;
+
+    /// @brief Finalizes the cached statements and switches to another connection
+    void attach(sqlite3* db);
+
+    /// @brief Empty lease if the query does not compile
+    Lease acquire(const std::string& query);
+
+    /// @brief Finalizes the statement of the query, it must not be leased
+    void erase(const std::string& query);
+
+    /// @brief Finalizes every cached statement, required before sqlite3_close()
+    void clear();
+
+    size_t size() const { return lru_.size(); }
+    size_t capacity() const { return capacity_; }
+    const StatementCacheStats& stats() const { return stats_; }
+};
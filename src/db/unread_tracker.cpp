@@ -0,0 +1,91 @@
+#include "unread_tracker.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+UnreadTracker::UnreadTracker(AsyncDB& db, std::chrono::milliseconds flushDelay, FlushTimer timer) 
+    : 
+        db_(db), 
+        flushDelay_(flushDelay), 
+        timer_(std::move(timer)) 
+{}
+
+UnreadTracker::~UnreadTracker() {
+    std::future<void> last;
+    {
+        std::scoped_lock<std::mutex> lock(mutex_);
+        last = std::move(lastFlush_);
+    }
+    if (last.valid()) last.wait();
+
+    flush(db_.sync());
+}
+
+void UnreadTracker::posted(ID_t chatID, ID_t senderID, int64_t seq) {
+    if (seq <= 0) return;
+
+    std::scoped_lock<std::mutex> lock(mutex_);
+    posted_[{chatID, senderID}].push_back(seq);
+
+    /// своё сообщение - отметка о прочтении чата до него
+    int64_t& read = reads_[{senderID, chatID}];
+    read = std::max(read, seq);
+    schedule();
+}
+
+void UnreadTracker::read(ID_t userID, ID_t chatID, int64_t seq) {
+    if (seq <= 0) return;
+
+    std::scoped_lock<std::mutex> lock(mutex_);
+    int64_t& read = reads_[{userID, chatID}];
+    read = std::max(read, seq);
+    schedule();
+}
+
+void UnreadTracker::flush(DB& db) {
+    std::scoped_lock<std::mutex> flushLock(flushMutex_);
+
+    std::map<std::pair<ID_t, ID_t>, std::vector<int64_t> > posted;
+    std::map<std::pair<ID_t, ID_t>, int64_t> reads;
+    {
+        std::scoped_lock<std::mutex> lock(mutex_);
+        posted.swap(posted_);
+        reads.swap(reads_);
+        scheduled_ = false;
+    }
+    if (posted.empty() && reads.empty()) return;
+
+    std::vector<UnreadIncrement> increments;
+    increments.reserve(posted.size());
+    for (auto& [key, seqs] : posted) {
+        increments.push_back(UnreadIncrement{key.first, key.second, std::move(seqs)});
+    }
+
+    std::vector<ReadReceipt> receipts;
+    receipts.reserve(reads.size());
+    for (const auto& [key, seq] : reads) {
+        receipts.push_back(ReadReceipt{key.first, key.second, seq});
+    }
+
+    try {
+        db.updateUnread(increments, receipts);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "UnreadTracker: flush failed: " << e.what() << std::endl;
+    }
+}
+
+void UnreadTracker::schedule() {
+    if (scheduled_) return;
+    scheduled_ = true;
+
+    if (!timer_ || flushDelay_.count() <= 0) {
+        lastFlush_ = db_.submit([this] (DB& db) { flush(db); });
+        return;
+    }
+    /// всё, что придёт до срабатывания, попадёт в ту же транзакцию
+    timer_(flushDelay_, [this] () {
+        std::scoped_lock<std::mutex> lock(mutex_);
+        lastFlush_ = db_.submit([this] (DB& db) { flush(db); });
+    });
+}
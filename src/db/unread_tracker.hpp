@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <future>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "db.hpp"
+#include "async_db.hpp"
+
+/// @brief Write-behind of UnreadCounters, same scheme as DeliveryQueue: 
+/// saved messages and read receipts are buffered and applied by one 
+/// DB::updateUnread() on a DB thread. Receipts of a chat collapse into 
+/// the highest seq per user, so a client reading message by message 
+/// costs one range update per flush
+class UnreadTracker {
+    AsyncDB& db_;
+    std::chrono::milliseconds flushDelay_;
+    FlushTimer timer_;
+
+    std::mutex mutex_;
+    std::map<std::pair<ID_t, ID_t>, std::vector<int64_t> > posted_; // (chat, sender) -> seqs
+    std::map<std::pair<ID_t, ID_t>, int64_t> reads_;                // (user, chat) -> seq
+    bool scheduled_ = false;
+    std::future<void> lastFlush_;
+
+    std::mutex flushMutex_; // буферы применяются в порядке поступления
+
+public:
+    /// @brief Without a timer every change submits a flush at once, with one
+    /// the changes of flushDelay go to the DB in one flush. Timer callbacks
+    /// must not outlive the tracker
+    explicit UnreadTracker(
+        AsyncDB& db, 
+        std::chrono::milliseconds flushDelay = std::chrono::milliseconds(0), 
+        FlushTimer timer = {}
+    );
+
+    /// @brief Applies what is left, db must still be alive
+    ~UnreadTracker();
+
+    UnreadTracker(const UnreadTracker& other) = delete;
+    UnreadTracker& operator=(const UnreadTracker& other) = delete;
+
+    /// @brief The message is saved: unread for everyone in the chat except
+    /// the sender, who has read the chat up to it
+    void posted(ID_t chatID, ID_t senderID, int64_t seq);
+
+    /// @brief The user has read the chat up to seq
+    void read(ID_t userID, ID_t chatID, int64_t seq);
+
+    /// @brief Applies everything buffered before the call on this thread. 
+    /// Called from a DB thread before reading the counters
+    void flush(DB& db);
+
+private:
+    /// под mutex_
+    void schedule();
+};
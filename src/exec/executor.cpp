@@ -0,0 +1,107 @@
+#include "executor.hpp"
+
+#include <algorithm>
+
+namespace {
+    /// воркер текущего потока, nullptr вне пула
+    thread_local const Executor* current_executor = nullptr;
+    thread_local size_t current_index = 0;
+}
+
+Executor::Executor(size_t threads_count) {
+    threads_count = std::max<size_t>(1, threads_count);
+
+    workers.reserve(threads_count);
+    for (size_t i = 0; i < threads_count; ++i) {
+        workers.emplace_back(std::make_unique<Worker>());
+    }
+
+    threads.reserve(threads_count);
+    for (size_t i = 0; i < threads_count; ++i) {
+        threads.emplace_back(&Executor::run, this, i);
+    }
+}
+
+Executor::~Executor() {
+    stop();
+}
+
+void Executor::submit(Task task) {
+    size_t index = (current_executor == this) 
+        ? current_index 
+        : next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+    /// счётчик растёт до публикации, чтобы не уйти в минус при быстрой краже
+    pending.fetch_add(1);
+    {
+        std::scoped_lock lock(workers[index]->mtx);
+        workers[index]->tasks.emplace_back(std::move(task));
+    }
+
+    {
+        /// пустая критическая секция: воркер не пропустит notify между проверкой и wait
+        std::scoped_lock lock(sleep_mtx);
+    }
+    sleep_cv.notify_one();
+}
+
+void Executor::stop() {
+    if (!is_active.exchange(false)) return;
+
+    {
+        std::scoped_lock lock(sleep_mtx);
+    }
+    sleep_cv.notify_all();
+
+    for (auto& thread : threads) {
+        if (thread.joinable()) thread.join();
+    }
+}
+
+void Executor::run(size_t index) {
+    current_executor = this;
+    current_index = index;
+
+    Task task;
+    while (true) {
+        if (tryTake(index, task)) {
+            pending.fetch_sub(1);
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock lock(sleep_mtx);
+        sleep_cv.wait(lock, [this] () { 
+            return pending.load() > 0 || !is_active.load(); 
+        });
+
+        if (!is_active && pending.load() == 0) break;
+    }
+
+    current_executor = nullptr;
+}
+
+bool Executor::tryTake(size_t index, Task& task) {
+    {
+        Worker& own = *workers[index];
+        std::scoped_lock lock(own.mtx);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < workers.size(); ++i) {
+        Worker& victim = *workers[(index + i) % workers.size()];
+        std::scoped_lock lock(victim.mtx);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
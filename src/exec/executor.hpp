@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/// @brief Fixed-size work-stealing thread pool.
+/// Every worker has its own deque: it takes its newest tasks (LIFO), 
+/// idle workers steal the oldest ones (FIFO) from the others
+class Executor {
+public:
+    using Task = std::function<void()>;
+
+private:
+    struct Worker {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker> > workers;
+    std::vector<std::thread> threads;
+
+    std::atomic<bool> is_active{true};
+    std::atomic<size_t> pending{0};
+    std::atomic<size_t> next_worker{0};
+
+    std::mutex sleep_mtx;
+    std::condition_variable sleep_cv;
+
+public:
+    explicit Executor(size_t threads_count = std::thread::hardware_concurrency());
+    ~Executor();
+
+    Executor(const Executor& other) = delete;
+    Executor& operator=(const Executor& other) = delete;
+
+    /// @brief Thread-safe. From a worker thread the task goes to its own deque
+    void submit(Task task);
+
+    /// @brief Runs the tasks already submitted and joins the workers
+    void stop();
+
+    size_t size() const { return workers.size(); }
+    size_t pendingTasks() const { return pending.load(std::memory_order_relaxed); }
+
+private:
+    void run(size_t index);
+    bool tryTake(size_t index, Task& task);
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "executor.hpp"
+
+
+/// @brief co_await offload(executor, home, fn): fn runs on an executor thread,
+/// the awaiting coroutine resumes on the thread of home (anything with 
+/// a thread-safe post(std::function<void()>), e.g. Reactor).
+/// Exceptions of fn are rethrown in the coroutine
+template <typename Home, typename Fn>
+class Offload {
+    using Result = std::invoke_result_t<Fn&>;
+    using Stored = std::conditional_t<std::is_void_v<Result>, std::monostate, Result>;
+
+    Executor& executor;
+    Home& home;
+    Fn fn;
+
+    std::optional<Stored> result;
+    std::exception_ptr exception;
+
+public:
+    Offload(Executor& executor, Home& home, Fn fn) 
+        : executor(executor), home(home), fn(std::move(fn)) 
+    {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        /// awaiter живёт в кадре корутины, пока она приостановлена
+        executor.submit([this, awaiting] () {
+            try {
+                if constexpr (std::is_void_v<Result>) {
+                    fn();
+                    result.emplace();
+                }
+                else {
+                    result.emplace(fn());
+                }
+            }
+            catch (...) {
+                exception = std::current_exception();
+            }
+            home.post([awaiting] () { awaiting.resume(); });
+        });
+    }
+
+    Result await_resume() {
+        if (exception) std::rethrow_exception(exception);
+        if constexpr (!std::is_void_v<Result>) {
+            return std::move(*result);
+        }
+    }
+};
+
+template <typename Home, typename Fn>
+Offload<Home, std::decay_t<Fn> > offload(Executor& executor, Home& home, Fn&& fn) {
+    return Offload<Home, std::decay_t<Fn> >(executor, home, std::forward<Fn>(fn));
+}
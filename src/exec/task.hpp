@@ -0,0 +1,140 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+
+/// @brief Lazy coroutine: the body starts when the Task is co_awaited 
+/// (or start() is called) and resumes the awaiting coroutine when it finishes.
+/// The Task owns the coroutine frame
+template <typename T = void>
+class Task;
+
+namespace detail {
+    struct TaskPromiseBase {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+
+        struct FinalAwaiter {
+            bool await_ready() const noexcept { return false; }
+
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                /// symmetric transfer: без роста стека на длинных цепочках co_await
+                auto next = handle.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+
+        void unhandled_exception() { exception = std::current_exception(); }
+
+        void rethrowIfFailed() const {
+            if (exception) std::rethrow_exception(exception);
+        }
+    };
+
+    template <typename T>
+    struct TaskPromise : TaskPromiseBase {
+        std::optional<T> value;
+
+        Task<T> get_return_object();
+
+        template <typename U>
+        void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+
+        T take() {
+            rethrowIfFailed();
+            return std::move(*value);
+        }
+    };
+
+    template <>
+    struct TaskPromise<void> : TaskPromiseBase {
+        Task<void> get_return_object();
+
+        void return_void() const noexcept {}
+
+        void take() const { rethrowIfFailed(); }
+    };
+}
+
+
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+private:
+    Handle handle;
+
+public:
+    Task() = default;
+    explicit Task(Handle handle) : handle(handle) {}
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    Task(const Task& other) = delete;
+    Task& operator=(const Task& other) = delete;
+
+    /// @brief Destroys the frame even if the coroutine is suspended: whatever 
+    /// it waits for (timer, executor) must not resume it afterwards
+    ~Task() { reset(); }
+
+    /// @brief Runs a top-level task up to its first suspension point
+    void start() {
+        if (handle && !handle.done()) handle.resume();
+    }
+
+    bool done() const { return !handle || handle.done(); }
+
+    /// @brief The result of a finished task, rethrows its exception
+    T result() { return handle.promise().take(); }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            Handle handle;
+
+            bool await_ready() const noexcept { return !handle || handle.done(); }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            T await_resume() { return handle.promise().take(); }
+        };
+        return Awaiter{handle};
+    }
+
+private:
+    void reset() {
+        if (handle) handle.destroy();
+        handle = nullptr;
+    }
+};
+
+
+namespace detail {
+    template <typename T>
+    Task<T> TaskPromise<T>::get_return_object() {
+        return Task<T>(std::coroutine_handle<TaskPromise<T> >::from_promise(*this));
+    }
+
+    inline Task<void> TaskPromise<void>::get_return_object() {
+        return Task<void>(std::coroutine_handle<TaskPromise<void> >::from_promise(*this));
+    }
+}
@@ -0,0 +1,115 @@
+#include "frame.hpp"
+
+#include <cstring>
+#include <endian.h>
+
+void encodeHeader(const FrameHeader& header, char* out) {
+    uint32_t length = htobe32(header.length);
+    uint64_t chatID = htobe64(static_cast<uint64_t>(header.chatID));
+    uint64_t senderID = htobe64(static_cast<uint64_t>(header.senderID));
+    uint64_t seq = htobe64(header.seq);
+
+    std::memcpy(out, &length, 4);
+    out[4] = static_cast<char>(header.type);
+    out[5] = static_cast<char>(header.flags);
+    out[6] = 0;
+    out[7] = 0;
+    std::memcpy(out + 8, &chatID, 8);
+    std::memcpy(out + 16, &senderID, 8);
+    std::memcpy(out + 24, &seq, 8);
+}
+
+FrameHeader decodeHeader(const char* in) {
+    uint32_t length;
+    uint64_t chatID;
+    uint64_t senderID;
+    uint64_t seq;
+
+    std::memcpy(&length, in, 4);
+    std::memcpy(&chatID, in + 8, 8);
+    std::memcpy(&senderID, in + 16, 8);
+    std::memcpy(&seq, in + 24, 8);
+
+    FrameHeader header;
+    header.length = be32toh(length);
+    header.type = static_cast<FrameType>(in[4]);
+    header.flags = static_cast<uint8_t>(in[5]);
+    header.chatID = static_cast<ID_t>(be64toh(chatID));
+    header.senderID = static_cast<ID_t>(be64toh(senderID));
+    header.seq = be64toh(seq);
+
+    return header;
+}
+
+std::string encodeFrame(
+    FrameType type, 
+    std::string_view payload, 
+    ID_t chatID, 
+    ID_t senderID, 
+    uint64_t seq,
+    uint8_t flags
+) {
+    FrameHeader header;
+    header.length = static_cast<uint32_t>(payload.size());
+    header.type = type;
+    header.flags = flags;
+    header.chatID = chatID;
+    header.senderID = senderID;
+    header.seq = seq;
+
+    std::string res(FRAME_HEADER_SIZE + payload.size(), '\0');
+    encodeHeader(header, res.data());
+    std::memcpy(res.data() + FRAME_HEADER_SIZE, payload.data(), payload.size());
+
+    return res;
+}
+
+SharedFrame makeSharedFrame(
+    FrameType type, 
+    std::string_view payload, 
+    ID_t chatID, 
+    ID_t senderID, 
+    uint64_t seq,
+    uint8_t flags
+) {
+    return std::make_shared<const std::string>(encodeFrame(type, payload, chatID, senderID, seq, flags));
+}
+
+void appendDeltaEntry(std::string& payload, uint64_t seq, ID_t senderID, std::string_view text) {
+    uint64_t seqBE = htobe64(seq);
+    uint64_t senderBE = htobe64(static_cast<uint64_t>(senderID));
+    uint32_t length = htobe32(static_cast<uint32_t>(text.size()));
+
+    size_t offset = payload.size();
+    payload.resize(offset + DELTA_ENTRY_HEADER_SIZE + text.size());
+    char* out = payload.data() + offset;
+    std::memcpy(out, &seqBE, 8);
+    std::memcpy(out + 8, &senderBE, 8);
+    std::memcpy(out + 16, &length, 4);
+    std::memcpy(out + DELTA_ENTRY_HEADER_SIZE, text.data(), text.size());
+}
+
+bool decodeDelta(std::string_view payload, std::vector<DeltaEntry>& out) {
+    while (!payload.empty()) {
+        if (payload.size() < DELTA_ENTRY_HEADER_SIZE) return false;
+
+        uint64_t seq;
+        uint64_t senderID;
+        uint32_t length;
+        std::memcpy(&seq, payload.data(), 8);
+        std::memcpy(&senderID, payload.data() + 8, 8);
+        std::memcpy(&length, payload.data() + 16, 4);
+        length = be32toh(length);
+
+        payload.remove_prefix(DELTA_ENTRY_HEADER_SIZE);
+        if (payload.size() < length) return false;
+
+        out.push_back(DeltaEntry{
+            be64toh(seq),
+            static_cast<ID_t>(be64toh(senderID)),
+            payload.substr(0, length)
+        });
+        payload.remove_prefix(length);
+    }
+    return true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "types.hpp"
+
+/// Wire format, all integers big-endian:
+/// | length u32 | type u8 | flags u8 | reserved u16 | chat_id i64 | sender_id i64 | seq u64 | payload |
+/// length is the size of the payload only
+#define FRAME_HEADER_SIZE 32
+#define MAX_FRAME_PAYLOAD (16u * 1024 * 1024)
+
+enum class FrameType : uint8_t {
+    UNKNOWN = 0,
+    AUTH,       // payload: login '\0' password
+    AUTH_OK,    // senderID: ID of the logged in user
+    MESSAGE,    // payload: text, seq: number of the message in its chat
+    AUTH_FAIL,  // payload: reason
+    COMMAND,    // payload: command line, e.g. "/msg username text"
+    NOTICE,     // payload: text from the server itself
+    PING,
+    PONG,
+    RESYNC,     // chatID, seq: the last seq the client has of the chat
+    DELTA,      // payload: delta entries newer than RESYNC's seq, see below
+    ACK,        // chatID, seq: queued messages of the chat up to seq are received
+    READ        // chatID, seq: the user has read the chat up to seq
+};
+
+/// MESSAGE kept for the recipient while it was offline, answered with ACK
+#define MESSAGE_QUEUED 0x1
+
+/// DELTA answers RESYNC with one or more frames, entries oldest first:
+/// | seq u64 | sender_id i64 | length u32 | text |
+/// header.seq is the seq the client has after applying the frame
+#define DELTA_ENTRY_HEADER_SIZE 20
+#define DELTA_CONTINUED 0x1 // следующий кадр продолжает этот ответ
+#define DELTA_TRUNCATED 0x2 // не всё новое влезло в ответ, RESYNC с header.seq
+
+struct FrameHeader {
+    uint32_t length = 0;
+    FrameType type = FrameType::UNKNOWN;
+    uint8_t flags = 0;
+    ID_t chatID = 0;
+    ID_t senderID = 0;
+    uint64_t seq = 0;
+};
+
+/// @brief Decoded frame. payload points into the receive buffer of 
+/// the FrameParser and is valid until its next prepare()/append()
+struct FrameView {
+    FrameHeader header;
+    std::string_view payload;
+};
+
+/// @brief Decoded frame that owns its payload, 
+/// outlives further reads from the same connection
+struct Frame {
+    FrameHeader header;
+    std::string payload;
+};
+
+struct DeltaEntry {
+    uint64_t seq = 0;
+    ID_t senderID = 0;
+    std::string_view text; // указывает в payload кадра
+};
+
+void encodeHeader(const FrameHeader& header, char* out);
+FrameHeader decodeHeader(const char* in);
+
+std::string encodeFrame(
+    FrameType type, 
+    std::string_view payload, 
+    ID_t chatID = 0, 
+    ID_t senderID = 0, 
+    uint64_t seq = 0,
+    uint8_t flags = 0
+);
+
+void appendDeltaEntry(std::string& payload, uint64_t seq, ID_t senderID, std::string_view text);
+
+/// @brief Entries of a DELTA payload, false if it is malformed
+bool decodeDelta(std::string_view payload, std::vector<DeltaEntry>& out);
+
+/// @brief Immutable encoded frame. A broadcast is encoded once and 
+/// every recipient queues only a reference to it
+using SharedFrame = std::shared_ptr<const std::string>;
+
+SharedFrame makeSharedFrame(
+    FrameType type, 
+    std::string_view payload, 
+    ID_t chatID = 0, 
+    ID_t senderID = 0, 
+    uint64_t seq = 0,
+    uint8_t flags = 0
+);
@@ -0,0 +1,53 @@
+#include "frame_parser.hpp"
+
+#include <cstring>
+
+FrameParser::FrameParser(size_t capacity, size_t maxPayload)
+    : buffer_(std::max<size_t>(capacity, FRAME_HEADER_SIZE)), maxPayload_(maxPayload)
+{}
+
+std::span<char> FrameParser::prepare(size_t minSize) {
+    /// сдвигаем недочитанный хвост в начало - копируется только неполный кадр
+    if (begin_ > 0) {
+        std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+    }
+
+    if (buffer_.size() - end_ < minSize) {
+        buffer_.resize(std::max(buffer_.size() * 2, end_ + minSize));
+    }
+
+    return std::span<char>(buffer_.data() + end_, buffer_.size() - end_);
+}
+
+void FrameParser::commit(size_t len) {
+    end_ += len;
+}
+
+void FrameParser::append(const char* data, size_t len) {
+    auto span = prepare(len);
+    std::memcpy(span.data(), data, len);
+    commit(len);
+}
+
+std::optional<FrameView> FrameParser::next() {
+    if (error_ || end_ - begin_ < FRAME_HEADER_SIZE) return std::nullopt;
+
+    FrameHeader header = decodeHeader(buffer_.data() + begin_);
+    if (header.length > maxPayload_) {
+        error_ = true;
+        return std::nullopt;
+    }
+
+    size_t frameSize = FRAME_HEADER_SIZE + header.length;
+    if (end_ - begin_ < frameSize) return std::nullopt;
+
+    FrameView frame{
+        header, 
+        std::string_view(buffer_.data() + begin_ + FRAME_HEADER_SIZE, header.length)
+    };
+    begin_ += frameSize;
+
+    return frame;
+}
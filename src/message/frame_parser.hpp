@@ -0,0 +1,38 @@
+#pragma once
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "frame.hpp"
+
+
+/// @brief Incremental parser of the framed stream.
+/// Bytes are read straight into prepare() and confirmed with commit(),
+/// next() returns views into the same buffer without copying
+class FrameParser {
+    std::vector<char> buffer_;
+    size_t begin_ = 0; // первый неразобранный байт
+    size_t end_ = 0;   // конец полученных данных
+
+    size_t maxPayload_;
+    bool error_ = false;
+
+public:
+    explicit FrameParser(size_t capacity = 4096, size_t maxPayload = MAX_FRAME_PAYLOAD);
+
+    /// @brief Writable tail of at least minSize bytes. 
+    /// Invalidates the views returned by next()
+    std::span<char> prepare(size_t minSize = 4096);
+    void commit(size_t len);
+
+    /// @brief prepare() + memcpy + commit() for transports that own the read buffer
+    void append(const char* data, size_t len);
+
+    /// @brief The next complete frame or nullopt if more bytes are needed
+    std::optional<FrameView> next();
+
+    /// @brief The peer sent a frame longer than maxPayload
+    bool hasError() const { return error_; }
+
+    size_t buffered() const { return end_ - begin_; }
+};
@@ -5,6 +5,7 @@
 
 class Message {
     std::optional<ID_t> msgID_;
+    std::optional<int64_t> seq_; // номер в чате: 1, 2, 3... без пропусков
     ID_t chatID_;
     ID_t senderID_;
     std::string text_;
@@ -15,10 +16,13 @@ public:
     {}
 
     void setID(ID_t id) { msgID_ = id; } 
+    void resetID() { msgID_.reset(); }
+    void setSeq(int64_t seq) { seq_ = seq; }
 
     bool isSavedToDB() const { return msgID_.has_value(); }
     
     std::optional<ID_t> getID() const { return msgID_; }
+    std::optional<int64_t> getSeq() const { return seq_; }
     ID_t getSenderID() const { return senderID_; }
     ID_t getChatID() const { return chatID_; }
     std::string getText() const { return text_; }
@@ -1,10 +1,27 @@
 #include "server.hpp"
 
+#include <string>
+
 #define PORT "3490"
 
-int main() {
-    Server server("127.0.0.1", PORT);
+int main(int argc, char* argv[]) {
+    ServerConfig config;
+    config.ip_address = "127.0.0.1";
+    config.port = PORT;
+    config.schema_path = std::string(PROJECT_SOURCE_DIR) + "/assets/sql/createDB.sql";
+    config.migrations_path = std::string(PROJECT_SOURCE_DIR) + "/assets/sql/migrations";
+
+    if (argc > 1) {
+        config.threads = std::stoul(argv[1]);
+    }
+    if (argc > 2 && std::string(argv[2]) == "uring") {
+        config.backend = IoBackend::IO_URING;
+    }
+    if (argc > 3 && std::string(argv[3]) == "log") {
+        config.message_backend = MessageBackend::LOG;
+    }
+
+    Server server(config);
     server.start();
     return 0;
 }
-
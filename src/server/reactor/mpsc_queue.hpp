@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <optional>
+#include <utility>
+
+
+/// @brief Unbounded lock-free multi-producer single-consumer queue (Vyukov).
+/// push() may be called from any thread, pop() only from the owner thread
+template <typename T>
+class MpscQueue {
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        std::optional<T> value;
+    };
+
+    std::atomic<Node*> head; // сюда пишут производители
+    Node* tail;              // отсюда читает потребитель
+
+public:
+    MpscQueue() {
+        Node* stub = new Node;
+        head.store(stub, std::memory_order_relaxed);
+        tail = stub;
+    }
+
+    ~MpscQueue() {
+        while (pop()) {}
+        delete tail;
+    }
+
+    MpscQueue(const MpscQueue& other) = delete;
+    MpscQueue& operator=(const MpscQueue& other) = delete;
+
+    void push(T value) {
+        Node* node = new Node;
+        node->value.emplace(std::move(value));
+
+        Node* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    std::optional<T> pop() {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) return std::nullopt;
+
+        std::optional<T> res = std::move(next->value);
+        next->value.reset();
+
+        delete tail;
+        tail = next;
+        return res;
+    }
+};
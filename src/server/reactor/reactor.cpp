@@ -0,0 +1,150 @@
+#include "reactor.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+Reactor::Reactor(size_t max_events) 
+    : events(max_events)
+{
+    if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+        std::perror("epoll_create1 error");
+        throw std::runtime_error("Failed to create epoll instance");
+    }
+
+    if ((wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+        std::perror("eventfd error");
+        close(epoll_fd);
+        throw std::runtime_error("Failed to create wakeup eventfd");
+    }
+
+    struct epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = nullptr; // nullptr помечает wakeup_fd
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &ev);
+}
+
+Reactor::~Reactor() {
+    close(wakeup_fd);
+    close(epoll_fd);
+}
+
+void Reactor::add(int fd, uint32_t ev_mask, IEventHandler* handler) {
+    struct epoll_event ev{};
+    ev.events = ev_mask;
+    ev.data.ptr = handler;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        std::perror("epoll_ctl add error");
+    }
+}
+
+void Reactor::modify(int fd, uint32_t ev_mask, IEventHandler* handler) {
+    struct epoll_event ev{};
+    ev.events = ev_mask;
+    ev.data.ptr = handler;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+        std::perror("epoll_ctl mod error");
+    }
+}
+
+void Reactor::remove(int fd) {
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr) == -1) {
+        std::perror("epoll_ctl del error");
+    }
+}
+
+void Reactor::defer(std::function<void()> task) {
+    deferred.emplace_back(std::move(task));
+}
+
+void Reactor::post(std::function<void()> task) {
+    inbox.push(std::move(task));
+
+    /// один eventfd write на пачку задач, пока реактор их не разобрал
+    if (!wakeup_pending.exchange(true)) {
+        wakeup();
+    }
+}
+
+TimerId Reactor::schedule(std::chrono::milliseconds delay, std::function<void()> callback) {
+    return timers.schedule(delay, std::move(callback));
+}
+
+bool Reactor::cancel(TimerId id) {
+    return timers.cancel(id);
+}
+
+void SleepAwaiter::await_suspend(std::coroutine_handle<> awaiting) {
+    TimerId id = reactor.schedule(delay, [timer = timer, awaiting] () {
+        if (timer) *timer = 0;
+        awaiting.resume();
+    });
+    if (timer) *timer = id;
+}
+
+void Reactor::runPosted() {
+    wakeup_pending.store(false);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    while (auto task = inbox.pop()) {
+        (*task)();
+    }
+}
+
+void Reactor::run() {
+    while (is_active) {
+        int ready = epoll_wait(
+            epoll_fd, 
+            events.data(), 
+            static_cast<int>(events.size()), 
+            /// отложенные задачи, добавленные из отложенных же, не ждут следующего события
+            deferred.empty() ? timers.waitTimeout() : 0
+        );
+
+        if (ready == -1) {
+            if (errno == EINTR) continue;
+            std::perror("epoll_wait error");
+            break;
+        }
+
+        for (int i = 0; i < ready; ++i) {
+            auto* handler = static_cast<IEventHandler*>(events[i].data.ptr);
+            if (!handler) {
+                drainWakeup();
+                runPosted();
+                continue;
+            }
+            handler->onEvent(events[i].events);
+        }
+
+        /// закрытые в этой пачке сессии уничтожаются только здесь,
+        /// чтобы не обратиться к удалённому обработчику
+        timers.advance();
+
+        auto tasks = std::move(deferred);
+        deferred.clear();
+        for (auto& task : tasks) task();
+    }
+}
+
+void Reactor::stop() {
+    is_active = false;
+    wakeup();
+}
+
+void Reactor::wakeup() {
+    uint64_t one = 1;
+    if (::write(wakeup_fd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+        std::perror("eventfd write error");
+    }
+}
+
+void Reactor::drainWakeup() {
+    uint64_t value;
+    while (::read(wakeup_fd, &value, sizeof(value)) > 0) {}
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+#include <sys/epoll.h>
+
+#include "mpsc_queue.hpp"
+#include "timer_wheel.hpp"
+
+
+/// @brief Handler of the events of a descriptor registered in the Reactor
+class IEventHandler {
+public:
+    virtual ~IEventHandler() = default;
+    virtual void onEvent(uint32_t events) = 0;
+};
+
+
+class Reactor;
+
+/// @brief co_await reactor.sleepFor(delay, &timer). While the coroutine is 
+/// suspended *timer holds the id of the wake-up, Reactor::cancel() on it 
+/// drops the wake-up for good, so the owner has to destroy the coroutine
+class SleepAwaiter {
+    Reactor& reactor;
+    std::chrono::milliseconds delay;
+    TimerId* timer;
+
+public:
+    SleepAwaiter(Reactor& reactor, std::chrono::milliseconds delay, TimerId* timer) 
+        : reactor(reactor), delay(delay), timer(timer) 
+    {}
+
+    bool await_ready() const noexcept { return delay.count() <= 0; }
+    void await_suspend(std::coroutine_handle<> awaiting);
+    void await_resume() const noexcept {}
+};
+
+
+/// @brief Single-threaded edge-triggered event loop on top of epoll
+class Reactor {
+    std::atomic<bool> is_active{true};
+
+    int epoll_fd;
+    int wakeup_fd; // eventfd, будит epoll_wait из других потоков
+
+    std::vector<struct epoll_event> events;
+    std::vector<std::function<void()> > deferred;
+
+    MpscQueue<std::function<void()> > inbox;
+    std::atomic<bool> wakeup_pending{false};
+
+    TimerWheel timers;
+
+public:
+    explicit Reactor(size_t max_events = 1024);
+    ~Reactor();
+
+    Reactor(const Reactor& other) = delete;
+    Reactor& operator=(const Reactor& other) = delete;
+
+    void add(int fd, uint32_t events, IEventHandler* handler);
+    void modify(int fd, uint32_t events, IEventHandler* handler);
+    void remove(int fd);
+
+    /// @brief Runs task after all events of the current epoll_wait batch are handled
+    void defer(std::function<void()> task);
+
+    /// @brief Thread-safe: runs task on the reactor thread
+    void post(std::function<void()> task);
+
+    /// @brief Reactor thread only: runs callback once after delay
+    /// (heartbeats, idle and auth deadlines, retries)
+    TimerId schedule(std::chrono::milliseconds delay, std::function<void()> callback);
+    bool cancel(TimerId id);
+
+    /// @brief Reactor thread only: resumes the awaiting coroutine after delay
+    SleepAwaiter sleepFor(std::chrono::milliseconds delay, TimerId* timer = nullptr) {
+        return SleepAwaiter(*this, delay, timer);
+    }
+
+    void run();
+    void stop();
+
+private:
+    void wakeup();
+    void drainWakeup();
+    void runPosted();
+};
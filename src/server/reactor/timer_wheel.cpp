@@ -0,0 +1,77 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, size_t slots_count, Clock::time_point now)
+    : tick(tick), slots(std::max<size_t>(1, slots_count)), next_tick(now + tick)
+{}
+
+TimerId TimerWheel::schedule(
+    std::chrono::milliseconds delay, 
+    std::function<void()> callback, 
+    Clock::time_point now
+) {
+    /// пустое колесо не крутится, пока реактор спит - догоняем время
+    if (timers.empty() && now >= next_tick) {
+        next_tick = now + tick;
+    }
+
+    /// округляем вверх: таймер не срабатывает раньше срока
+    size_t ticks = std::max<size_t>(1, (delay.count() + tick.count() - 1) / tick.count());
+
+    size_t slot = (current_slot + ticks) % slots.size();
+    size_t rounds = (ticks - 1) / slots.size();
+
+    TimerId id = next_id++;
+    auto& list = slots[slot];
+    list.push_back(Timer{id, rounds, std::move(callback)});
+
+    timers.emplace(id, Location{slot, std::prev(list.end())});
+    return id;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    auto it = timers.find(id);
+    if (it == timers.end()) return false;
+
+    slots[it->second.slot].erase(it->second.it);
+    timers.erase(it);
+    return true;
+}
+
+void TimerWheel::advance(Clock::time_point now) {
+    if (timers.empty()) {
+        if (now >= next_tick) next_tick = now + tick;
+        return;
+    }
+
+    while (now >= next_tick) {
+        next_tick += tick;
+        current_slot = (current_slot + 1) % slots.size();
+
+        std::vector<std::function<void()> > expired;
+        auto& list = slots[current_slot];
+
+        for (auto it = list.begin(); it != list.end(); ) {
+            if (it->rounds > 0) {
+                --it->rounds;
+                ++it;
+                continue;
+            }
+            expired.emplace_back(std::move(it->callback));
+            timers.erase(it->id);
+            it = list.erase(it);
+        }
+
+        /// колбэки могут ставить и отменять таймеры
+        for (auto& callback : expired) callback();
+    }
+}
+
+int TimerWheel::waitTimeout(Clock::time_point now) const {
+    if (timers.empty()) return -1;
+    if (now >= next_tick) return 0;
+
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(next_tick - now);
+    return static_cast<int>(left.count());
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+
+using TimerId = uint64_t;
+
+/// @brief Hashed timer wheel: O(1) schedule and cancel, 
+/// one list walk per tick for the timers of the current slot.
+/// Not thread-safe, lives in the Reactor thread
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct Timer {
+        TimerId id;
+        size_t rounds; // сколько полных оборотов колеса осталось
+        std::function<void()> callback;
+    };
+
+    struct Location {
+        size_t slot;
+        std::list<Timer>::iterator it;
+    };
+
+    std::chrono::milliseconds tick;
+    std::vector<std::list<Timer> > slots;
+    std::unordered_map<TimerId, Location> timers;
+
+    size_t current_slot = 0;
+    Clock::time_point next_tick;
+    TimerId next_id = 1;
+
+public:
+    explicit TimerWheel(
+        std::chrono::milliseconds tick = std::chrono::milliseconds(100), 
+        size_t slots_count = 512,
+        Clock::time_point now = Clock::now()
+    );
+
+    TimerId schedule(
+        std::chrono::milliseconds delay, 
+        std::function<void()> callback, 
+        Clock::time_point now = Clock::now()
+    );
+    bool cancel(TimerId id);
+
+    /// @brief Fires every timer that expired up to now
+    void advance(Clock::time_point now = Clock::now());
+
+    /// @brief epoll_wait timeout: -1 if there are no timers
+    int waitTimeout(Clock::time_point now = Clock::now()) const;
+
+    size_t size() const { return timers.size(); }
+    bool empty() const { return timers.empty(); }
+};
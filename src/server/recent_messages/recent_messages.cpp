@@ -0,0 +1,80 @@
+#include "recent_messages.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+RecentMessages::RecentMessages(size_t per_chat, size_t chats) 
+    : 
+        per_chat(std::max<size_t>(per_chat, 1)), 
+        chats_per_bucket(std::max<size_t>(chats / BUCKETS, 1))
+{}
+
+void RecentMessages::add(const Message& message) {
+    if (!message.getSeq()) return;
+    int64_t seq = *message.getSeq();
+
+    Bucket& bucket = bucketOf(message.getChatID());
+    std::unique_lock lock(bucket.mtx);
+
+    auto it = bucket.chats.find(message.getChatID());
+    if (it == bucket.chats.end()) {
+        if (bucket.chats.size() >= chats_per_bucket) {
+            auto oldest = std::min_element(bucket.chats.begin(), bucket.chats.end(), 
+                [] (const auto& a, const auto& b) { return a.second.touched < b.second.touched; }
+            );
+            bucket.chats.erase(oldest);
+        }
+        it = bucket.chats.emplace(message.getChatID(), Ring{seq, {}, 0}).first;
+    }
+
+    Ring& ring = it->second;
+    ring.touched = ++bucket.clock;
+    if (seq < ring.first_seq) return;
+
+    /// сессии разных отправителей добавляют сообщения чата вперемешку:
+    /// под ещё не пришедшие seq остаются пустые места
+    size_t position = static_cast<size_t>(seq - ring.first_seq);
+    if (position >= ring.messages.size()) ring.messages.resize(position + 1);
+    ring.messages[position] = message;
+
+    while (ring.messages.size() > per_chat) {
+        ring.messages.pop_front();
+        ++ring.first_seq;
+    }
+}
+
+std::optional<std::vector<Message> > RecentMessages::since(ID_t chatID, int64_t after_seq, size_t limit) const {
+    const Bucket& bucket = bucketOf(chatID);
+    std::shared_lock lock(bucket.mtx);
+
+    auto it = bucket.chats.find(chatID);
+    if (it == bucket.chats.end()) return std::nullopt;
+
+    const Ring& ring = it->second;
+    if (after_seq + 1 < ring.first_seq) return std::nullopt;
+
+    std::vector<Message> result;
+    size_t position = static_cast<size_t>(after_seq + 1 - ring.first_seq);
+    for (; position < ring.messages.size() && result.size() < limit; ++position) {
+        if (!ring.messages[position]) break;
+        result.push_back(*ring.messages[position]);
+    }
+    return result;
+}
+
+int64_t RecentMessages::lastSeq(ID_t chatID) const {
+    const Bucket& bucket = bucketOf(chatID);
+    std::shared_lock lock(bucket.mtx);
+
+    auto it = bucket.chats.find(chatID);
+    if (it == bucket.chats.end()) return 0;
+    return it->second.first_seq + static_cast<int64_t>(it->second.messages.size()) - 1;
+}
+
+RecentMessages::Bucket& RecentMessages::bucketOf(ID_t chatID) {
+    return buckets[static_cast<uint64_t>(chatID) % BUCKETS];
+}
+
+const RecentMessages::Bucket& RecentMessages::bucketOf(ID_t chatID) const {
+    return buckets[static_cast<uint64_t>(chatID) % BUCKETS];
+}
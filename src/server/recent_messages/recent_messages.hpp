@@ -0,0 +1,59 @@
+#pragma once
+#include <array>
+#include <deque>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "db/db.hpp"
+#include "message/message.hpp"
+
+#define RECENT_MESSAGES_PER_CHAT 256
+#define RECENT_MESSAGES_CHATS 4096
+
+/// @brief The last messages of recently active chats by seq, so a
+/// reconnecting client is usually answered without the store.
+/// Lock-striped by chat. A bucket keeps its share of the chats and 
+/// drops the one written longest ago
+class RecentMessages {
+    static constexpr size_t BUCKETS = 64;
+
+    struct Ring {
+        int64_t first_seq = 0; // seq of messages.front()
+        std::deque<std::optional<Message> > messages; // nullopt - seq ещё не добавлен
+        uint64_t touched = 0;
+    };
+
+    struct Bucket {
+        mutable std::shared_mutex mtx;
+        std::unordered_map<ID_t, Ring> chats;
+        uint64_t clock = 0;
+    };
+
+    std::array<Bucket, BUCKETS> buckets;
+    size_t per_chat;
+    size_t chats_per_bucket;
+
+public:
+    explicit RecentMessages(
+        size_t per_chat = RECENT_MESSAGES_PER_CHAT, 
+        size_t chats = RECENT_MESSAGES_CHATS
+    );
+
+    /// @brief Messages without a seq and ones older than the ring are ignored.
+    /// Messages of a chat may come out of seq order
+    void add(const Message& message);
+
+    /// @brief Messages with seq greater than after_seq, oldest first, up to 
+    /// limit or the first seq not added yet. std::nullopt - the ring does not 
+    /// reach back to after_seq, ask the store
+    std::optional<std::vector<Message> > since(ID_t chatID, int64_t after_seq, size_t limit) const;
+
+    /// @brief The newest seq in the ring, 0 - the chat is not kept
+    int64_t lastSeq(ID_t chatID) const;
+
+private:
+    Bucket& bucketOf(ID_t chatID);
+    const Bucket& bucketOf(ID_t chatID) const;
+};
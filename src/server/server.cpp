@@ -1,17 +1,43 @@
 #include "server.hpp"
+#include "message.hpp"
+#include "chat/chat.hpp"
 
-Server::Server(const std::string& ip_addr, const std::string& port) 
+#include <algorithm>
+#include <sstream>
+
+Server::Server(const ServerConfig& config) 
     : 
-        server_info{nullptr},
-        ip_address(ip_addr), 
-        port(port) 
+        config(config),
+        executor(config.workers),
+        server_info{nullptr}
     {
         init();
     }
 
+Server::Server(const std::string& ip_addr, const std::string& port) 
+    : Server([&] () {
+        ServerConfig config;
+        config.ip_address = ip_addr;
+        config.port = port;
+        return config;
+    }())
+{}
+
 Server::~Server() {
+    /// задачи пула и коммиты пачек обращаются к шардам - дожидаемся их до разрушения шардов
+    executor.stop();
+    /// таймеры отложенной записи не должны сработать после разрушения очередей
+    for (auto& shard : shards) {
+        shard->stop();
+        shard->join();
+    }
+    deliveries.reset();
+    persister.reset();
+    unread.reset();
+    messages.reset();
+    async_db.reset();
+    shards.clear();
     freeaddrinfo(server_info);
-    close(socket_fd);
 }
 
 void Server::init() {
@@ -23,13 +49,61 @@ void Server::init() {
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_flags = AI_PASSIVE;
 
+    db = std::make_shared<DB>();
+    try {
+        DBOptions options;
+        options.readers = config.db_readers;
+        options.migrations = config.migrations_path;
+        options.entityCacheCapacity = config.db_cache;
+        db->init(config.db_path, config.schema_path, options);
+        async_db = std::make_unique<AsyncDB>(db);
+        messages = openMessageStore();
+        config.persister.ids = std::make_shared<SnowflakeGenerator>(config.node_id);
+        persister = std::make_unique<MessagePersister>(messages, config.persister);
+        recent = std::make_unique<RecentMessages>(config.recent_per_chat, config.recent_chats);
+        /// запись откладывается на колесе таймеров первого шарда, всплеск уходит одной транзакцией
+        FlushTimer timer = [this] (std::chrono::milliseconds delay, std::function<void()> callback) {
+            shards.front()->postAfter(delay, std::move(callback));
+        };
+        deliveries = std::make_unique<DeliveryQueue>(*async_db, config.write_behind_delay, timer);
+        unread = std::make_unique<UnreadTracker>(*async_db, config.write_behind_delay, timer);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "server: database error: " << e.what() << std::endl;
+        std::exit(1);
+    }
+
     int status;
     /// заполняем server_info на основе hints
-    if ((status = getaddrinfo(NULL, port.c_str(), &hints, &server_info)) != 0) {
+    if ((status = getaddrinfo(NULL, config.port.c_str(), &hints, &server_info)) != 0) {
         std::cerr << "getaddrinfo error: " << gai_strerror(status) << std::endl;
         std::exit(1);
     }
-    
+
+    size_t threads = std::max<size_t>(1, config.threads);
+    shards.reserve(threads);
+
+    /// свой listen-сокет на каждый шард, ядро балансирует accept между ними
+    for (size_t i = 0; i < threads; ++i) {
+        auto shard = std::make_unique<Shard>(i, config, *this);
+        shard->attachListener(openListener());
+        shards.emplace_back(std::move(shard));
+    }
+}
+
+std::shared_ptr<MessageStore> Server::openMessageStore() {
+    if (config.message_backend == MessageBackend::LOG) {
+        LogStoreOptions options;
+        options.segmentBytes = config.message_log_segment_bytes;
+        options.durability = config.persister.durability;
+        return std::make_shared<SegmentedLogStore>(config.message_log_path, options);
+    }
+    return std::make_shared<SQLiteMessageStore>(db, config.persister.durability);
+}
+
+int Server::openListener() {
+    int socket_fd = -1;
+
     /// дескриптор сокета
     struct addrinfo * p;
     for (p = server_info; p != NULL; p = p->ai_next) {
@@ -43,6 +117,10 @@ void Server::init() {
             std::perror("setsockopt error");
             exit(1);
         }
+        if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(int)) == -1) {
+            std::perror("setsockopt SO_REUSEPORT error");
+            exit(1);
+        }
 
         /// связываем с портом, полученным из getaddrinfo() (bind - для сервера)
         if (bind(socket_fd, p->ai_addr, p->ai_addrlen) == -1) {
@@ -62,40 +140,430 @@ void Server::init() {
         std::cerr << "listen error\n";
         std::exit(1);
     }
+
+    return socket_fd;
 }
 
-void Server::connect() {
-    std::cout << "server: waiting for connections…\n";
+void Server::start() {    
+    std::cout << "server: waiting for connections on " 
+              << shards.size() << " threads…\n";
 
-    socklen_t calling_size = sizeof(calling_info);    
-    listen_fd = accept(socket_fd, (struct sockaddr *)&calling_info, &calling_size);
-    
-    if (listen_fd == -1) {
-        std::cerr << "server accept error\n";
-        std::exit(1);
+    for (auto& shard : shards) shard->start();
+    for (auto& shard : shards) shard->join();
+}
+
+void Server::stop() {
+    is_active = false;
+    for (auto& shard : shards) shard->stop();
+}
+
+void Server::post(size_t shard_index, std::function<void()> task) {
+    shards.at(shard_index)->post(std::move(task));
+}
+
+bool Server::spill(const User* recipient, SharedFrame frame) {
+    if (!recipient || !recipient->getID() || frame->size() < FRAME_HEADER_SIZE) return false;
+
+    /// сообщение чата ждёт ACK, остальное отправится один раз
+    std::string stored = *frame;
+    FrameHeader header = decodeHeader(stored.data());
+    int64_t seq = 0;
+    if (header.type == FrameType::MESSAGE && header.chatID != 0 && header.seq != 0) {
+        header.flags |= MESSAGE_QUEUED;
+        encodeHeader(header, stored.data());
+        seq = static_cast<int64_t>(header.seq);
     }
+
+    deliveries->push(PendingDelivery{0, *recipient->getID(), header.chatID, seq, std::move(stored)});
+    return true;
 }
 
-void Server::start() {    
-    while (is_active) {
-        addSession();
+Task<void> Server::authenticate(ServerSession& session, std::string login, std::string password) {
+    if (login.empty()) {
+        co_await session.writeFrame(makeSharedFrame(FrameType::AUTH_FAIL, "Empty login"));
+        co_return;
+    }
+
+    std::string password_hash = co_await async(session, [&] () { return hash(password); });
+    auto user = co_await query(session, [&] (DB& db) { return db.findUser(login); });
+
+    if (!user) {
+        User new_user(login, password_hash);
+        bool saved = co_await query(session, [&] (DB& db) { return db.save(new_user); });
+
+        if (saved) {
+            user = std::move(new_user);
+        }
+        else {
+            /// логин мог занять параллельный вход с другого устройства
+            user = co_await query(session, [&] (DB& db) { return db.findUser(login); });
+        }
+        if (!user) {
+            co_await session.writeFrame(makeSharedFrame(FrameType::AUTH_FAIL, "Can not register user"));
+            co_return;
+        }
+    }
+    if (user->getPassword() != password_hash) {
+        co_await session.writeFrame(makeSharedFrame(FrameType::AUTH_FAIL, "Wrong password"));
+        co_return;
     }
+
+    /// сессия могла закрыться, пока шёл запрос - unregister() уже был
+    if (session.getState() == ServerSession::State::CLOSED) co_return;
+
+    if (session.getUser()) unregister(session);
+
+    ID_t userID = *user->getID();
+    session.setUser(std::make_unique<User>(*user));
+    registry.add(userID, session.getHandle());
+
+    if (!co_await session.writeFrame(makeSharedFrame(FrameType::AUTH_OK, login, 0, userID))) co_return;
+    session.drainLater();
 }
 
-void Server::stop() {
-    is_active = false;
+Task<std::optional<ID_t> > Server::drainDeliveries(ServerSession& session, ID_t after) {
+    ID_t userID = *session.getUser()->getID();
+
+    auto batch = co_await query(session, [&] (DB& db) {
+        deliveries->flush(db);
+        return db.fetchDeliveries(userID, after, DELIVERY_BATCH);
+    });
+    if (batch.empty()) co_return std::nullopt;
+
+    /// кадры пачки уже закодированы: склеиваются в один буфер до DELIVERY_BATCH_BYTES,
+    /// writeFrame ждёт, пока сокет их примет, и реактор тем временем свободен
+    std::string frames;
+    std::vector<ID_t> sent;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        frames += batch[i].frame;
+        if (batch[i].seq == 0) sent.push_back(batch[i].id);
+
+        bool fits = i + 1 < batch.size() && frames.size() + batch[i + 1].frame.size() <= DELIVERY_BATCH_BYTES;
+        if (fits) continue;
+
+        if (!co_await session.writeFrame(std::make_shared<const std::string>(std::move(frames)))) {
+            co_return std::nullopt;
+        }
+        /// одноразовый кадр удаляется, когда его принял сокет; кадр сообщения - по ACK
+        for (ID_t id : sent) deliveries->sent(id);
+        frames.clear();
+        sent.clear();
+    }
+
+    if (batch.size() < DELIVERY_BATCH) co_return std::nullopt;
+    co_return batch.back().id;
+}
+
+void Server::acknowledge(ServerSession& session, ID_t chatID, uint64_t seq) {
+    ID_t userID = *session.getUser()->getID();
+    deliveries->ack(userID, chatID, static_cast<int64_t>(std::min<uint64_t>(seq, std::numeric_limits<int64_t>::max())));
+}
+
+void Server::markRead(ServerSession& session, ID_t chatID, uint64_t seq) {
+    ID_t userID = *session.getUser()->getID();
+    unread->read(userID, chatID, static_cast<int64_t>(std::min<uint64_t>(seq, std::numeric_limits<int64_t>::max())));
+}
+
+Task<void> Server::command(ServerSession& session, std::string line) {
+    std::istringstream input{line};
+    std::string name;
+    input >> name;
+
+    if (name == "/msg") {
+        std::string recipient;
+        input >> recipient;
+        
+        std::string text;
+        std::getline(input >> std::ws, text);
+
+        if (recipient.empty() || text.empty()) {
+            session.notice("Usage: /msg username message");
+            co_return;
+        }
+        co_await directMessage(session, std::move(recipient), std::move(text));
+    }
+    else if (name == "/chat") {
+        std::string partner;
+        input >> partner;
+
+        ID_t beforeID = std::numeric_limits<ID_t>::max();
+        if (!(input >> beforeID)) beforeID = std::numeric_limits<ID_t>::max();
+
+        if (partner.empty()) {
+            session.notice("Usage: /chat username [before_message_id]");
+            co_return;
+        }
+        co_await openChat(session, std::move(partner), beforeID);
+    }
+    else if (name == "/list") {
+        co_await listChats(session);
+    }
+    else if (name == "/search") {
+        std::string text;
+        std::getline(input >> std::ws, text);
+
+        if (text.empty()) {
+            session.notice("Usage: /search words");
+            co_return;
+        }
+        co_await search(session, std::move(text));
+    }
+    else {
+        session.notice("Unknown command " + name);
+    }
+}
+
+void Server::unregister(ServerSession& session) {
+    if (!session.getUser() || !session.getUser()->getID()) return;
+    registry.remove(*session.getUser()->getID(), session.getSerial());
+}
+
+void Server::deliver(const SessionHandle& handle, SharedFrame frame) {
+    Shard* target = shards.at(handle.shard).get();
+    target->post([target, handle, frame = std::move(frame)] () {
+        target->deliverLocal(handle, frame);
+    });
+}
+
+void Server::deliverToUser(ID_t userID, const SharedFrame& frame, uint64_t except_serial) {
+    for (const auto& handle : registry.find(userID)) {
+        if (handle.serial == except_serial) continue;
+        deliver(handle, frame);
+    }
+}
+
+Task<void> Server::directMessage(ServerSession& session, std::string name, std::string text) {
+    ID_t senderID = *session.getUser()->getID();
+
+    auto recipient = co_await query(session, [&] (DB& db) { return db.findUser(name); });
+    if (!recipient) {
+        session.notice("User " + name + " not found");
+        co_return;
+    }
+    ID_t recipientID = *recipient->getID();
+    if (recipientID == senderID) {
+        session.notice("Can not send a message to yourself");
+        co_return;
+    }
+
+    auto chatID = co_await query(session, [&] (DB& db) { 
+        return db.openPersonalChat(senderID, recipientID); 
+    });
+    if (!chatID) {
+        session.notice("Can not create chat with " + name);
+        co_return;
+    }
+
+    /// список инициализации в кадре корутины GCC не компилирует
+    std::vector<ID_t> members(2);
+    members[0] = senderID;
+    members[1] = recipientID;
+    co_await postMessage(session, *chatID, std::move(members), std::move(text));
+}
+
+Task<void> Server::chatMessage(ServerSession& session, ID_t chatID, std::string text) {
+    ID_t senderID = *session.getUser()->getID();
+
+    if (chatID == 0) {
+        session.notice("Usage: /msg username message");
+        co_return;
+    }
+    if (text.empty()) co_return;
+
+    /// участники берутся из кэша чатов, в SQLite - только при промахе
+    auto chat = co_await query(session, [&] (DB& db) { return db.findChat(chatID); });
+    if (!chat || std::ranges::find(chat->getUserIDs(), senderID) == chat->getUserIDs().end()) {
+        session.notice("You are not a member of chat " + std::to_string(chatID));
+        co_return;
+    }
+    co_await postMessage(session, chatID, chat->getUserIDs(), std::move(text));
+}
+
+Task<void> Server::postMessage(ServerSession& session, ID_t chatID, std::vector<ID_t> members, std::string text) {
+    ID_t senderID = *session.getUser()->getID();
+
+    /// ID и seq выдаёт персистер, сообщение расходится, не дожидаясь коммита пачки;
+    /// если пачка не сохранится, об этом узнает только отправитель
+    Message message(chatID, senderID, text);
+    MessagePersister::Completion done = [this, senderID] (const Message& saved) {
+        /// непрочитанным считается только сохранённое сообщение
+        if (saved.getID()) {
+            unread->posted(saved.getChatID(), senderID, saved.getSeq().value_or(0));
+            return;
+        }
+        deliverToUser(senderID, makeSharedFrame(FrameType::NOTICE, "Message was not saved"));
+    };
+    auto queued = persister->enqueue(message, done);
+    while (queued == MessagePersister::Enqueued::UNKNOWN_CHAT) {
+        /// последний seq чата читается на потоке БД, не на реакторе
+        bool loaded = co_await query(session, [&] (DB&) { return persister->loadChat(chatID); });
+        if (!loaded) break;
+        queued = persister->enqueue(message, done);
+    }
+    if (queued != MessagePersister::Enqueued::QUEUED) {
+        session.notice("Message was not saved");
+        co_return;
+    }
+    recent->add(message);
+
+    /// кодируем один раз, получатели разделяют один буфер
+    uint64_t seq = static_cast<uint64_t>(message.getSeq().value_or(0));
+    auto frame = makeSharedFrame(FrameType::MESSAGE, text, chatID, senderID, seq);
+    deliverToUser(senderID, frame, session.getSerial());
+
+    std::string offline;
+    for (ID_t memberID : members) {
+        if (memberID == senderID) continue;
+
+        /// участник не в сети: кадр ждёт его входа. Вход ждёт постановки в очередь,
+        /// и её первая пачка уже содержит кадр - второй раз live он не придёт
+        bool queued = registry.ifOffline(memberID, [&] () {
+            if (offline.empty()) {
+                offline = encodeFrame(FrameType::MESSAGE, text, chatID, senderID, seq, MESSAGE_QUEUED);
+            }
+            deliveries->push(PendingDelivery{0, memberID, chatID, static_cast<int64_t>(seq), offline});
+        });
+        if (!queued) deliverToUser(memberID, frame);
+    }
 }
 
-void Server::addSession() {
-    connect();
-    auto session = std::make_unique<ServerSession>(listen_fd);
+Task<void> Server::openChat(ServerSession& session, std::string name, ID_t beforeID) {
+    ID_t userID = *session.getUser()->getID();
 
-    std::thread session_thread(&ServerSession::start, session.get());
-    
-    std::scoped_lock lock(sessions_mtx);
-    sessions.emplace_back(std::move(session));
+    auto partner = co_await query(session, [&] (DB& db) { return db.findUser(name); });
+    if (!partner) {
+        session.notice("User " + name + " not found");
+        co_return;
+    }
+    ID_t partnerID = *partner->getID();
+    if (partnerID == userID) {
+        session.notice("There is no chat with yourself");
+        co_return;
+    }
+
+    auto chatID = co_await query(session, [&] (DB& db) { 
+        return db.findPersonalChatID(userID, partnerID); 
+    });
+    if (!chatID) {
+        session.notice("No messages with " + name + " yet");
+        co_return;
+    }
+
+    auto page = co_await query(session, [&] (DB&) { return messages->fetchHistory(*chatID, beforeID); });
+
+    /// страница приходит от новых к старым, клиенту - в порядке написания;
+    /// writeFrame не даёт истории переполнить очередь сессии
+    for (auto it = page.rbegin(); it != page.rend(); ++it) {
+        auto frame = makeSharedFrame(
+            FrameType::MESSAGE, it->getText(), *chatID, it->getSenderID(), 
+            static_cast<uint64_t>(it->getSeq().value_or(0))
+        );
+        if (!co_await session.writeFrame(std::move(frame))) co_return;
+    }
+
+    /// открыта последняя страница - чат прочитан до её нового конца
+    if (beforeID == std::numeric_limits<ID_t>::max() && !page.empty() && page.front().getSeq()) {
+        unread->read(userID, *chatID, *page.front().getSeq());
+    }
+
+    if (page.size() == HISTORY_PAGE_SIZE) {
+        session.notice("Older messages: /chat " + name + " " + std::to_string(*page.back().getID()));
+    }
+    else {
+        session.notice("Beginning of the chat with " + name);
+    }
+}
+
+Task<void> Server::listChats(ServerSession& session) {
+    ID_t userID = *session.getUser()->getID();
+
+    /// буфер отметок применяется до чтения, чтобы своё прочтение было видно сразу
+    auto chats = co_await query(session, [&] (DB& db) { 
+        unread->flush(db);
+        return db.listChats(userID); 
+    });
+    if (chats.empty()) {
+        session.notice("No chats yet");
+        co_return;
+    }
+
+    std::string text = "Chats:";
+    for (const ChatUnread& chat : chats) {
+        text += "\n  [chat " + std::to_string(chat.chatID) + "] " + chat.title;
+        if (chat.unread > 0) text += " (" + std::to_string(chat.unread) + " unread)";
+    }
+    session.notice(text);
+}
+
+Task<void> Server::search(ServerSession& session, std::string text) {
+    if (config.message_backend != MessageBackend::SQLITE) {
+        session.notice("Search is not available on this server");
+        co_return;
+    }
+    ID_t userID = *session.getUser()->getID();
+
+    auto results = co_await query(session, [&] (DB& db) { 
+        return db.searchUserMessages(userID, text); 
+    });
+    if (results.empty()) {
+        session.notice("Nothing found for " + text);
+        co_return;
+    }
+
+    /// лучшие совпадения первыми, в тексте - только фрагмент с найденными словами
+    for (const SearchResult& result : results) {
+        auto frame = makeSharedFrame(
+            FrameType::MESSAGE, result.snippet, result.chatID, result.senderID, 
+            static_cast<uint64_t>(result.seq)
+        );
+        if (!co_await session.writeFrame(std::move(frame))) co_return;
+    }
+    session.notice("Found " + std::to_string(results.size()) + " messages for " + text);
+}
+
+Task<void> Server::resync(ServerSession& session, ID_t chatID, uint64_t after_seq) {
+    ID_t userID = *session.getUser()->getID();
+    int64_t after = static_cast<int64_t>(std::min<uint64_t>(after_seq, std::numeric_limits<int64_t>::max()));
+
+    bool member = co_await query(session, [&] (DB& db) { return db.isChatMember(chatID, userID); });
+    if (!member) {
+        session.notice("No chat " + std::to_string(chatID));
+        co_return;
+    }
+
+    /// недавнее - из памяти, более старое - из хранилища. Лишнее сообщение 
+    /// сверх лимита только показывает, что ответ неполный
+    std::vector<Message> delta;
+    bool truncated = false;
+    if (auto cached = recent->since(chatID, after, RESYNC_LIMIT + 1)) {
+        delta = std::move(*cached);
+        int64_t last = delta.empty() ? after : *delta.back().getSeq();
+        truncated = delta.size() > RESYNC_LIMIT || last < recent->lastSeq(chatID);
+    }
+    else {
+        delta = co_await query(session, [&] (DB&) { 
+            return messages->fetchSinceSeq(chatID, after, RESYNC_LIMIT + 1); 
+        });
+        truncated = delta.size() > RESYNC_LIMIT;
+    }
+    if (delta.size() > RESYNC_LIMIT) delta.erase(delta.begin() + RESYNC_LIMIT, delta.end());
+
+    /// пачки по DELTA_FRAME_BYTES, header.seq - докуда клиент догнал чат
+    std::string payload;
+    uint64_t seq = static_cast<uint64_t>(after);
+    for (const Message& message : delta) {
+        const std::string& text = message.getText();
+        if (!payload.empty() && payload.size() + DELTA_ENTRY_HEADER_SIZE + text.size() > DELTA_FRAME_BYTES) {
+            auto frame = makeSharedFrame(FrameType::DELTA, payload, chatID, 0, seq, DELTA_CONTINUED);
+            if (!co_await session.writeFrame(std::move(frame))) co_return;
+            payload.clear();
+        }
+        seq = static_cast<uint64_t>(*message.getSeq());
+        appendDeltaEntry(payload, seq, message.getSenderID(), text);
+    }
 
-    if (session_thread.joinable()) session_thread.join();
+    uint8_t flags = truncated ? DELTA_TRUNCATED : 0;
+    co_await session.writeFrame(makeSharedFrame(FrameType::DELTA, payload, chatID, 0, seq, flags));
 }
 
 std::string Server::getIPaddr() const {
@@ -1,38 +1,112 @@
 #pragma once
 #include <iostream>
 #include <vector>
+#include <functional>
 #include <atomic>
-#include <mutex>
 
-#include "server_session/server_session.hpp"
+#include "server_config.hpp"
+#include "shard/shard.hpp"
+#include "session_registry/session_registry.hpp"
+#include "db/db.hpp"
+#include "executor.hpp"
+#include "offload.hpp"
+#include "db/message_persister.hpp"
+#include "db/async_db.hpp"
+#include "db/delivery_queue.hpp"
+#include "db/unread_tracker.hpp"
+#include "recent_messages/recent_messages.hpp"
 
+#define RESYNC_LIMIT 1000 // сообщений в одном ответе на RESYNC
+#define DELTA_FRAME_BYTES (64 * 1024)
+#define DELIVERY_BATCH_BYTES (256 * 1024) // склеенных кадров офлайн-очереди в одной записи
 
-class Server {
+/// @brief Runs ServerConfig::threads shards. Every shard has its own 
+/// SO_REUSEPORT listening socket and reactor, so the kernel spreads 
+/// incoming connections between the cores
+class Server : public IRouter {
     std::atomic<bool> is_active{true};
-    std::mutex sessions_mtx;
-    std::vector<std::unique_ptr<ServerSession> > sessions;
-    
-    struct addrinfo * server_info; // содержит sockaddr
-    struct sockaddr_storage calling_info;
 
-    std::string ip_address;
-    std::string port;
+    ServerConfig config;
+    std::vector<std::unique_ptr<Shard> > shards;
+
+    std::shared_ptr<DB> db;
+    SessionRegistry registry;
 
-    int socket_fd;
-    int listen_fd;
+    /// CPU-работа запросов, реакторы только читают и пишут сокеты
+    Executor executor;
+    std::unique_ptr<AsyncDB> async_db; // запросы к БД - только на её потоках
+    std::shared_ptr<MessageStore> messages; // ServerConfig::message_backend
+    std::unique_ptr<MessagePersister> persister; // сообщения пишутся пачками
+    std::unique_ptr<RecentMessages> recent;
+    std::unique_ptr<DeliveryQueue> deliveries; // кадры для тех, кто не в сети
+    std::unique_ptr<UnreadTracker> unread; // счётчики непрочитанного для /list
+    
+    struct addrinfo * server_info; // содержит sockaddr
 
 public:
+    explicit Server(const ServerConfig& config);
     Server(const std::string& ip_addr, const std::string& port);
     ~Server();
     
     void init();
-    void connect();
 
     void start();
     void stop();
 
-    void addSession();
+    /// @brief Thread-safe cross-shard delivery through the shard's MPSC inbox
+    void post(size_t shard_index, std::function<void()> task);
+
+    bool spill(const User* recipient, SharedFrame frame) override;
+
+    Task<void> authenticate(ServerSession& session, std::string login, std::string password) override;
+
+    Task<void> chatMessage(ServerSession& session, ID_t chatID, std::string text) override;
+    Task<void> command(ServerSession& session, std::string line) override;
+    Task<std::optional<ID_t> > drainDeliveries(ServerSession& session, ID_t after) override;
+    Task<void> resync(ServerSession& session, ID_t chatID, uint64_t after_seq) override;
+    void acknowledge(ServerSession& session, ID_t chatID, uint64_t seq) override;
+    void markRead(ServerSession& session, ID_t chatID, uint64_t seq) override;
+    void unregister(ServerSession& session) override;
+
+    /// @brief Thread-safe: queues frame on the session wherever it lives
+    void deliver(const SessionHandle& handle, SharedFrame frame);
 
+    /// @brief Every online device of the user except except_serial
+    void deliverToUser(ID_t userID, const SharedFrame& frame, uint64_t except_serial = 0);
+
+    size_t getShardsCount() const { return shards.size(); }
 
     std::string getIPaddr() const;
-};
\ No newline at end of file
+
+private:
+    int openListener();
+    std::shared_ptr<MessageStore> openMessageStore();
+
+    Task<void> directMessage(ServerSession& session, std::string name, std::string text);
+
+    /// @brief Queues the message on the persister and sends it to members:
+    /// online devices at once, offline users through their delivery queue
+    Task<void> postMessage(ServerSession& session, ID_t chatID, std::vector<ID_t> members, std::string text);
+
+    /// @brief /chat: streams a history page of the personal chat with name
+    Task<void> openChat(ServerSession& session, std::string name, ID_t beforeID);
+
+    /// @brief /list: chats of the user with unread counters
+    Task<void> listChats(ServerSession& session);
+
+    /// @brief /search: best matches among all chats of the user
+    Task<void> search(ServerSession& session, std::string text);
+
+    /// @brief co_await async(session, fn): fn (hashing and other CPU work) runs 
+    /// on the executor, the request resumes on the reactor of the session
+    template <typename Fn>
+    auto async(ServerSession& session, Fn&& fn) {
+        return offload(executor, session.getReactor(), std::forward<Fn>(fn));
+    }
+
+    /// @brief co_await query(session, fn): fn(DB&) runs on a DB thread
+    template <typename Fn>
+    auto query(ServerSession& session, Fn&& fn) {
+        return async_db->async(session.getReactor(), std::forward<Fn>(fn));
+    }
+};
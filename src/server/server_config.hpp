@@ -0,0 +1,82 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "db/message_persister.hpp"
+#include "db/segmented_log_store.hpp"
+#include "recent_messages/recent_messages.hpp"
+
+
+enum class IoBackend {
+    EPOLL,
+    IO_URING // если liburing не найден при сборке - откат на EPOLL
+};
+
+/// @brief Where message bodies are stored, users and chats are always in SQLite
+enum class MessageBackend {
+    SQLITE, // таблица MessagesHistory, работает /search
+    LOG     // сегментированный лог на чат, без полнотекстового поиска
+};
+
+/// @brief What a session does when its outbound queue hits the high-water mark
+enum class SlowConsumerPolicy {
+    DROP,       // новый кадр отбрасывается
+    DISCONNECT, // медленный клиент отключается
+    SPILL       // кадр уходит в офлайн-хранилище получателя
+};
+
+struct OutboundLimits {
+    size_t high_water_bytes = 4 * 1024 * 1024;
+    size_t high_water_frames = 4096;
+    SlowConsumerPolicy policy = SlowConsumerPolicy::DROP;
+};
+
+/// @brief Input of a session waiting for its request handling to finish
+struct InboundLimits {
+    /// неразобранных байт, после которых сокет не читается, пока serve() занят;
+    /// кадр, который serve() уже ждёт, дочитывается целиком
+    size_t high_water_bytes = 1024 * 1024;
+};
+
+struct SessionTimeouts {
+    std::chrono::milliseconds auth_deadline = std::chrono::seconds(10);
+    std::chrono::milliseconds heartbeat_interval = std::chrono::seconds(30); // PING после тишины
+    std::chrono::milliseconds idle_timeout = std::chrono::seconds(90);       // отключение после тишины
+};
+
+/// @brief Startup parameters of the Server
+struct ServerConfig {
+    std::string ip_address = "127.0.0.1";
+    std::string port = "3490";
+
+    std::string db_path = "consolet.db";
+    std::string schema_path = "assets/sql/createDB.sql";
+    std::string migrations_path = "assets/sql/migrations";
+    size_t db_readers = 4; // читающие соединения SQLite, 0 - одно соединение на всё
+    size_t db_cache = ENTITY_CACHE_CAPACITY; // пользователей и чатов в кэше, 0 - без кэша
+    PersisterOptions persister; // group commit сообщений, durability - для любого хранилища
+    std::chrono::milliseconds write_behind_delay{20}; // очередь доставки и счётчики пишутся раз в столько
+    int64_t node_id = 0; // узел в ID сообщений, у каждого сервера кластера свой
+
+    MessageBackend message_backend = MessageBackend::SQLITE;
+    std::string message_log_path = "messages"; // каталог лога для MessageBackend::LOG
+    size_t message_log_segment_bytes = LOG_SEGMENT_BYTES;
+
+    /// последние сообщения чатов в памяти, из них отвечают на RESYNC
+    size_t recent_per_chat = RECENT_MESSAGES_PER_CHAT;
+    size_t recent_chats = RECENT_MESSAGES_CHATS;
+
+    /// количество шардов: реактор + свой listen-сокет (SO_REUSEPORT) на поток
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+    /// потоки пула для БД и прочей блокирующей работы, отдельно от реакторов
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+
+    IoBackend backend = IoBackend::EPOLL;
+
+    OutboundLimits outbound;
+    InboundLimits inbound;
+    SessionTimeouts timeouts;
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "frame.hpp"
+#include "task.hpp"
+#include "session_registry/session_registry.hpp"
+
+class User;
+class ServerSession;
+
+
+/// @brief Server side services a ServerSession forwards its requests to
+class IRouter {
+public:
+    virtual ~IRouter() = default;
+
+    /// @brief MESSAGE: persists the text and fans it out to the members of 
+    /// the chat, one shared frame for all of them. Only a member may post
+    virtual Task<void> chatMessage(ServerSession& session, ID_t chatID, std::string text) = 0;
+
+    /// @brief SlowConsumerPolicy::SPILL: keeps a frame the recipient could not take
+    /// until its next login. false - the frame is lost
+    virtual bool spill(const User* recipient, SharedFrame frame) = 0;
+
+    /// @brief Logs in (or registers) the user and binds it to the session.
+    /// Requests are coroutines on the session's reactor, the session 
+    /// outlives them and reads its next frame only when they finish
+    virtual Task<void> authenticate(ServerSession& session, std::string login, std::string password) = 0;
+
+    virtual Task<void> command(ServerSession& session, std::string line) = 0;
+
+    /// @brief One batch of the user's offline queue after the delivery after.
+    /// The session calls it between frames, so ACKs are not held back by
+    /// a long queue. The next after, std::nullopt - the queue is sent
+    virtual Task<std::optional<ID_t> > drainDeliveries(ServerSession& session, ID_t after) = 0;
+
+    /// @brief RESYNC: messages of the chat after after_seq as DELTA frames
+    virtual Task<void> resync(ServerSession& session, ID_t chatID, uint64_t after_seq) = 0;
+
+    /// @brief ACK: queued messages of the chat up to seq reached the user
+    virtual void acknowledge(ServerSession& session, ID_t chatID, uint64_t seq) = 0;
+
+    /// @brief READ: the user has read the chat up to seq, applied in batches
+    virtual void markRead(ServerSession& session, ID_t chatID, uint64_t seq) = 0;
+
+    /// @brief The session is closing, drop it from the user's devices
+    virtual void unregister(ServerSession& session) = 0;
+};
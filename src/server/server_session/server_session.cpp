@@ -1,100 +1,412 @@
 #include "server_session.hpp"
 
-ServerSession::ServerSession(int client_fd) 
-    : listen_fd(client_fd)
+#include <iostream>
+#include <atomic>
+#include <errno.h>
+#include <sys/uio.h>
+
+static std::atomic<uint64_t> next_serial{1};
+
+ServerSession::ServerSession(int client_fd, SessionContext& context, std::function<void(int)> on_close) 
+    : 
+        serial(next_serial.fetch_add(1, std::memory_order_relaxed)),
+        client_fd(client_fd), 
+        context(context),
+        on_close(std::move(on_close))
 {}
 
 ServerSession::~ServerSession() {
-    close(listen_fd);
+    close(client_fd);
+}
+
+void ServerSession::start() {
+    last_activity = TimerWheel::Clock::now();
+    context.transport.open(*this);
+
+    auth_task = authDeadline();
+    heartbeat_task = heartbeat();
+    serve_task = serve();
+
+    auth_task.start();
+    heartbeat_task.start();
+    serve_task.start();
 }
 
-void ServerSession::start() {        
-    if (is_active) {
-        std::thread recv_thread([&] () {
-            while (is_active) {
-                recieve();
-                if (!is_active) break;
-                printMsg();
+void ServerSession::stop() {
+    if (state == State::CLOSED) return;
+    state = State::CLOSED;
+
+    /// спящие корутины больше не проснутся, их кадры уничтожит деструктор
+    if (auth_timer) context.reactor.cancel(auth_timer);
+    if (heartbeat_timer) context.reactor.cancel(heartbeat_timer);
+    auth_timer = heartbeat_timer = 0;
+
+    context.transport.close(*this);
+    shutdown(client_fd, SHUT_RDWR);
+
+    if (user) context.router.unregister(*this);
+
+    /// serve() завершится сам и отдаст сессию в on_close
+    wakeLater(read_waiter);
+    wakeLater(write_waiter);
+}
+
+Task<void> ServerSession::serve() {
+    while (true) {
+        std::optional<Frame> frame;
+        bool drain = drain_after && !pollFrame(frame);
+        if (!drain && !frame) {
+            frame = co_await readFrame();
+            if (!frame) break;
+        }
+
+        try {
+            if (drain) {
+                drain_after = co_await context.router.drainDeliveries(*this, *drain_after);
             }
-        });
-            
-        std::thread send_thread([&] () {
-            int cin_flags = fcntl(STDIN_FILENO, F_GETFL); // get currenct cin status
-            fcntl(STDIN_FILENO, F_SETFL, cin_flags | O_NONBLOCK); // set nonblock status
-            
-            while (is_active) {
-                struct pollfd pfd;
-                pfd.fd = STDIN_FILENO;
-                pfd.events = POLLIN;
-
-                int res = poll(&pfd, 1, 100);
-
-                if (res > 0 && (pfd.revents & POLLIN)) {
-                    std::cout << "Enter message to client: \n";
-                    std::flush(std::cout);
-                    
-                    if (std::getline(std::cin, message)) {
-                        if (!is_active) break;
-                        send();         
-                    }
-                    
-                    if (std::cin.fail() && !std::cin.eof()) {
-                        std::cin.clear();
-                    }
-                }
-                
+            else {
+                co_await handleFrame(*frame);
             }
-            fcntl(STDIN_FILENO, F_SETFL, cin_flags);
-        });
-        
-        if (recv_thread.joinable()) recv_thread.join();
-        if (send_thread.joinable()) send_thread.join();
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Request of client " << client_fd << " failed: " << e.what() << std::endl;
+            stop();
+        }
     }
+
+    /// ни одна корутина сессию больше не разбудит - её можно удалять
+    if (on_close) on_close(client_fd);
 }
 
-void ServerSession::stop() {
-    is_active = false;
-    shutdown(listen_fd, SHUT_RDWR);
+Task<void> ServerSession::authDeadline() {
+    co_await context.reactor.sleepFor(context.config.timeouts.auth_deadline, &auth_timer);
+    if (user || state == State::CLOSED) co_return;
+
+    notice("Authentication timeout");
+    stop();
 }
 
-void ServerSession::recieve() {
-    std::fill(recv_buf.begin(), recv_buf.end(), 0);
-        
-    if ((recv_len = ::recv(listen_fd, recv_buf.data(), SIZE, 0)) == -1) {
-        std::cerr << "server recv error\n";
-        std::flush(std::cerr);
+Task<void> ServerSession::heartbeat() {
+    const SessionTimeouts& timeouts = context.config.timeouts;
+
+    while (state != State::CLOSED) {
+        co_await context.reactor.sleepFor(timeouts.heartbeat_interval, &heartbeat_timer);
+        auto idle = TimerWheel::Clock::now() - last_activity;
+
+        if (idle >= timeouts.idle_timeout) {
+            std::cerr << "Client " << client_fd << " is not responding - disconnecting\n";
+            stop();
+            co_return;
+        }
+        if (idle >= timeouts.heartbeat_interval) {
+            queueFrame(makeSharedFrame(FrameType::PING, ""));
+        }
+    }
+}
+
+bool ServerSession::pollFrame(std::optional<Frame>& frame) {
+    if (state == State::CLOSED) return true;
+
+    if (auto view = parser.next()) {
+        frame = Frame{view->header, std::string(view->payload)};
+        return true;
+    }
+    if (parser.hasError()) {
+        std::cerr << "Protocol error: too long frame from client " << client_fd << std::endl;
+        stop();
+        return true;
+    }
+    return false;
+}
+
+void ServerSession::wakeReader() {
+    last_activity = TimerWheel::Clock::now();
+
+    /// пока serve() занят запросом, данные копятся в parser
+    if (auto waiter = std::exchange(read_waiter, nullptr)) {
+        waiter.resume();
+    }
+}
+
+void ServerSession::throttleReading() {
+    if (reading_paused || read_waiter || state == State::CLOSED) return;
+    if (parser.buffered() < context.config.inbound.high_water_bytes) return;
+
+    reading_paused = true;
+    context.transport.pauseReading(*this);
+}
+
+void ServerSession::wakeLater(std::coroutine_handle<>& waiter) {
+    if (auto handle = std::exchange(waiter, nullptr)) {
+        context.reactor.defer([handle] () { handle.resume(); });
+    }
+}
+
+void ServerSession::ReadFrameAwaiter::await_suspend(std::coroutine_handle<> awaiting) {
+    session.read_waiter = awaiting;
+
+    /// буфер разобран до неполного кадра - снова читаем сокет
+    if (session.reading_paused) {
+        session.reading_paused = false;
+        session.context.transport.resumeReading(session);
+    }
+}
+
+std::optional<Frame> ServerSession::ReadFrameAwaiter::await_resume() {
+    if (!frame) session.pollFrame(frame);
+    return std::move(frame);
+}
+
+bool ServerSession::WriteFrameAwaiter::await_ready() {
+    queued = session.queueFrame(std::move(frame));
+    if (!queued || session.state == State::CLOSED) return true;
+
+    /// кадр записан, когда ушло всё, что стояло в очереди до него включительно
+    session.write_target = session.stats.sent_bytes + session.stats.queued_bytes;
+    return session.out_queue.empty();
+}
+
+void ServerSession::onEvent(uint32_t events) {
+    if (state == State::CLOSED) return;
+
+    if (events & (EPOLLERR | EPOLLHUP)) {
         stop();
         return;
     }
-    else if (recv_len == 0) {
-        std::cerr << "The connection was closed by client " << listen_fd << std::endl;
-        std::flush(std::cerr);
+    if (events & (EPOLLIN | EPOLLRDHUP)) {
+        recieve();
+    }
+    if (state != State::CLOSED && (events & EPOLLOUT)) {
+        send();
+    }
+}
+
+void ServerSession::onData(const char* data, size_t len) {
+    if (state == State::CLOSED) return;
+
+    parser.append(data, len);
+    wakeReader();
+    throttleReading();
+}
+
+void ServerSession::onPeerClosed() {
+    std::cerr << "The connection was closed by client " << client_fd << std::endl;
+    stop();
+}
+
+void ServerSession::recieve() {
+    /// edge-triggered: читаем, пока сокет не опустеет или не сработает InboundLimits
+    while (state != State::CLOSED && !reading_paused) {
+        auto buf = parser.prepare(SIZE);
+        ssize_t len = ::recv(client_fd, buf.data(), buf.size(), 0);
+
+        if (len > 0) {
+            parser.commit(static_cast<size_t>(len));
+            wakeReader();
+            throttleReading();
+            continue;
+        }
+        if (len == 0) {
+            onPeerClosed();
+            return;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+
+        std::cerr << "server recv error\n";
         stop();
         return;
     }
 }
 
 void ServerSession::send() {
-    if (::send(listen_fd, message.c_str(), strlen(message.c_str()), 0) == -1) {
-        std::cerr << "server sending error\n";
-        std::flush(std::cerr);
+    while (!out_queue.empty()) {
+        /// scatter-gather: один sendmsg на пачку кадров без склейки в буфер
+        struct iovec iov[MAX_IOV];
+        size_t count = 0;
+
+        for (auto it = out_queue.begin(); it != out_queue.end() && count < MAX_IOV; ++it, ++count) {
+            size_t offset = (count == 0) ? out_offset : 0;
+            iov[count].iov_base = const_cast<char*>((*it)->data() + offset);
+            iov[count].iov_len = (*it)->size() - offset;
+        }
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+
+        ssize_t sent = ::sendmsg(client_fd, &msg, MSG_NOSIGNAL);
+
+        if (sent >= 0) {
+            size_t left = static_cast<size_t>(sent);
+            size_t frames = 0;
+
+            while (left > 0) {
+                size_t remaining = out_queue.front()->size() - out_offset;
+                if (left < remaining) {
+                    out_offset += left;
+                    break;
+                }
+                left -= remaining;
+                out_queue.pop_front();
+                out_offset = 0;
+                ++frames;
+            }
 
+            onSent(static_cast<size_t>(sent), frames);
+            continue;
+        }
+        if (errno == EINTR) continue;
+        /// остаток допишем по следующему фронту EPOLLOUT
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+
+        std::cerr << "server sending error\n";
         stop();
         return;
     }
 }
 
-void ServerSession::printMsg() {
-    std::cout << "server recieved message: ";
-    for (size_t i = 0; i < recv_len; ++i) {
-        printf("%c", recv_buf[i]);
+Task<void> ServerSession::handleFrame(const Frame& frame) {
+    if (frame.header.type == FrameType::PING) {
+        co_await writeFrame(makeSharedFrame(FrameType::PONG, ""));
+        co_return;
+    }
+    if (frame.header.type == FrameType::PONG) co_return;
+
+    if (frame.header.type == FrameType::AUTH) {
+        auto separator = frame.payload.find('\0');
+        std::string login(frame.payload.substr(0, separator));
+        std::string password;
+        if (separator != std::string::npos) {
+            password = frame.payload.substr(separator + 1);
+        }
+
+        co_await context.router.authenticate(*this, std::move(login), std::move(password));
+        co_return;
+    }
+
+    if (!user) {
+        co_await writeFrame(makeSharedFrame(FrameType::NOTICE, "Log in first"));
+        co_return;
     }
-    printf("\n");
-    
-    std::flush(std::cout);
+
+    switch (frame.header.type) {
+    case FrameType::MESSAGE:
+        printMsg(frame);
+        co_await context.router.chatMessage(*this, frame.header.chatID, frame.payload);
+        break;
+    case FrameType::COMMAND:
+        co_await context.router.command(*this, frame.payload);
+        break;
+    case FrameType::RESYNC:
+        co_await context.router.resync(*this, frame.header.chatID, frame.header.seq);
+        break;
+    case FrameType::ACK:
+        context.router.acknowledge(*this, frame.header.chatID, frame.header.seq);
+        break;
+    case FrameType::READ:
+        context.router.markRead(*this, frame.header.chatID, frame.header.seq);
+        break;
+    default:
+        std::cerr << "Unknown frame type " << static_cast<int>(frame.header.type) 
+                  << " from client " << client_fd << std::endl;
+        break;
+    }
+}
+
+void ServerSession::notice(std::string_view text) {
+    queueFrame(makeSharedFrame(FrameType::NOTICE, text));
+}
+
+void ServerSession::queueMessage(const std::string& frame) {
+    queueFrame(std::make_shared<const std::string>(frame));
+}
+
+bool ServerSession::queueFrame(SharedFrame frame) {
+    if (state == State::CLOSED) return false;
+
+    const OutboundLimits& limits = context.config.outbound;
+    bool overflow = 
+        stats.queued_bytes + frame->size() > limits.high_water_bytes ||
+        stats.queued_frames + 1 > limits.high_water_frames;
+
+    if (overflow) {
+        switch (limits.policy) {
+        case SlowConsumerPolicy::DROP:
+            ++stats.dropped_frames;
+            break;
+        case SlowConsumerPolicy::DISCONNECT:
+            std::cerr << "Slow consumer " << client_fd << " disconnected: " 
+                      << stats.queued_bytes << " bytes queued\n";
+            stop();
+            break;
+        case SlowConsumerPolicy::SPILL:
+            if (context.router.spill(user.get(), std::move(frame))) {
+                ++stats.spilled_frames;
+            }
+            else {
+                ++stats.dropped_frames;
+            }
+            break;
+        }
+        return false;
+    }
+
+    stats.queued_bytes += frame->size();
+    stats.queued_frames += 1;
+    stats.peak_bytes = std::max(stats.peak_bytes, stats.queued_bytes);
+
+    out_queue.emplace_back(std::move(frame));
+    context.transport.flush(*this);
+    return true;
+}
+
+void ServerSession::onSent(size_t bytes, size_t frames) {
+    stats.queued_bytes -= std::min(bytes, stats.queued_bytes);
+    stats.queued_frames -= std::min(frames, stats.queued_frames);
+    stats.sent_bytes += bytes;
+
+    if (write_waiter && stats.sent_bytes >= write_target) {
+        wakeLater(write_waiter);
+    }
+}
+
+void ServerSession::printMsg(const Frame& frame) {
+    std::cout << "server recieved message";
+    if (user) std::cout << " from " << user->getName();
+    std::cout << ": " << frame.payload << std::endl;
 }
 
 
 void ServerSession::setUser(std::unique_ptr<User> u) {
     user = std::move(u);
-}
\ No newline at end of file
+
+    /// корутина authDeadline() так и останется спящей до разрушения сессии
+    if (user && auth_timer) {
+        context.reactor.cancel(auth_timer);
+        auth_timer = 0;
+    }
+}
+
+
+void EpollTransport::open(ServerSession& session) {
+    reactor.add(session.getFD(), EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, &session);
+}
+
+void EpollTransport::flush(ServerSession& session) {
+    session.send();
+}
+
+void EpollTransport::close(ServerSession& session) {
+    reactor.remove(session.getFD());
+}
+
+void EpollTransport::pauseReading(ServerSession& session) {
+    reactor.modify(session.getFD(), EPOLLOUT | EPOLLET, &session);
+}
+
+void EpollTransport::resumeReading(ServerSession& session) {
+    /// EPOLL_CTL_MOD перепроверяет готовность: непрочитанное в сокете даст новый фронт
+    reactor.modify(session.getFD(), EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, &session);
+}
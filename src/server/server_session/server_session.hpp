@@ -1,9 +1,11 @@
 #pragma once
+#include <coroutine>
 #include <memory>
+#include <optional>
 #include <vector>
-#include <atomic>
-#include <thread>
-#include <mutex>
+#include <deque>
+#include <functional>
+#include <string>
 
 #include <unistd.h>
 #include <netdb.h>
@@ -12,39 +14,184 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <arpa/inet.h>
-#include <poll.h>
 #include <fcntl.h>
 
 #include "user.hpp"
+#include "frame_parser.hpp"
+#include "reactor/reactor.hpp"
+#include "session_transport.hpp"
+#include "router.hpp"
+#include "server_config.hpp"
+#include "task.hpp"
 
 
-#define BACKLOG 10
+#define BACKLOG SOMAXCONN
 #define SIZE 4096
+#define MAX_IOV 64
 
-/// @brief The connection of the client in the server
-class ServerSession {
+/// @brief Queue-depth counters of one session
+struct OutboundStats {
+    size_t queued_frames = 0;
+    size_t queued_bytes = 0;  // поставлено, но ещё не отправлено
+    size_t peak_bytes = 0;
+    size_t dropped_frames = 0;
+    size_t spilled_frames = 0;
+    uint64_t sent_bytes = 0;
+};
+
+/// @brief Per-shard services shared by all sessions of the shard
+struct SessionContext {
+    size_t shard;
+    Reactor& reactor;
+    ISessionTransport& transport;
+    IRouter& router;
+    const ServerConfig& config;
+};
+
+/// @brief The connection of the client in the server.
+/// Its socket is driven by an ISessionTransport, the request handling is 
+/// a coroutine on the shard's reactor: readFrame() -> handleFrame() -> writeFrame()
+class ServerSession : public IEventHandler {
+public:
+    enum class State {
+        CONNECTED,
+        CLOSED
+    };
+
+    /// @brief co_await session.readFrame(): the next frame, 
+    /// std::nullopt once the session is closed
+    class ReadFrameAwaiter {
+        ServerSession& session;
+        std::optional<Frame> frame;
+
+    public:
+        explicit ReadFrameAwaiter(ServerSession& session) : session(session) {}
+
+        bool await_ready() { return session.pollFrame(frame); }
+        void await_suspend(std::coroutine_handle<> awaiting);
+        std::optional<Frame> await_resume();
+    };
+
+    /// @brief co_await session.writeFrame(frame): resumes when the frame 
+    /// is written to the socket, false if it was dropped or the session closed
+    class WriteFrameAwaiter {
+        ServerSession& session;
+        SharedFrame frame;
+        bool queued = false;
+
+    public:
+        WriteFrameAwaiter(ServerSession& session, SharedFrame frame) 
+            : session(session), frame(std::move(frame)) 
+        {}
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> awaiting) { session.write_waiter = awaiting; }
+        bool await_resume() const { return queued && session.state != State::CLOSED; }
+    };
+
+private:
     std::unique_ptr<User> user;
-    std::atomic<bool> is_active{true};
+    State state = State::CONNECTED;
+
+    uint64_t serial; // уникален в пределах процесса, в отличие от fd
+    int client_fd;
+    SessionContext& context;
+    std::function<void(int)> on_close;
+
+    std::deque<SharedFrame> out_queue;
+    size_t out_offset = 0; // отправленная часть out_queue.front()
 
-    int listen_fd;
+    OutboundStats stats;
 
-    std::string message;
+    TimerId auth_timer = 0;
+    TimerId heartbeat_timer = 0;
+    TimerWheel::Clock::time_point last_activity;
     
-    size_t recv_len;
-    std::vector<char> recv_buf = std::vector<char>(SIZE);
+    FrameParser parser;
+    bool reading_paused = false; // InboundLimits: сокет не читается, пока serve() занят
+
+    /// кадры корутин, пока сессия жива; ждущая корутина всегда одна - serve()
+    Task<void> serve_task;
+    Task<void> heartbeat_task;
+    Task<void> auth_task;
+
+    std::optional<ID_t> drain_after; // офлайн-очередь пользователя ещё отправляется
+
+    std::coroutine_handle<> read_waiter;
+    std::coroutine_handle<> write_waiter;
+    uint64_t write_target = 0; // stats.sent_bytes, после которых будим write_waiter
     
 public:
-    ServerSession(int client_fd);
+    ServerSession(int client_fd, SessionContext& context, std::function<void(int)> on_close);
     ~ServerSession();
 
-    
+    ServerSession(const ServerSession& other) = delete;
+    ServerSession& operator=(const ServerSession& other) = delete;
+
     void start();
     void stop();
 
+    /// @brief epoll readiness events
+    void onEvent(uint32_t events) override;
+
+    /// @brief Bytes read from the socket by the transport
+    void onData(const char* data, size_t len);
+    void onPeerClosed();
+
     void recieve();
     void send();
 
-    void printMsg();
+    ReadFrameAwaiter readFrame() { return ReadFrameAwaiter(*this); }
+    WriteFrameAwaiter writeFrame(SharedFrame frame) { return WriteFrameAwaiter(*this, std::move(frame)); }
+
+    Task<void> handleFrame(const Frame& frame);
+
+    /// @brief Queues an already encoded frame (see encodeFrame)
+    void queueMessage(const std::string& frame);
+    /// @brief false if the frame was not queued because of the high-water mark
+    bool queueFrame(SharedFrame frame);
+
+    /// @brief The transport has written bytes of queued data, 
+    /// frames of them completely
+    void onSent(size_t bytes, size_t frames);
+    std::deque<SharedFrame>& outQueue() { return out_queue; }
+
+    void printMsg(const Frame& frame);
+
+private:
+    /// @brief Reads and handles frames until the session closes, then hands it to on_close
+    Task<void> serve();
+    Task<void> heartbeat();
+    Task<void> authDeadline();
+
+    /// @brief true if frame is taken or there will be none
+    bool pollFrame(std::optional<Frame>& frame);
+    void wakeReader();
+
+    /// @brief Pauses reading if serve() is busy and the unhandled input 
+    /// reached InboundLimits, serve() waiting for a frame resumes it
+    void throttleReading();
+
+    /// @brief Deferred: a wake-up from send()/stop() must not re-enter them
+    void wakeLater(std::coroutine_handle<>& waiter);
+
+public:
 
     void setUser(std::unique_ptr<User> u);
+
+    /// @brief serve() sends the user's offline queue batch by batch, 
+    /// handling the frames that came meanwhile first
+    void drainLater() { drain_after = 0; }
+
+    const User* getUser() const { return user.get(); }
+
+    /// @brief Reply from the server itself
+    void notice(std::string_view text);
+
+    State getState() const { return state; }
+    Reactor& getReactor() const { return context.reactor; }
+    int getFD() const { return client_fd; }
+    uint64_t getSerial() const { return serial; }
+    SessionHandle getHandle() const { return SessionHandle{context.shard, client_fd, serial}; }
+    const OutboundStats& getOutboundStats() const { return stats; }
 };
@@ -0,0 +1,39 @@
+#pragma once
+#include "reactor/reactor.hpp"
+
+class ServerSession;
+
+
+/// @brief Drives the socket of a ServerSession: readiness based (epoll)
+/// or completion based (io_uring, see uring/uring_driver.hpp)
+class ISessionTransport {
+public:
+    virtual ~ISessionTransport() = default;
+
+    /// @brief Starts delivering incoming bytes to session.onData()
+    virtual void open(ServerSession& session) = 0;
+
+    /// @brief Writes out what is queued in session.outQueue()
+    virtual void flush(ServerSession& session) = 0;
+
+    virtual void close(ServerSession& session) = 0;
+
+    /// @brief Stops reading the socket until resumeReading(), 
+    /// data already in flight still reaches session.onData()
+    virtual void pauseReading(ServerSession& session) = 0;
+    virtual void resumeReading(ServerSession& session) = 0;
+};
+
+
+class EpollTransport : public ISessionTransport {
+    Reactor& reactor;
+
+public:
+    explicit EpollTransport(Reactor& reactor) : reactor(reactor) {}
+
+    void open(ServerSession& session) override;
+    void flush(ServerSession& session) override;
+    void close(ServerSession& session) override;
+    void pauseReading(ServerSession& session) override;
+    void resumeReading(ServerSession& session) override;
+};
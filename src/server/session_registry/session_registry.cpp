@@ -0,0 +1,58 @@
+#include "session_registry.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+void SessionRegistry::add(ID_t userID, const SessionHandle& handle) {
+    Bucket& bucket = bucketOf(userID);
+    std::unique_lock lock(bucket.mtx);
+
+    bucket.users[userID].emplace_back(handle);
+}
+
+void SessionRegistry::remove(ID_t userID, uint64_t serial) {
+    Bucket& bucket = bucketOf(userID);
+    std::unique_lock lock(bucket.mtx);
+
+    auto it = bucket.users.find(userID);
+    if (it == bucket.users.end()) return;
+
+    auto& handles = it->second;
+    std::erase_if(handles, [serial] (const SessionHandle& h) { return h.serial == serial; });
+
+    if (handles.empty()) bucket.users.erase(it);
+}
+
+std::vector<SessionHandle> SessionRegistry::find(ID_t userID) const {
+    const Bucket& bucket = bucketOf(userID);
+    std::shared_lock lock(bucket.mtx);
+
+    auto it = bucket.users.find(userID);
+    if (it == bucket.users.end()) return {};
+
+    return it->second;
+}
+
+bool SessionRegistry::isOnline(ID_t userID) const {
+    const Bucket& bucket = bucketOf(userID);
+    std::shared_lock lock(bucket.mtx);
+
+    return bucket.users.contains(userID);
+}
+
+bool SessionRegistry::ifOffline(ID_t userID, const std::function<void()>& fn) const {
+    const Bucket& bucket = bucketOf(userID);
+    std::shared_lock lock(bucket.mtx);
+
+    if (bucket.users.contains(userID)) return false;
+    fn();
+    return true;
+}
+
+SessionRegistry::Bucket& SessionRegistry::bucketOf(ID_t userID) {
+    return buckets[static_cast<uint64_t>(userID) % BUCKETS];
+}
+
+const SessionRegistry::Bucket& SessionRegistry::bucketOf(ID_t userID) const {
+    return buckets[static_cast<uint64_t>(userID) % BUCKETS];
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <functional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+#include <array>
+
+#include "db/db.hpp"
+
+
+/// @brief Where a session lives. Sessions are touched only on their 
+/// shard's thread, so other threads keep handles, not pointers. 
+/// A stale handle is detected by the serial when the shard resolves it
+struct SessionHandle {
+    size_t shard = 0;
+    int fd = -1;
+    uint64_t serial = 0;
+};
+
+/// @brief Online sessions by user ID, several devices per user.
+/// Lock-striped: a lookup locks only the bucket of one user
+class SessionRegistry {
+    static constexpr size_t BUCKETS = 64;
+
+    struct Bucket {
+        mutable std::shared_mutex mtx;
+        std::unordered_map<ID_t, std::vector<SessionHandle> > users;
+    };
+
+    std::array<Bucket, BUCKETS> buckets;
+
+public:
+    void add(ID_t userID, const SessionHandle& handle);
+    void remove(ID_t userID, uint64_t serial);
+
+    std::vector<SessionHandle> find(ID_t userID) const;
+    bool isOnline(ID_t userID) const;
+
+    /// @brief Runs fn under the lock of the user's bucket if the user has 
+    /// no sessions: add() waits for it, so whatever fn queues for the user
+    /// is there before the login. false - the user is online, fn is not run
+    bool ifOffline(ID_t userID, const std::function<void()>& fn) const;
+
+private:
+    Bucket& bucketOf(ID_t userID);
+    const Bucket& bucketOf(ID_t userID) const;
+};
@@ -0,0 +1,136 @@
+#include "shard.hpp"
+
+#include <iostream>
+#include <errno.h>
+
+Shard::Shard(size_t index, const ServerConfig& config, IRouter& router) 
+    : index(index), router(router), config(config)
+{
+    if (config.backend == IoBackend::IO_URING) {
+#ifdef HAVE_IO_URING
+        uring = std::make_unique<UringDriver>(reactor);
+        if (uring->init()) {
+            transport = uring.get();
+        }
+        else {
+            uring.reset();
+            std::cerr << "shard " << index << ": io_uring is unavailable, falling back to epoll\n";
+        }
+#else
+        std::cerr << "shard " << index << ": built without liburing, falling back to epoll\n";
+#endif
+    }
+
+    context = std::make_unique<SessionContext>(SessionContext{index, reactor, *transport, router, config});
+}
+
+Shard::~Shard() {
+    stop();
+    join();
+
+    sessions.clear();
+    if (listen_fd != -1) close(listen_fd);
+}
+
+void Shard::attachListener(int fd) {
+    listen_fd = fd;
+
+    int flags = fcntl(listen_fd, F_GETFL);
+    fcntl(listen_fd, F_SETFL, flags | O_NONBLOCK);
+
+#ifdef HAVE_IO_URING
+    if (uring) {
+        uring->acceptOn(listen_fd, [this] (int client_fd) { addSession(client_fd); });
+        return;
+    }
+#endif
+
+    reactor.add(listen_fd, EPOLLIN | EPOLLET, this);
+}
+
+void Shard::start() {
+    thread = std::thread(&Reactor::run, &reactor);
+}
+
+void Shard::stop() {
+    is_active = false;
+    reactor.stop();
+}
+
+void Shard::join() {
+    if (thread.joinable()) thread.join();
+}
+
+void Shard::post(std::function<void()> task) {
+    reactor.post(std::move(task));
+}
+
+void Shard::postAfter(std::chrono::milliseconds delay, std::function<void()> task) {
+    reactor.post([this, delay, task = std::move(task)] () mutable {
+        reactor.schedule(delay, std::move(task));
+    });
+}
+
+void Shard::onEvent(uint32_t events) {
+    if (events & EPOLLIN) {
+        acceptConnections();
+    }
+}
+
+void Shard::deliverLocal(const SessionHandle& handle, const SharedFrame& frame) {
+    if (ServerSession* session = findSession(handle)) {
+        session->queueFrame(frame);
+    }
+}
+
+ServerSession* Shard::findSession(const SessionHandle& handle) {
+    auto it = sessions.find(handle.fd);
+    /// fd мог быть переиспользован новой сессией
+    if (it == sessions.end() || it->second->getSerial() != handle.serial) return nullptr;
+    if (it->second->getState() == ServerSession::State::CLOSED) return nullptr;
+
+    return it->second.get();
+}
+
+void Shard::acceptConnections() {
+    /// edge-triggered: принимаем всё, что накопилось в очереди listen
+    while (is_active) {
+        struct sockaddr_storage calling_info;
+        socklen_t calling_size = sizeof(calling_info);
+
+        int client_fd = accept4(
+            listen_fd, 
+            (struct sockaddr *)&calling_info, 
+            &calling_size, 
+            SOCK_NONBLOCK | SOCK_CLOEXEC
+        );
+
+        if (client_fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+
+            std::perror("server accept error");
+            return;
+        }
+
+        addSession(client_fd);
+    }
+}
+
+void Shard::addSession(int client_fd) {
+    auto session = std::make_unique<ServerSession>(
+        client_fd, 
+        *context,
+        [this] (int fd) { removeSession(fd); }
+    );
+    session->start();
+
+    sessions.emplace(client_fd, std::move(session));
+}
+
+void Shard::removeSession(int client_fd) {
+    /// сессия удаляется после обработки текущей пачки событий
+    reactor.defer([this, client_fd] () {
+        sessions.erase(client_fd);
+    });
+}
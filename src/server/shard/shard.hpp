@@ -0,0 +1,77 @@
+#pragma once
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+#include "server_config.hpp"
+#include "reactor/reactor.hpp"
+#include "server_session/server_session.hpp"
+
+#ifdef HAVE_IO_URING
+#include "uring/uring_driver.hpp"
+#endif
+
+
+/// @brief One reactor thread with its own SO_REUSEPORT listening socket
+/// and the sessions accepted on it. Sessions never migrate between shards,
+/// other threads reach them only through post()
+class Shard : public IEventHandler {
+    std::atomic<bool> is_active{true};
+
+    size_t index;
+    int listen_fd = -1;
+
+    IRouter& router;
+    const ServerConfig& config;
+
+    Reactor reactor;
+
+    EpollTransport epoll_transport{reactor};
+#ifdef HAVE_IO_URING
+    std::unique_ptr<UringDriver> uring;
+#endif
+    ISessionTransport* transport = &epoll_transport;
+
+    std::unique_ptr<SessionContext> context;
+
+    std::unordered_map<int, std::unique_ptr<ServerSession> > sessions;
+
+    std::thread thread;
+
+public:
+    Shard(size_t index, const ServerConfig& config, IRouter& router);
+    ~Shard();
+
+    Shard(const Shard& other) = delete;
+    Shard& operator=(const Shard& other) = delete;
+
+    void attachListener(int fd);
+
+    void start();
+    void stop();
+    void join();
+
+    /// @brief Thread-safe: runs task on the shard's reactor thread
+    void post(std::function<void()> task);
+
+    /// @brief Thread-safe: runs task on the shard's reactor thread after delay
+    void postAfter(std::chrono::milliseconds delay, std::function<void()> task);
+
+    void onEvent(uint32_t events) override;
+
+    /// @brief Reactor thread only: ignores the handle if the session is gone
+    void deliverLocal(const SessionHandle& handle, const SharedFrame& frame);
+
+    /// @brief Reactor thread only: nullptr if the session behind handle is closed
+    ServerSession* findSession(const SessionHandle& handle);
+
+    size_t getIndex() const { return index; }
+
+private:
+    void acceptConnections();
+
+    void addSession(int client_fd);
+    void removeSession(int client_fd);
+};
@@ -0,0 +1,339 @@
+#include "uring_driver.hpp"
+
+#include <iostream>
+#include <errno.h>
+#include <string.h>
+
+/// не больше стольких send в одной связанной цепочке
+#define MAX_LINKED_SENDS 64
+
+UringDriver::UringDriver(Reactor& reactor) 
+    : reactor(reactor)
+{}
+
+UringDriver::~UringDriver() {
+    if (!ring_ready) return;
+
+    if (buf_ring) {
+        io_uring_free_buf_ring(&ring, buf_ring, buf_count, BUF_GROUP);
+    }
+    io_uring_queue_exit(&ring);
+}
+
+bool UringDriver::init(unsigned entries, unsigned buffers_count, unsigned buffer_size) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int ret = io_uring_queue_init_params(entries, &ring, &params);
+    if (ret < 0) {
+        std::cerr << "io_uring_queue_init error: " << strerror(-ret) << std::endl;
+        return false;
+    }
+    ring_ready = true;
+
+    /// кольцо буферов требует степень двойки
+    buf_count = 1;
+    while (buf_count < buffers_count) buf_count <<= 1;
+    buf_size = buffer_size;
+    buffers.resize(static_cast<size_t>(buf_count) * buf_size);
+
+    buf_ring = io_uring_setup_buf_ring(&ring, buf_count, BUF_GROUP, 0, &ret);
+    if (!buf_ring) {
+        std::cerr << "io_uring_setup_buf_ring error: " << strerror(-ret) << std::endl;
+        return false;
+    }
+
+    int mask = io_uring_buf_ring_mask(buf_count);
+    for (unsigned i = 0; i < buf_count; ++i) {
+        io_uring_buf_ring_add(buf_ring, buffers.data() + static_cast<size_t>(i) * buf_size, buf_size, i, mask, i);
+    }
+    io_uring_buf_ring_advance(buf_ring, buf_count);
+
+    reactor.add(ring.ring_fd, EPOLLIN | EPOLLET, this);
+    return true;
+}
+
+void UringDriver::acceptOn(int fd, std::function<void(int)> callback) {
+    listen_fd = fd;
+    on_accept = std::move(callback);
+
+    armAccept();
+    /// реактор ещё не запущен, отправляем сразу
+    io_uring_submit(&ring);
+}
+
+void UringDriver::open(ServerSession& session) {
+    SessionOps& ops = sessions[session.getSerial()];
+    ops.session = &session;
+    ops.fd = session.getFD();
+
+    armRecv(session.getSerial(), ops);
+}
+
+void UringDriver::flush(ServerSession& session) {
+    auto it = sessions.find(session.getSerial());
+    if (it == sessions.end()) return;
+
+    /// новая цепочка уходит только после завершения предыдущей,
+    /// иначе две цепочки могут переупорядочиться
+    if (it->second.pending_sends > 0) return;
+
+    submitSends(it->first, it->second);
+}
+
+void UringDriver::close(ServerSession& session) {
+    auto it = sessions.find(session.getSerial());
+    if (it == sessions.end()) return;
+
+    SessionOps& ops = it->second;
+    ops.session = nullptr;
+
+    if (ops.recv_armed) cancelRecv(it->first);
+
+    release(it->first);
+}
+
+void UringDriver::pauseReading(ServerSession& session) {
+    auto it = sessions.find(session.getSerial());
+    if (it == sessions.end() || it->second.recv_paused) return;
+
+    it->second.recv_paused = true;
+    if (it->second.recv_armed) cancelRecv(it->first);
+}
+
+void UringDriver::resumeReading(ServerSession& session) {
+    auto it = sessions.find(session.getSerial());
+    if (it == sessions.end() || !it->second.recv_paused) return;
+
+    /// отменённый recv ещё не завершился - его завершение перевзведёт recv
+    it->second.recv_paused = false;
+    if (!it->second.recv_armed) armRecv(it->first, it->second);
+}
+
+void UringDriver::onEvent(uint32_t) {
+    while (io_uring_cq_ready(&ring) > 0) {
+        struct io_uring_cqe* cqe;
+        unsigned head;
+        unsigned count = 0;
+
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            handle(cqe);
+            ++count;
+        }
+        io_uring_cq_advance(&ring, count);
+    }
+
+    if (io_uring_sq_ready(&ring) > 0) scheduleSubmit();
+}
+
+struct io_uring_sqe* UringDriver::getSqe() {
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    while (!sqe) {
+        io_uring_submit(&ring);
+        sqe = io_uring_get_sqe(&ring);
+    }
+    return sqe;
+}
+
+void UringDriver::scheduleSubmit() {
+    if (submit_scheduled) return;
+    submit_scheduled = true;
+
+    /// один io_uring_enter на всю пачку событий реактора
+    reactor.defer([this] () {
+        submit_scheduled = false;
+        io_uring_submit(&ring);
+    });
+}
+
+void UringDriver::armAccept() {
+    struct io_uring_sqe* sqe = getSqe();
+    io_uring_prep_multishot_accept(sqe, listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    io_uring_sqe_set_data64(sqe, makeData(ACCEPT, 0));
+    scheduleSubmit();
+}
+
+void UringDriver::armRecv(uint64_t serial, SessionOps& ops) {
+    struct io_uring_sqe* sqe = getSqe();
+    io_uring_prep_recv_multishot(sqe, ops.fd, nullptr, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUF_GROUP;
+    io_uring_sqe_set_data64(sqe, makeData(RECV, serial));
+
+    ops.recv_armed = true;
+    scheduleSubmit();
+}
+
+void UringDriver::cancelRecv(uint64_t serial) {
+    struct io_uring_sqe* sqe = getSqe();
+    io_uring_prep_cancel64(sqe, makeData(RECV, serial), 0);
+    io_uring_sqe_set_data64(sqe, makeData(CANCEL, serial));
+    scheduleSubmit();
+}
+
+void UringDriver::submitSends(uint64_t serial, SessionOps& ops) {
+    if (ops.session) {
+        auto& queue = ops.session->outQueue();
+        while (!queue.empty()) {
+            ops.inflight.emplace_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+    }
+    if (ops.inflight.empty()) return;
+
+    size_t count = std::min<size_t>(ops.inflight.size(), MAX_LINKED_SENDS);
+
+    /// цепочка не должна разрываться посередине io_uring_submit
+    if (io_uring_sq_space_left(&ring) < count) io_uring_submit(&ring);
+
+    for (size_t i = 0; i < count; ++i) {
+        const std::string& chunk = *ops.inflight[i];
+        size_t offset = (i == 0) ? ops.front_offset : 0;
+
+        struct io_uring_sqe* sqe = getSqe();
+        io_uring_prep_send(sqe, ops.fd, chunk.data() + offset, chunk.size() - offset, MSG_NOSIGNAL | MSG_WAITALL);
+        io_uring_sqe_set_data64(sqe, makeData(SEND, serial));
+
+        if (i + 1 < count) sqe->flags |= IOSQE_IO_LINK;
+    }
+
+    ops.pending_sends = count;
+    scheduleSubmit();
+}
+
+void UringDriver::handle(struct io_uring_cqe* cqe) {
+    switch (getOp(io_uring_cqe_get_data64(cqe))) {
+    case ACCEPT:
+        handleAccept(cqe);
+        break;
+    case RECV:
+        handleRecv(cqe);
+        break;
+    case SEND:
+        handleSend(cqe);
+        break;
+    default:
+        break;
+    }
+}
+
+void UringDriver::handleAccept(struct io_uring_cqe* cqe) {
+    if (cqe->res >= 0) {
+        on_accept(cqe->res);
+    }
+    else if (cqe->res != -ECANCELED) {
+        std::cerr << "server accept error: " << strerror(-cqe->res) << std::endl;
+    }
+
+    if (!(cqe->flags & IORING_CQE_F_MORE) && listen_fd != -1) {
+        armAccept();
+    }
+}
+
+void UringDriver::handleRecv(struct io_uring_cqe* cqe) {
+    uint64_t serial = getSerial(io_uring_cqe_get_data64(cqe));
+    int res = cqe->res;
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        unsigned buffer_id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+        auto it = sessions.find(serial);
+        if (res > 0 && it != sessions.end() && it->second.session) {
+            it->second.session->onData(buffers.data() + static_cast<size_t>(buffer_id) * buf_size, res);
+        }
+        recycle(buffer_id);
+    }
+
+    /// обработчики выше могли изменить sessions
+    auto it = sessions.find(serial);
+    if (it == sessions.end()) return;
+
+    if (res == 0) {
+        if (it->second.session) it->second.session->onPeerClosed();
+    }
+    else if (res < 0 && res != -ENOBUFS && res != -ECANCELED) {
+        if (it->second.session) {
+            std::cerr << "server recv error: " << strerror(-res) << std::endl;
+            it->second.session->stop();
+        }
+    }
+
+    if (cqe->flags & IORING_CQE_F_MORE) return;
+
+    it = sessions.find(serial);
+    if (it == sessions.end()) return;
+
+    it->second.recv_armed = false;
+    if (it->second.recv_paused && it->second.session) return;
+
+    /// -ECANCELED без закрытия сессии - пауза, снятая до завершения отмены
+    if (it->second.session && (res > 0 || res == -ENOBUFS || res == -ECANCELED)) {
+        armRecv(serial, it->second);
+    }
+    else {
+        release(serial);
+    }
+}
+
+void UringDriver::handleSend(struct io_uring_cqe* cqe) {
+    uint64_t serial = getSerial(io_uring_cqe_get_data64(cqe));
+    int res = cqe->res;
+
+    auto it = sessions.find(serial);
+    if (it == sessions.end()) return;
+
+    SessionOps& ops = it->second;
+    --ops.pending_sends;
+
+    if (res >= 0) {
+        size_t frames = 0;
+        size_t remaining = ops.inflight.front()->size() - ops.front_offset;
+        if (static_cast<size_t>(res) >= remaining) {
+            ops.inflight.pop_front();
+            ops.front_offset = 0;
+            frames = 1;
+        }
+        else {
+            /// короткая запись рвёт цепочку, хвост придёт с -ECANCELED
+            ops.front_offset += res;
+        }
+
+        if (ops.session) ops.session->onSent(static_cast<size_t>(res), frames);
+    }
+    else if (res != -ECANCELED && ops.session) {
+        std::cerr << "server sending error: " << strerror(-res) << std::endl;
+        ops.session->stop();
+    }
+
+    it = sessions.find(serial);
+    if (it == sessions.end() || it->second.pending_sends > 0) return;
+
+    if (it->second.session) {
+        submitSends(serial, it->second);
+    }
+    else {
+        release(serial);
+    }
+}
+
+void UringDriver::recycle(unsigned buffer_id) {
+    io_uring_buf_ring_add(
+        buf_ring, 
+        buffers.data() + static_cast<size_t>(buffer_id) * buf_size, 
+        buf_size, 
+        buffer_id, 
+        io_uring_buf_ring_mask(buf_count), 
+        0
+    );
+    io_uring_buf_ring_advance(buf_ring, 1);
+}
+
+void UringDriver::release(uint64_t serial) {
+    auto it = sessions.find(serial);
+    if (it == sessions.end()) return;
+
+    const SessionOps& ops = it->second;
+    if (!ops.session && !ops.recv_armed && ops.pending_sends == 0) {
+        sessions.erase(it);
+    }
+}
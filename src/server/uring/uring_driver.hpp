@@ -0,0 +1,97 @@
+#pragma once
+#include <unordered_map>
+#include <functional>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <liburing.h>
+
+#include "reactor/reactor.hpp"
+#include "server_session/server_session.hpp"
+
+
+/// @brief io_uring transport of one shard.
+/// Multishot accept, multishot recv into a provided buffer ring and
+/// linked sends. The ring fd is watched by the shard's Reactor, so posted
+/// tasks keep working, and all SQEs of one event batch are submitted once
+class UringDriver : public ISessionTransport, public IEventHandler {
+    enum Op : uint64_t {
+        ACCEPT = 1,
+        RECV,
+        SEND,
+        CANCEL
+    };
+
+    static constexpr int BUF_GROUP = 0;
+
+    struct SessionOps {
+        ServerSession* session = nullptr;
+        int fd = -1;
+        bool recv_armed = false;
+        bool recv_paused = false; // InboundLimits, recv не перевзводится
+
+        /// буферы отправок, на которые ссылается ядро
+        std::deque<SharedFrame> inflight;
+        size_t front_offset = 0;
+        size_t pending_sends = 0;
+    };
+
+    Reactor& reactor;
+
+    struct io_uring ring;
+    bool ring_ready = false;
+    bool submit_scheduled = false;
+
+    struct io_uring_buf_ring* buf_ring = nullptr;
+    std::vector<char> buffers;
+    unsigned buf_count = 0;
+    unsigned buf_size = 0;
+
+    int listen_fd = -1;
+    std::function<void(int)> on_accept;
+
+    std::unordered_map<uint64_t, SessionOps> sessions;
+
+public:
+    explicit UringDriver(Reactor& reactor);
+    ~UringDriver();
+
+    UringDriver(const UringDriver& other) = delete;
+    UringDriver& operator=(const UringDriver& other) = delete;
+
+    /// @brief false if the kernel lacks the required io_uring features
+    bool init(unsigned entries = 4096, unsigned buffers_count = 4096, unsigned buffer_size = SIZE);
+
+    void acceptOn(int fd, std::function<void(int)> callback);
+
+    void open(ServerSession& session) override;
+    void flush(ServerSession& session) override;
+    void close(ServerSession& session) override;
+    void pauseReading(ServerSession& session) override;
+    void resumeReading(ServerSession& session) override;
+
+    /// @brief The ring fd has completions
+    void onEvent(uint32_t events) override;
+
+private:
+    static uint64_t makeData(Op op, uint64_t serial) { return (static_cast<uint64_t>(op) << 56) | serial; }
+    static Op getOp(uint64_t data) { return static_cast<Op>(data >> 56); }
+    static uint64_t getSerial(uint64_t data) { return data & ((1ULL << 56) - 1); }
+
+    struct io_uring_sqe* getSqe();
+    void scheduleSubmit();
+
+    void armAccept();
+    void armRecv(uint64_t serial, SessionOps& ops);
+    void cancelRecv(uint64_t serial);
+    void submitSends(uint64_t serial, SessionOps& ops);
+
+    void handle(struct io_uring_cqe* cqe);
+    void handleAccept(struct io_uring_cqe* cqe);
+    void handleRecv(struct io_uring_cqe* cqe);
+    void handleSend(struct io_uring_cqe* cqe);
+
+    void recycle(unsigned buffer_id);
+    void release(uint64_t serial);
+};
@@ -0,0 +1,5 @@
+#pragma once
+#include <cstdint>
+
+/// @brief ID of a user, chat or message, shared by the protocol, the server and DB
+using ID_t = int64_t;
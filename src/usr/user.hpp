@@ -29,4 +29,7 @@ public:
     std::string getPassword() const { return passwordHash_; }
 
     bool operator==(const User&) const = default;
-};
\ No newline at end of file
+};
+
+/// @brief Password hash stored in User::passwordHash_ (see hash.cpp)
+std::string hash(std::string str);
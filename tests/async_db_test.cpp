@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include "db/db.hpp"
+#include "db/async_db.hpp"
+#include "exec/task.hpp"
+#include "usr/user.hpp"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+class AsyncDBTest : public ::testing::Test {
+protected:
+    std::shared_ptr<DB> db;
+    std::unique_ptr<AsyncDB> async_db;
+
+public:
+    void SetUp() override {
+        db = std::make_shared<DB>();
+        db->init(
+            ":memory:", 
+            std::string(PROJECT_SOURCE_DIR) + "/assets/sql/createDB.sql"
+        );
+        async_db = std::make_unique<AsyncDB>(db, 2);
+    }
+
+    void TearDown() override {
+        async_db.reset();
+        db.reset();
+    }
+};
+
+TEST_F(AsyncDBTest, save_and_find_user_through_futures) {
+    // arrange
+    auto saved = async_db->saveAsync(User("Alice", "password1"));
+
+    // act
+    auto id = saved.get();
+    auto found = async_db->findUserAsync("Alice").get();
+
+    // assert
+    ASSERT_TRUE(id.has_value());
+    ASSERT_TRUE(found.has_value());
+    EXPECT_EQ(found->getID(), id);
+}
+
+TEST_F(AsyncDBTest, runs_queries_off_the_calling_thread) {
+    // arrange
+    auto caller = std::this_thread::get_id();
+
+    // act
+    auto worker = async_db->submit([] (DB&) { return std::this_thread::get_id(); }).get();
+
+    // assert
+    EXPECT_NE(worker, caller);
+}
+
+TEST_F(AsyncDBTest, future_rethrows_query_exception) {
+    // act
+    auto result = async_db->submit([] (DB&) -> int { throw std::runtime_error("query failed"); });
+
+    // assert
+    EXPECT_THROW(result.get(), std::runtime_error);
+}
+
+TEST_F(AsyncDBTest, counts_completed_queries) {
+    // arrange
+    constexpr int Queries_Count = 20;
+    std::vector<std::future<std::optional<User> > > results;
+
+    // act
+    for (int i = 0; i < Queries_Count; ++i) {
+        results.push_back(async_db->findUserAsync("User_" + std::to_string(i)));
+    }
+    for (auto& result : results) result.get();
+
+    // assert
+    auto metrics = async_db->metrics();
+    EXPECT_EQ(metrics.completed, static_cast<uint64_t>(Queries_Count));
+    EXPECT_EQ(metrics.queueDepth, 0u);
+    EXPECT_GE(metrics.peakQueueDepth, 1u);
+}
+
+TEST_F(AsyncDBTest, coroutine_resumes_on_home_thread) {
+    // arrange
+    struct InlineHome {
+        std::mutex mtx;
+        std::vector<std::function<void()> > tasks;
+
+        void post(std::function<void()> task) {
+            std::scoped_lock lock(mtx);
+            tasks.emplace_back(std::move(task));
+        }
+    } home;
+
+    async_db->saveAsync(User("Alice", "password1")).get();
+    std::optional<User> found;
+
+    auto request = [&] () -> Task<void> {
+        found = co_await async_db->async(home, [] (DB& db) { return db.findUser("Alice"); });
+    };
+
+    // act
+    Task<void> task = request();
+    task.start();
+
+    while (!task.done()) {
+        std::vector<std::function<void()> > ready;
+        {
+            std::scoped_lock lock(home.mtx);
+            ready.swap(home.tasks);
+        }
+        for (auto& resume : ready) resume();
+        std::this_thread::yield();
+    }
+
+    // assert
+    ASSERT_TRUE(found.has_value());
+    EXPECT_EQ(found->getName(), "Alice");
+}
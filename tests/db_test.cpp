@@ -6,9 +6,13 @@
 #include "message/message.hpp"
 
 #include <string>
+#include <string_view>
 #include <memory>
 #include <thread>
 #include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 
 class DBTest : public ::testing::Test {
 protected:
@@ -17,9 +21,12 @@ protected:
 public:
     void SetUp() override {
         db = std::make_shared<DB>();
+        DBOptions options;
+        options.migrations = std::string(PROJECT_SOURCE_DIR) + "/assets/sql/migrations";
         db->init(
             ":memory:", 
-            std::string(PROJECT_SOURCE_DIR) + "/assets/sql/createDB.sql"
+            std::string(PROJECT_SOURCE_DIR) + "/assets/sql/createDB.sql",
+            options
         );
     }
     
@@ -242,6 +249,11 @@ TEST_F(DBTest, find_saved_user_by_name) {
     EXPECT_EQ(user, *pulled_user);
 }
 
+TEST_F(DBTest, not_find_unsaved_user) {
+    EXPECT_FALSE(db->findUser("Nobody").has_value());
+    EXPECT_FALSE(db->findUser(ID_t{42}).has_value());
+}
+
 // -- Message --
 
 TEST_F(DBTest, save_message_to_db) {
@@ -293,6 +305,354 @@ TEST_F(DBTest, save_rvalue_message) {
     EXPECT_EQ(getTableSize("MessagesHistory"), 1);
 }
 
+TEST_F(DBTest, save_messages_batch_in_one_transaction) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Bob", "password2");
+
+    for (User& user : users) {
+        ASSERT_TRUE(db->save(user));
+    }
+
+    Chat chat(db, users, ChatType::Type::PERSONAL);
+    ASSERT_TRUE(db->save(chat));
+
+    std::vector<Message> messages;
+    messages.emplace_back(*chat.getID(), *users[0].getID(), "first");
+    messages.emplace_back(*chat.getID() + 100, *users[0].getID(), "to missing chat");
+    messages.emplace_back(*chat.getID(), *users[1].getID(), "second");
+
+    // act
+    size_t saved = db->saveBatch(messages);
+
+    // assert
+    EXPECT_EQ(saved, 2u);
+    EXPECT_TRUE(messages[0].getID().has_value());
+    EXPECT_FALSE(messages[1].getID().has_value());
+    EXPECT_TRUE(messages[2].getID().has_value());
+    EXPECT_EQ(getTableSize("MessagesHistory"), 2);
+}
+
+TEST_F(DBTest, not_save_message_to_missing_chat) {
+    // arrange
+    User user("Alice", "password1");
+    ASSERT_TRUE(db->save(user));
+
+    // act
+    bool save_res = db->save(Message{42, *user.getID(), "nowhere"});
+
+    // assert
+    EXPECT_FALSE(save_res);
+    EXPECT_EQ(getTableSize("MessagesHistory"), 0);
+}
+
+TEST_F(DBTest, save_users_batch_in_one_transaction) {
+    // arrange
+    ASSERT_TRUE(db->save(User("Taken", "password0")));
+
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Taken", "password2");
+    users.emplace_back("Bob", "password3");
+
+    // act
+    size_t saved = db->saveUsers(users);
+
+    // assert
+    EXPECT_EQ(saved, 2u);
+    ASSERT_TRUE(users[0].getID().has_value());
+    EXPECT_FALSE(users[1].getID().has_value());
+    ASSERT_TRUE(users[2].getID().has_value());
+    EXPECT_EQ(db->findUser("Bob")->getID(), users[2].getID());
+}
+
+TEST_F(DBTest, find_users_by_ids_in_one_query) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Bob", "password2");
+    users.emplace_back("Carol", "password3");
+    ASSERT_EQ(db->saveUsers(users), 3u);
+    db->findUser(*users[1].getID()); // Bob уже в кэше
+
+    std::vector<ID_t> ids{*users[2].getID(), 1000, *users[0].getID(), *users[1].getID()};
+
+    // act
+    auto found = db->findUsers(ids);
+
+    // assert
+    ASSERT_EQ(found.size(), 3u);
+    EXPECT_EQ(found[0].getName(), "Carol");
+    EXPECT_EQ(found[1].getName(), "Alice");
+    EXPECT_EQ(found[2].getName(), "Bob");
+    EXPECT_EQ(found[2].getPassword(), "password2");
+}
+
+TEST_F(DBTest, chat_with_missing_member_is_not_saved) {
+    // arrange
+    User alice("Alice", "password1");
+    ASSERT_TRUE(db->save(alice));
+    std::vector<ID_t> members{*alice.getID(), 1000};
+    Chat chat(db, members, ChatType::Type::GROUP, "ghosts");
+    ssize_t chatsBefore = getTableSize("Chat");
+
+    // act
+    bool saved = db->save(chat);
+
+    // assert
+    EXPECT_FALSE(saved);
+    EXPECT_EQ(getTableSize("Chat"), chatsBefore);
+    EXPECT_EQ(getTableSize("ChatMembers"), 0);
+    EXPECT_FALSE(db->findChat("ghosts").has_value());
+}
+
+TEST_F(DBTest, fetch_history_pages_by_keyset) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Bob", "password2");
+    for (User& user : users) {
+        ASSERT_TRUE(db->save(user));
+    }
+
+    Chat chat(db, users, ChatType::Type::PERSONAL);
+    ASSERT_TRUE(db->save(chat));
+
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(db->save(Message(*chat.getID(), *users[i % 2].getID(), "msg " + std::to_string(i))));
+    }
+
+    // act
+    auto first = db->fetchHistory(*chat.getID(), std::numeric_limits<ID_t>::max(), 2);
+    auto second = db->fetchHistory(*chat.getID(), *first.back().getID(), 2);
+    auto third = db->fetchHistory(*chat.getID(), *second.back().getID(), 2);
+
+    // assert
+    ASSERT_EQ(first.size(), 2u);
+    ASSERT_EQ(second.size(), 2u);
+    ASSERT_EQ(third.size(), 1u);
+
+    EXPECT_EQ(first[0].getText(), "msg 4");
+    EXPECT_EQ(first[1].getText(), "msg 3");
+    EXPECT_EQ(second[1].getText(), "msg 1");
+    EXPECT_EQ(third[0].getText(), "msg 0");
+    EXPECT_EQ(third[0].getSenderID(), *users[0].getID());
+}
+
+TEST_F(DBTest, fetch_messages_since_id) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Bob", "password2");
+    for (User& user : users) {
+        ASSERT_TRUE(db->save(user));
+    }
+
+    Chat chat(db, users, ChatType::Type::PERSONAL);
+    ASSERT_TRUE(db->save(chat));
+
+    Message seen(*chat.getID(), *users[0].getID(), "seen");
+    ASSERT_TRUE(db->save(seen));
+    ASSERT_TRUE(db->save(Message(*chat.getID(), *users[1].getID(), "new 1")));
+    ASSERT_TRUE(db->save(Message(*chat.getID(), *users[0].getID(), "new 2")));
+
+    // act
+    auto fresh = db->fetchSince(*chat.getID(), *seen.getID());
+
+    // assert
+    ASSERT_EQ(fresh.size(), 2u);
+    EXPECT_EQ(fresh[0].getText(), "new 1");
+    EXPECT_EQ(fresh[1].getText(), "new 2");
+}
+
+TEST_F(DBTest, numbers_messages_per_chat_and_fetches_since_seq) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Bob", "password2");
+    users.emplace_back("Carol", "password3");
+    for (User& user : users) {
+        ASSERT_TRUE(db->save(user));
+    }
+
+    std::vector<User> first{users[0], users[1]};
+    std::vector<User> second{users[0], users[2]};
+    Chat chat(db, first, ChatType::Type::PERSONAL);
+    Chat other(db, second, ChatType::Type::PERSONAL);
+    ASSERT_TRUE(db->save(chat));
+    ASSERT_TRUE(db->save(other));
+
+    std::vector<Message> batch;
+    for (int i = 0; i < 3; ++i) {
+        batch.emplace_back(*chat.getID(), *users[0].getID(), "batch " + std::to_string(i));
+    }
+    batch.emplace_back(*other.getID(), *users[0].getID(), "other chat");
+
+    // act
+    Message single(*chat.getID(), *users[1].getID(), "single");
+    ASSERT_TRUE(db->save(single));
+    ASSERT_EQ(db->saveBatch(batch), batch.size());
+    auto since = db->fetchSinceSeq(*chat.getID(), 2);
+
+    // assert
+    EXPECT_EQ(single.getSeq(), 1);
+    EXPECT_EQ(batch[0].getSeq(), 2);
+    EXPECT_EQ(batch[2].getSeq(), 4);
+    EXPECT_EQ(batch[3].getSeq(), 1);
+    EXPECT_EQ(db->lastSeq(*chat.getID()), 4);
+    EXPECT_EQ(db->lastSeq(*chat.getID() + 100), 0);
+
+    ASSERT_EQ(since.size(), 2u);
+    EXPECT_EQ(since[0].getText(), "batch 1");
+    EXPECT_EQ(since[1].getSeq(), 4);
+    EXPECT_EQ(db->findMessage(*chat.getID(), *single.getID())->getSeq(), 1);
+
+    EXPECT_TRUE(db->isChatMember(*chat.getID(), *users[1].getID()));
+    EXPECT_FALSE(db->isChatMember(*chat.getID(), *users[2].getID()));
+}
+
+TEST_F(DBTest, history_query_uses_covering_index) {
+    // arrange
+    std::string plan;
+
+    // act
+    db->executeWithCallback([&plan] (sqlite3_stmt* stmt) {
+        plan += reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        plan += '\n';
+        return true;
+    }, 
+        "EXPLAIN QUERY PLAN SELECT id, sender_id, text FROM MessagesHistory "
+        "WHERE chat_id = ? AND id < ? ORDER BY id DESC LIMIT ?", 
+        ID_t{1}, ID_t{100}, int64_t{50}
+    );
+
+    // assert
+    EXPECT_NE(plan.find("COVERING INDEX idx_messages_chat_history"), std::string::npos) << plan;
+    EXPECT_EQ(plan.find("TEMP B-TREE"), std::string::npos) << plan;
+}
+
+TEST_F(DBTest, search_messages_in_chat_ranked_with_snippet) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Bob", "password2");
+    users.emplace_back("Carol", "password3");
+    for (User& user : users) {
+        ASSERT_TRUE(db->save(user));
+    }
+
+    std::vector<User> chatMembers{users[0], users[1]};
+    std::vector<User> otherMembers{users[0], users[2]};
+    Chat chat(db, chatMembers, ChatType::Type::PERSONAL);
+    Chat other(db, otherMembers, ChatType::Type::PERSONAL);
+    ASSERT_TRUE(db->save(chat));
+    ASSERT_TRUE(db->save(other));
+
+    Message best(*chat.getID(), *users[0].getID(), "Deploy deploy deploy tonight");
+    ASSERT_TRUE(db->save(Message(*chat.getID(), *users[1].getID(), "did the deploy finish after the long weekend")));
+    ASSERT_TRUE(db->save(best));
+    ASSERT_TRUE(db->save(Message(*chat.getID(), *users[1].getID(), "lunch?")));
+    ASSERT_TRUE(db->save(Message(*other.getID(), *users[2].getID(), "deploy from another chat")));
+
+    // act
+    auto results = db->searchMessages(*chat.getID(), "DEPLOY");
+
+    // assert
+    ASSERT_EQ(results.size(), 2u);
+    EXPECT_EQ(results[0].messageID, *best.getID());
+    EXPECT_EQ(results[0].chatID, *chat.getID());
+    EXPECT_EQ(results[0].senderID, *users[0].getID());
+    EXPECT_EQ(results[0].snippet, "[Deploy] [deploy] [deploy] tonight");
+    EXPECT_LT(results[0].rank, results[1].rank);
+}
+
+TEST_F(DBTest, search_user_messages_only_in_member_chats) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Bob", "password2");
+    users.emplace_back("Carol", "password3");
+    for (User& user : users) {
+        ASSERT_TRUE(db->save(user));
+    }
+
+    std::vector<User> bobMembers{users[0], users[1]};
+    std::vector<User> carolMembers{users[0], users[2]};
+    std::vector<User> strangerMembers{users[1], users[2]};
+    Chat withBob(db, bobMembers, ChatType::Type::PERSONAL);
+    Chat withCarol(db, carolMembers, ChatType::Type::PERSONAL);
+    Chat strangers(db, strangerMembers, ChatType::Type::PERSONAL);
+    ASSERT_TRUE(db->save(withBob));
+    ASSERT_TRUE(db->save(withCarol));
+    ASSERT_TRUE(db->save(strangers));
+
+    ASSERT_TRUE(db->save(Message(*withBob.getID(), *users[1].getID(), "release notes are ready")));
+    ASSERT_TRUE(db->save(Message(*withCarol.getID(), *users[2].getID(), "release is blocked")));
+    ASSERT_TRUE(db->save(Message(*strangers.getID(), *users[1].getID(), "release gossip")));
+    ASSERT_TRUE(db->save(Message(*withBob.getID(), *users[0].getID(), "notes only")));
+
+    // act
+    auto all = db->searchUserMessages(*users[0].getID(), "release");
+    auto both = db->searchUserMessages(*users[0].getID(), "release notes");
+
+    // assert
+    ASSERT_EQ(all.size(), 2u);
+    for (const SearchResult& result : all) {
+        EXPECT_NE(result.chatID, *strangers.getID());
+    }
+    ASSERT_EQ(both.size(), 1u);
+    EXPECT_EQ(both[0].chatID, *withBob.getID());
+}
+
+TEST_F(DBTest, search_index_follows_deleted_messages) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Bob", "password2");
+    for (User& user : users) {
+        ASSERT_TRUE(db->save(user));
+    }
+
+    Chat chat(db, users, ChatType::Type::PERSONAL);
+    ASSERT_TRUE(db->save(chat));
+
+    Message message(*chat.getID(), *users[0].getID(), "secret password");
+    ASSERT_TRUE(db->save(message));
+    ASSERT_EQ(db->searchMessages(*chat.getID(), "secret").size(), 1u);
+
+    // act
+    ASSERT_TRUE(db->deleteMessage(*chat.getID(), *message.getID()));
+
+    // assert
+    EXPECT_TRUE(db->searchMessages(*chat.getID(), "secret").empty());
+    EXPECT_TRUE(db->execute("INSERT INTO MessagesSearch(MessagesSearch) VALUES ('integrity-check')"));
+}
+
+TEST_F(DBTest, search_query_is_not_fts_syntax) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Bob", "password2");
+    for (User& user : users) {
+        ASSERT_TRUE(db->save(user));
+    }
+
+    Chat chat(db, users, ChatType::Type::PERSONAL);
+    ASSERT_TRUE(db->save(chat));
+    ASSERT_TRUE(db->save(Message(*chat.getID(), *users[0].getID(), "cats AND dogs")));
+
+    // act
+    auto quoted = db->searchMessages(*chat.getID(), "\"dogs");
+    auto operators = db->searchMessages(*chat.getID(), "NOT chat:");
+    auto blank = db->searchMessages(*chat.getID(), "   ");
+
+    // assert
+    EXPECT_EQ(quoted.size(), 1u);
+    EXPECT_TRUE(operators.empty());
+    EXPECT_TRUE(blank.empty());
+}
+
 TEST_F(DBTest, find_message_by_id) {
     // arrange
     std::vector<User> users;
@@ -614,4 +974,549 @@ TEST_F(DBTest, delete_chat_from_db) {
     ASSERT_TRUE(del_res);
     EXPECT_EQ(getTableSize("Chat"), 0);
     EXPECT_EQ(getTableSize("User"), 2);
-}
\ No newline at end of file
+}
+
+TEST_F(DBTest, find_personal_chat_by_members) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Bob", "password2");
+    User charlie("Charlie", "password3");
+
+    for (User& user : users) {
+        ASSERT_TRUE(db->save(user));
+    }
+    ASSERT_TRUE(db->save(charlie));
+
+    Chat chat(db, users, ChatType::Type::PERSONAL);
+    db->save(chat);
+
+    // act
+    auto chatID = db->findPersonalChatID(*users[1].getID(), *users[0].getID());
+    auto missingID = db->findPersonalChatID(*users[0].getID(), *charlie.getID());
+
+    // assert
+    ASSERT_TRUE(chatID.has_value());
+    EXPECT_EQ(*chatID, *chat.getID());
+    EXPECT_FALSE(missingID.has_value());
+}
+
+TEST_F(DBTest, query_maps_rows_to_typed_tuples) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Bob", "password2");
+    ASSERT_EQ(db->saveUsers(users), 2u);
+
+    // act
+    auto rows = db->query<ID_t, std::string>("SELECT id, name FROM User ORDER BY id");
+    auto one = db->queryOne<std::string>("SELECT password FROM User WHERE name = ?", std::string_view("Bob"));
+    auto none = db->queryOne<ID_t>("SELECT id FROM User WHERE name = ?", "Carol");
+
+    // assert
+    ASSERT_EQ(rows.size(), 2u);
+    EXPECT_EQ(rows[0], std::make_tuple(*users[0].getID(), std::string("Alice")));
+    EXPECT_EQ(rows[1], std::make_tuple(*users[1].getID(), std::string("Bob")));
+    ASSERT_TRUE(one.has_value());
+    EXPECT_EQ(std::get<0>(*one), "password2");
+    EXPECT_FALSE(none.has_value());
+}
+
+TEST_F(DBTest, for_each_row_passes_views_and_nulls) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Bob", "password2");
+    ASSERT_EQ(db->saveUsers(users), 2u);
+    ASSERT_TRUE(db->save(Chat(db, users, ChatType::Type::PERSONAL)));
+    ASSERT_TRUE(db->save(Chat(db, users, ChatType::Type::GROUP, "team")));
+    std::vector<std::string> seen;
+
+    // act
+    bool res = db->forEachRow<std::optional<std::string_view>, std::string_view>(
+        [&seen] (std::optional<std::string_view> name, std::string_view type) {
+            seen.emplace_back(std::string(name.value_or("-")) + ":" + std::string(type));
+        },
+        "SELECT name, type FROM Chat ORDER BY id"
+    );
+
+    // assert
+    EXPECT_TRUE(res);
+    EXPECT_EQ(seen, (std::vector<std::string>{"-:personal", "team:group"}));
+}
+
+TEST_F(DBTest, query_as_builds_structs) {
+    // arrange
+    ASSERT_TRUE(db->save(User("Alice", "password1")));
+
+    // act
+    auto records = db->queryAs<UserRecord, ID_t, std::string, std::string>(
+        "SELECT id, name, password FROM User"
+    );
+
+    // assert
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].name, "Alice");
+    EXPECT_EQ(records[0].password, "password1");
+}
+
+TEST_F(DBTest, binds_string_view_and_blob) {
+    // arrange
+    ASSERT_TRUE(db->execute("CREATE TABLE Blobs (name TEXT, data BLOB)"));
+    std::string buffer = "name-and-garbage";
+    std::string_view name(buffer.data(), 4);
+    std::vector<std::byte> blob{std::byte{0}, std::byte{1}, std::byte{0xff}};
+
+    // act
+    ASSERT_TRUE(db->execute("INSERT INTO Blobs (name, data) VALUES (?, ?)", name, blob));
+    auto row = db->queryOne<std::string, std::vector<std::byte> >("SELECT name, data FROM Blobs");
+
+    // assert
+    ASSERT_TRUE(row.has_value());
+    EXPECT_EQ(std::get<0>(*row), "name");
+    EXPECT_EQ(std::get<1>(*row), blob);
+}
+
+TEST_F(DBTest, repeated_lookups_hit_entity_cache) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Bob", "password2");
+    users.emplace_back("Carol", "password3");
+    for (User& user : users) {
+        ASSERT_TRUE(db->save(user));
+    }
+    Chat chat(db, users, ChatType::Type::GROUP, "team");
+    ASSERT_TRUE(db->save(chat));
+    auto before = db->entityCacheStats();
+
+    // act
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(db->findChat(*chat.getID()).has_value());
+        ASSERT_TRUE(db->findChat("team").has_value());
+        ASSERT_TRUE(db->findUser("Alice").has_value());
+    }
+    auto after = db->entityCacheStats();
+
+    // assert
+    EXPECT_EQ(after.chats.misses - before.chats.misses, 2u);
+    EXPECT_EQ(after.chats.hits - before.chats.hits, 8u);
+    EXPECT_EQ(after.users.misses - before.users.misses, 3u + 1u); // члены чата при первом findChat и Alice
+    EXPECT_GT(after.users.hitRatio(), 0.5);
+}
+
+TEST_F(DBTest, delete_chat_invalidates_entity_cache) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Alice", "password1");
+    users.emplace_back("Bob", "password2");
+    for (User& user : users) {
+        ASSERT_TRUE(db->save(user));
+    }
+    Chat chat(db, users, ChatType::Type::GROUP, "team");
+    ASSERT_TRUE(db->save(chat));
+    ASSERT_TRUE(db->findChat(*chat.getID()).has_value());
+    ASSERT_TRUE(db->findChat("team").has_value());
+
+    // act
+    ASSERT_TRUE(db->deleteChat(*chat.getID()));
+
+    // assert
+    EXPECT_FALSE(db->findChat(*chat.getID()).has_value());
+    EXPECT_FALSE(db->findChat("team").has_value());
+}
+
+TEST(DBCacheOptionsTest, zero_capacity_disables_entity_cache) {
+    // arrange
+    DBOptions options;
+    options.entityCacheCapacity = 0;
+    auto db = std::make_shared<DB>();
+    db->init(":memory:", std::string(PROJECT_SOURCE_DIR) + "/assets/sql/createDB.sql", options);
+    ASSERT_TRUE(db->save(User("Alice", "password1")));
+
+    // act
+    db->findUser("Alice");
+    db->findUser("Alice");
+
+    // assert
+    EXPECT_EQ(db->entityCacheStats().users.hits, 0u);
+    EXPECT_EQ(db->entityCacheStats().users.misses, 0u);
+}
+
+TEST_F(DBTest, statement_cache_reuses_prepared_statements) {
+    // arrange
+    User user("Alice", "password1");
+    db->save(user);
+    auto before = db->statementCacheStats();
+
+    // act
+    for (int i = 0; i < 10; ++i) {
+        db->findPersonalChatID(*user.getID(), *user.getID() + 1);
+    }
+    auto after = db->statementCacheStats();
+
+    // assert
+    EXPECT_LE(after.misses - before.misses, 1u);
+    EXPECT_GE(after.hits - before.hits, 9u);
+}
+
+TEST_F(DBTest, statement_cache_rebinds_cached_statement) {
+    // arrange
+    db->save(User("Alice", "password1"));
+    db->save(User("Bob", "password2"));
+
+    // act
+    auto alice = db->findUser("Alice");
+    auto bob = db->findUser("Bob");
+    auto nobody = db->findUser("Carol");
+
+    // assert
+    ASSERT_TRUE(alice.has_value());
+    ASSERT_TRUE(bob.has_value());
+    EXPECT_EQ(alice->getPassword(), "password1");
+    EXPECT_EQ(bob->getPassword(), "password2");
+    EXPECT_FALSE(nobody.has_value());
+}
+
+TEST_F(DBTest, statement_cache_evicts_least_recently_used) {
+    // arrange
+    StatementCache cache(2);
+    cache.attach(getRawDB(*db));
+
+    // act
+    cache.acquire("SELECT 1");
+    cache.acquire("SELECT 2");
+    cache.acquire("SELECT 1");
+    cache.acquire("SELECT 3"); // вытесняет SELECT 2
+    cache.acquire("SELECT 1");
+    cache.acquire("SELECT 2");
+
+    // assert
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_EQ(cache.stats().hits, 2u);
+    EXPECT_EQ(cache.stats().misses, 4u);
+    EXPECT_EQ(cache.stats().evictions, 2u);
+}
+
+class DBPoolTest : public ::testing::Test {
+protected:
+    std::shared_ptr<DB> db;
+    std::string path = ::testing::TempDir() + "consolet_pool_test.db";
+
+public:
+    void SetUp() override {
+        removeFiles();
+
+        DBOptions options;
+        options.readers = 2;
+        options.migrations = std::string(PROJECT_SOURCE_DIR) + "/assets/sql/migrations";
+
+        db = std::make_shared<DB>();
+        db->init(path, std::string(PROJECT_SOURCE_DIR) + "/assets/sql/createDB.sql", options);
+    }
+
+    void TearDown() override {
+        db.reset();
+        removeFiles();
+    }
+
+private:
+    void removeFiles() {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    }
+};
+
+TEST_F(DBPoolTest, opens_reader_connections) {
+    EXPECT_EQ(db->readersCount(), 2u);
+}
+
+TEST_F(DBPoolTest, reads_see_committed_writes) {
+    // arrange
+    User user("Alice", "password1");
+
+    // act
+    bool saved = db->save(user);
+    auto found = db->findUser("Alice");
+
+    // assert
+    ASSERT_TRUE(saved);
+    ASSERT_TRUE(found.has_value());
+    EXPECT_EQ(found->getID(), user.getID());
+}
+
+TEST_F(DBPoolTest, parallel_reads_and_writes) {
+    // arrange
+    constexpr int Threads_Count = 4;
+    constexpr int Reads_Count = 50;
+    db->save(User("Alice", "password1"));
+
+    std::atomic<int> found_count{0};
+    std::vector<std::thread> threads;
+
+    // act
+    for (int i = 0; i < Threads_Count; ++i) {
+        threads.emplace_back([this, &found_count] () {
+            for (int j = 0; j < Reads_Count; ++j) {
+                if (db->findUser("Alice")) ++found_count;
+            }
+        });
+    }
+    threads.emplace_back([this] () {
+        for (int j = 0; j < Reads_Count; ++j) {
+            db->save(User("User_" + std::to_string(j), "password"));
+        }
+    });
+
+    for (auto& th : threads) th.join();
+
+    // assert
+    EXPECT_EQ(found_count.load(), Threads_Count * Reads_Count);
+    EXPECT_TRUE(db->findUser("User_" + std::to_string(Reads_Count - 1)).has_value());
+}
+
+TEST_F(DBPoolTest, concurrent_personal_chats_of_a_pair_are_one_chat) {
+    // arrange
+    constexpr int Threads_Count = 8;
+    User alice("Alice", "password1");
+    User bob("Bob", "password2");
+    ASSERT_TRUE(db->save(alice));
+    ASSERT_TRUE(db->save(bob));
+    ID_t aliceID = *alice.getID();
+    ID_t bobID = *bob.getID();
+
+    std::vector<std::optional<ID_t> > chatIDs(Threads_Count);
+    std::vector<std::thread> threads;
+
+    // act
+    /// встречные /msg: половина открывает чат от Alice, половина - от Bob
+    for (int i = 0; i < Threads_Count; ++i) {
+        threads.emplace_back([&, i] () {
+            chatIDs[i] = (i % 2 == 0) 
+                ? db->openPersonalChat(aliceID, bobID) 
+                : db->openPersonalChat(bobID, aliceID);
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    // assert
+    ASSERT_TRUE(chatIDs[0].has_value());
+    for (const auto& chatID : chatIDs) EXPECT_EQ(chatID, chatIDs[0]);
+    auto chats = db->queryOne<int64_t>("SELECT COUNT(*) FROM Chat");
+    ASSERT_TRUE(chats.has_value());
+    EXPECT_EQ(std::get<0>(*chats), 1);
+}
+
+TEST(DBPoolOptionsTest, memory_db_keeps_single_connection) {
+    // arrange
+    DBOptions options;
+    options.readers = 2;
+    DB db;
+
+    // act
+    db.init(":memory:", std::string(PROJECT_SOURCE_DIR) + "/assets/sql/createDB.sql", options);
+
+    // assert
+    EXPECT_EQ(db.readersCount(), 0u);
+}
+
+
+class DBMigrationTest : public ::testing::Test {
+protected:
+    std::string schema = std::string(PROJECT_SOURCE_DIR) + "/assets/sql/createDB.sql";
+    std::string migrations = std::string(PROJECT_SOURCE_DIR) + "/assets/sql/migrations";
+    std::filesystem::path dir = std::filesystem::path(::testing::TempDir()) / "consolet_migrations";
+    std::string path = ::testing::TempDir() + "consolet_migration_test.db";
+
+public:
+    void SetUp() override {
+        cleanup();
+        std::filesystem::create_directories(dir);
+    }
+
+    void TearDown() override {
+        cleanup();
+    }
+
+    void writeMigration(const std::string& name, const std::string& script) {
+        std::ofstream(dir / name) << script;
+    }
+
+    bool tableExists(DB& db, const std::string& name) {
+        bool exists = false;
+        db.executeWithCallback([&exists] (sqlite3_stmt*) {
+            exists = true;
+            return false;
+        }, 
+            "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?", name
+        );
+        return exists;
+    }
+
+private:
+    void cleanup() {
+        std::filesystem::remove_all(dir);
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    }
+};
+
+TEST_F(DBMigrationTest, applies_project_migrations_once) {
+    // arrange
+    DBOptions options;
+    options.migrations = migrations;
+    DB db;
+
+    // act
+    db.init(":memory:", schema, options);
+    size_t again = db.migrate(migrations);
+
+    // assert
+    EXPECT_EQ(db.schemaVersion(), 5);
+    EXPECT_EQ(again, 0u);
+}
+
+TEST_F(DBMigrationTest, numbers_existing_messages_by_id) {
+    // arrange
+    /// MessagesHistory без seq, как до миграции 0003
+    writeMigration("schema.sql", 
+        "CREATE TABLE User (id INTEGER PRIMARY KEY);\n"
+        "CREATE TABLE Chat (id INTEGER PRIMARY KEY);\n"
+        "CREATE TABLE MessagesHistory (id INTEGER PRIMARY KEY AUTOINCREMENT, sender_id INTEGER NOT NULL, "
+        "chat_id INTEGER NOT NULL, date_time TEXT NOT NULL DEFAULT (datetime('now')), text TEXT NOT NULL, "
+        "is_read INTEGER NOT NULL DEFAULT 0);\n"
+        "INSERT INTO User VALUES (1), (2);\n"
+        "INSERT INTO Chat VALUES (1), (2);\n"
+        "INSERT INTO MessagesHistory (id, sender_id, chat_id, text) VALUES "
+        "(5, 1, 1, 'first'), (7, 2, 2, 'other chat'), (9, 2, 1, 'second');\n"
+    );
+    std::filesystem::path only = dir / "migrations";
+    std::filesystem::create_directories(only);
+    std::filesystem::copy_file(
+        std::filesystem::path(migrations) / "0003_message_seq.sql", only / "0003_message_seq.sql"
+    );
+
+    DB db;
+    db.init(":memory:", (dir / "schema.sql").string());
+
+    // act
+    db.migrate(only.string());
+
+    // assert
+    EXPECT_EQ(db.findMessage(1, 9)->getSeq(), 2);
+    EXPECT_EQ(db.findMessage(2, 7)->getSeq(), 1);
+    EXPECT_EQ(db.lastSeq(1), 2);
+    ASSERT_EQ(db.fetchSinceSeq(1, 1).size(), 1u);
+}
+
+TEST_F(DBMigrationTest, counts_unread_of_existing_chats) {
+    // arrange
+    /// чаты и сообщения без UnreadCounters, как до миграции 0005
+    writeMigration("schema.sql", 
+        "CREATE TABLE User (id INTEGER PRIMARY KEY, name TEXT);\n"
+        "CREATE TABLE Chat (id INTEGER PRIMARY KEY, name TEXT, type TEXT NOT NULL);\n"
+        "CREATE TABLE ChatMembers (id INTEGER PRIMARY KEY AUTOINCREMENT, chat_id INTEGER NOT NULL, "
+        "user_id INTEGER NOT NULL);\n"
+        "CREATE TABLE MessagesHistory (id INTEGER PRIMARY KEY AUTOINCREMENT, sender_id INTEGER NOT NULL, "
+        "chat_id INTEGER NOT NULL, text TEXT NOT NULL, is_read INTEGER NOT NULL DEFAULT 0, "
+        "seq INTEGER NOT NULL);\n"
+        "INSERT INTO User VALUES (1, 'alice'), (2, 'bob');\n"
+        "INSERT INTO Chat VALUES (1, NULL, 'personal');\n"
+        "INSERT INTO ChatMembers (chat_id, user_id) VALUES (1, 1), (1, 2);\n"
+        "INSERT INTO MessagesHistory (sender_id, chat_id, text, is_read, seq) VALUES "
+        "(1, 1, 'a', 1, 1), (2, 1, 'b', 0, 2), (1, 1, 'c', 0, 3), (1, 1, 'd', 0, 4);\n"
+    );
+    std::filesystem::path only = dir / "migrations";
+    std::filesystem::create_directories(only);
+    std::filesystem::copy_file(
+        std::filesystem::path(migrations) / "0005_unread_counters.sql", only / "0005_unread_counters.sql"
+    );
+
+    DB db;
+    db.init(":memory:", (dir / "schema.sql").string());
+
+    // act
+    db.migrate(only.string());
+    auto alice = db.listChats(1);
+    auto bob = db.listChats(2);
+
+    // assert
+    ASSERT_EQ(alice.size(), 1u);
+    ASSERT_EQ(bob.size(), 1u);
+    EXPECT_EQ(alice[0].title, "bob");
+    EXPECT_EQ(alice[0].unread, 0);
+    EXPECT_EQ(bob[0].title, "alice");
+    EXPECT_EQ(bob[0].unread, 2);
+    EXPECT_EQ(bob[0].lastSeq, 4);
+}
+
+TEST_F(DBMigrationTest, membership_lookup_uses_indexes) {
+    // arrange
+    DBOptions options;
+    options.migrations = migrations;
+    DB db;
+    db.init(":memory:", schema, options);
+    std::string plan;
+
+    // act
+    db.executeWithCallback([&plan] (sqlite3_stmt* stmt) {
+        plan += reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        plan += '\n';
+        return true;
+    }, 
+        "EXPLAIN QUERY PLAN SELECT c.id FROM Chat c "
+        "JOIN ChatMembers first ON first.chat_id = c.id AND first.user_id = ? "
+        "JOIN ChatMembers second ON second.chat_id = c.id AND second.user_id = ? "
+        "WHERE c.type = 'personal' LIMIT 1", 
+        ID_t{1}, ID_t{2}
+    );
+
+    // assert
+    EXPECT_NE(plan.find("idx_chat_members_user"), std::string::npos) << plan;
+    EXPECT_EQ(plan.find("SCAN first"), std::string::npos) << plan;
+    EXPECT_EQ(plan.find("SCAN second"), std::string::npos) << plan;
+}
+
+TEST_F(DBMigrationTest, failed_migration_is_rolled_back) {
+    // arrange
+    writeMigration("0001_first.sql", "CREATE TABLE First (id INTEGER PRIMARY KEY);");
+    writeMigration("0002_broken.sql", 
+        "CREATE TABLE Second (id INTEGER PRIMARY KEY);\n"
+        "INSERT INTO Missing VALUES (1);"
+    );
+    writeMigration("README.md", "not a migration");
+
+    DB db;
+    db.init(":memory:", schema);
+
+    // act
+    EXPECT_THROW(db.migrate(dir.string()), std::runtime_error);
+
+    // assert
+    EXPECT_EQ(db.schemaVersion(), 1);
+    EXPECT_TRUE(tableExists(db, "First"));
+    EXPECT_FALSE(tableExists(db, "Second"));
+}
+
+TEST_F(DBMigrationTest, reopened_database_keeps_version) {
+    // arrange
+    writeMigration("0001_topic.sql", "ALTER TABLE Chat ADD COLUMN topic TEXT;");
+    DBOptions options;
+    options.migrations = dir.string();
+    {
+        DB db;
+        db.init(path, schema, options);
+        ASSERT_EQ(db.schemaVersion(), 1);
+    }
+    writeMigration("0002_topic_index.sql", "CREATE INDEX idx_chat_topic ON Chat(topic);");
+
+    // act
+    DB db;
+    db.init(path, schema, options);
+
+    // assert
+    EXPECT_EQ(db.schemaVersion(), 2);
+    EXPECT_TRUE(db.execute("UPDATE Chat SET topic = 'news' WHERE id = 1"));
+}
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include "db/db.hpp"
+#include "db/async_db.hpp"
+#include "db/delivery_queue.hpp"
+#include "usr/user.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class DeliveryQueueTest : public ::testing::Test {
+protected:
+    std::shared_ptr<DB> db;
+    std::unique_ptr<AsyncDB> async_db;
+    ID_t aliceID = 0;
+    ID_t bobID = 0;
+
+public:
+    void SetUp() override {
+        db = std::make_shared<DB>();
+        DBOptions options;
+        options.migrations = std::string(PROJECT_SOURCE_DIR) + "/assets/sql/migrations";
+        db->init(
+            ":memory:", 
+            std::string(PROJECT_SOURCE_DIR) + "/assets/sql/createDB.sql",
+            options
+        );
+        async_db = std::make_unique<AsyncDB>(db, 2);
+
+        User alice("Alice", "password1");
+        User bob("Bob", "password2");
+        db->save(alice);
+        db->save(bob);
+        aliceID = *alice.getID();
+        bobID = *bob.getID();
+    }
+
+    void TearDown() override {
+        async_db.reset();
+        db.reset();
+    }
+
+    PendingDelivery delivery(ID_t userID, ID_t chatID, int64_t seq) {
+        /// кадр может содержать нули - хранится как BLOB
+        std::string frame("frame\0", 6);
+        frame += std::to_string(chatID) + ":" + std::to_string(seq);
+        return PendingDelivery{0, userID, chatID, seq, frame};
+    }
+};
+
+TEST_F(DeliveryQueueTest, fetches_deliveries_of_the_user_in_queue_order) {
+    // arrange
+    std::vector<PendingDelivery> deliveries;
+    for (int64_t seq = 1; seq <= 5; ++seq) deliveries.push_back(delivery(aliceID, 1, seq));
+    deliveries.push_back(delivery(bobID, 1, 1));
+
+    // act
+    size_t queued = db->queueDeliveries(deliveries);
+    auto first = db->fetchDeliveries(aliceID, 0, 3);
+    auto second = db->fetchDeliveries(aliceID, first.back().id, 3);
+
+    // assert
+    EXPECT_EQ(queued, deliveries.size());
+    ASSERT_EQ(first.size(), 3u);
+    ASSERT_EQ(second.size(), 2u);
+    EXPECT_EQ(first[0].frame, deliveries[0].frame);
+    EXPECT_EQ(first[0].frame.size(), deliveries[0].frame.size());
+    EXPECT_EQ(second[1].seq, 5);
+    EXPECT_EQ(db->countDeliveries(bobID), 1u);
+}
+
+TEST_F(DeliveryQueueTest, ack_clears_the_chat_up_to_seq_and_sent_ones) {
+    // arrange
+    std::vector<PendingDelivery> deliveries{
+        delivery(aliceID, 1, 1), delivery(aliceID, 1, 2), delivery(aliceID, 1, 3),
+        delivery(aliceID, 2, 1), delivery(bobID, 1, 1), delivery(aliceID, 0, 0)
+    };
+    db->queueDeliveries(deliveries);
+
+    std::vector<DeliveryAck> acks{DeliveryAck{aliceID, 1, 2}};
+    std::vector<ID_t> sent{deliveries[5].id, deliveries[3].id};
+
+    // act
+    size_t removed = db->clearDeliveries(acks, sent);
+
+    // assert
+    EXPECT_EQ(removed, 3u);
+    auto left = db->fetchDeliveries(aliceID);
+    ASSERT_EQ(left.size(), 2u);
+    EXPECT_EQ(left[0].seq, 3);
+    EXPECT_EQ(left[1].chatID, 2);
+    EXPECT_EQ(db->countDeliveries(bobID), 1u);
+}
+
+TEST_F(DeliveryQueueTest, buffered_writes_and_acks_reach_the_db) {
+    // arrange
+    auto queue = std::make_unique<DeliveryQueue>(*async_db);
+    for (int64_t seq = 1; seq <= 100; ++seq) queue->push(delivery(aliceID, 1, seq));
+    queue->push(delivery(aliceID, 0, 0));
+
+    // act
+    for (int64_t seq = 1; seq <= 60; ++seq) queue->ack(aliceID, 1, seq);
+    async_db->submit([&] (DB& db) { queue->flush(db); }).get();
+    auto left = db->fetchDeliveries(aliceID);
+
+    queue->sent(left.back().id);
+    queue->ack(aliceID, 1, 90);
+    queue.reset();
+
+    // assert
+    ASSERT_EQ(left.size(), 41u);
+    EXPECT_EQ(left.front().seq, 61);
+    EXPECT_EQ(db->countDeliveries(aliceID), 10u);
+}
+
+TEST_F(DeliveryQueueTest, flush_waits_for_the_timer_and_takes_the_whole_burst) {
+    // arrange
+    std::vector<std::function<void()> > timers;
+    auto queue = std::make_unique<DeliveryQueue>(*async_db, std::chrono::milliseconds(20), 
+        [&timers] (std::chrono::milliseconds, std::function<void()> callback) {
+            timers.push_back(std::move(callback));
+        }
+    );
+
+    // act
+    for (int64_t seq = 1; seq <= 50; ++seq) queue->push(delivery(aliceID, 1, seq));
+    queue->ack(aliceID, 1, 10);
+    size_t beforeTimer = db->countDeliveries(aliceID);
+
+    timers.front()();
+    for (int attempt = 0; attempt < 100 && db->countDeliveries(aliceID) != 40u; ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // assert
+    EXPECT_EQ(timers.size(), 1u);
+    EXPECT_EQ(beforeTimer, 0u);
+    EXPECT_EQ(db->countDeliveries(aliceID), 40u);
+}
+
+TEST_F(DeliveryQueueTest, drain_query_uses_the_user_index) {
+    // arrange
+    std::string plan;
+
+    // act
+    db->executeWithCallback([&plan] (sqlite3_stmt* stmt) {
+        plan += reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        plan += '\n';
+        return true;
+    }, 
+        "EXPLAIN QUERY PLAN SELECT id, chat_id, seq, frame FROM PendingDeliveries "
+        "WHERE user_id = ? AND id > ? ORDER BY id ASC LIMIT ?", 
+        ID_t{1}, ID_t{0}, int64_t{100}
+    );
+
+    // assert
+    EXPECT_NE(plan.find("idx_pending_deliveries_user"), std::string::npos) << plan;
+    EXPECT_EQ(plan.find("TEMP B-TREE"), std::string::npos) << plan;
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <set>
+#include <thread>
+
+#include "exec/executor.hpp"
+
+
+TEST(ExecutorTest, runs_all_submitted_tasks) {
+    // arrange
+    std::atomic<int> counter{0};
+
+    // act
+    {
+        Executor executor(4);
+        for (int i = 0; i < 1000; ++i) {
+            executor.submit([&counter] () { counter.fetch_add(1); });
+        }
+        executor.stop();
+    }
+
+    // assert
+    EXPECT_EQ(counter.load(), 1000);
+}
+
+TEST(ExecutorTest, nested_submit_runs_before_stop_returns) {
+    // arrange
+    Executor executor(2);
+    std::atomic<int> counter{0};
+
+    // act
+    executor.submit([&executor, &counter] () {
+        for (int i = 0; i < 10; ++i) {
+            executor.submit([&counter] () { counter.fetch_add(1); });
+        }
+    });
+    
+    // дожидаемся, пока внешняя задача выставит вложенные
+    while (counter.load() < 10) std::this_thread::yield();
+    executor.stop();
+
+    // assert
+    EXPECT_EQ(counter.load(), 10);
+    EXPECT_EQ(executor.pendingTasks(), 0);
+}
+
+TEST(ExecutorTest, idle_worker_steals_from_blocked_one) {
+    // arrange
+    Executor executor(2);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::promise<void> done;
+
+    // act
+    // обе задачи из потока пула попадают в одну очередь
+    executor.submit([&executor, released, &done] () {
+        executor.submit([&done] () { done.set_value(); });
+        released.wait();
+    });
+    auto status = done.get_future().wait_for(std::chrono::seconds(5));
+    release.set_value();
+
+    // assert
+    EXPECT_EQ(status, std::future_status::ready);
+}
+
+TEST(ExecutorTest, spreads_tasks_between_workers) {
+    // arrange
+    Executor executor(4);
+    std::mutex mtx;
+    std::set<std::thread::id> ids;
+    std::atomic<int> started{0};
+
+    // act
+    for (size_t i = 0; i < executor.size(); ++i) {
+        executor.submit([&] () {
+            {
+                std::scoped_lock lock(mtx);
+                ids.insert(std::this_thread::get_id());
+            }
+            started.fetch_add(1);
+            /// держим поток, пока не стартуют все задачи
+            while (started.load() < 4) std::this_thread::yield();
+        });
+    }
+    executor.stop();
+
+    // assert
+    EXPECT_EQ(ids.size(), 4u);
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include "message/frame.hpp"
+#include "message/frame_parser.hpp"
+
+#include <cstring>
+#include <string>
+
+static void feed(FrameParser& parser, const std::string& bytes) {
+    auto span = parser.prepare(bytes.size());
+    std::memcpy(span.data(), bytes.data(), bytes.size());
+    parser.commit(bytes.size());
+}
+
+TEST(FrameTest, header_roundtrip) {
+    FrameHeader header;
+    header.length = 5;
+    header.type = FrameType::MESSAGE;
+    header.chatID = 42;
+    header.senderID = 7;
+    header.seq = 1ull << 40;
+
+    char buf[FRAME_HEADER_SIZE];
+    encodeHeader(header, buf);
+    FrameHeader decoded = decodeHeader(buf);
+
+    EXPECT_EQ(decoded.length, header.length);
+    EXPECT_EQ(decoded.type, header.type);
+    EXPECT_EQ(decoded.chatID, header.chatID);
+    EXPECT_EQ(decoded.senderID, header.senderID);
+    EXPECT_EQ(decoded.seq, header.seq);
+}
+
+TEST(FrameTest, parse_frame_split_across_reads) {
+    FrameParser parser;
+    std::string bytes = encodeFrame(FrameType::MESSAGE, "Hello from Alice!", 1, 2, 3);
+
+    feed(parser, bytes.substr(0, 10));
+    EXPECT_FALSE(parser.next());
+
+    feed(parser, bytes.substr(10, 30));
+    EXPECT_FALSE(parser.next());
+
+    feed(parser, bytes.substr(40));
+    auto frame = parser.next();
+
+    ASSERT_TRUE(frame);
+    EXPECT_EQ(frame->header.type, FrameType::MESSAGE);
+    EXPECT_EQ(frame->header.chatID, 1);
+    EXPECT_EQ(frame->header.senderID, 2);
+    EXPECT_EQ(frame->header.seq, 3u);
+    EXPECT_EQ(frame->payload, "Hello from Alice!");
+    EXPECT_FALSE(parser.next());
+}
+
+TEST(FrameTest, parse_coalesced_frames) {
+    FrameParser parser;
+    feed(parser, 
+        encodeFrame(FrameType::MESSAGE, "first") + 
+        encodeFrame(FrameType::MESSAGE, "") + 
+        encodeFrame(FrameType::MESSAGE, "third")
+    );
+
+    auto first = parser.next();
+    auto second = parser.next();
+    auto third = parser.next();
+
+    ASSERT_TRUE(first && second && third);
+    EXPECT_EQ(first->payload, "first");
+    EXPECT_EQ(second->payload, "");
+    EXPECT_EQ(third->payload, "third");
+    EXPECT_FALSE(parser.next());
+}
+
+TEST(FrameTest, parse_frame_larger_than_buffer) {
+    FrameParser parser(64);
+    std::string text(100000, 'x');
+    std::string bytes = encodeFrame(FrameType::MESSAGE, text);
+
+    for (size_t i = 0; i < bytes.size(); i += 4096) {
+        feed(parser, bytes.substr(i, 4096));
+    }
+    auto frame = parser.next();
+
+    ASSERT_TRUE(frame);
+    EXPECT_EQ(frame->payload, text);
+}
+
+TEST(FrameTest, payload_is_view_into_buffer) {
+    FrameParser parser;
+    feed(parser, encodeFrame(FrameType::MESSAGE, "view"));
+
+    auto span = parser.prepare(0);
+    auto frame = parser.next();
+
+    ASSERT_TRUE(frame);
+    EXPECT_LT(frame->payload.data(), span.data());
+}
+
+TEST(FrameTest, too_long_frame_is_error) {
+    FrameParser parser(4096, 16);
+    feed(parser, encodeFrame(FrameType::MESSAGE, std::string(17, 'x')));
+
+    EXPECT_FALSE(parser.next());
+    EXPECT_TRUE(parser.hasError());
+}
+
+TEST(FrameTest, delta_entries_roundtrip) {
+    std::string payload;
+    appendDeltaEntry(payload, 41, 7, "hello");
+    appendDeltaEntry(payload, 42, 8, "");
+    appendDeltaEntry(payload, 1ull << 40, 9, std::string("with\0zero", 9));
+
+    FrameParser parser;
+    feed(parser, encodeFrame(FrameType::DELTA, payload, 3, 0, 1ull << 40, DELTA_TRUNCATED));
+    auto frame = parser.next();
+
+    ASSERT_TRUE(frame);
+    EXPECT_EQ(frame->header.type, FrameType::DELTA);
+    EXPECT_EQ(frame->header.flags, DELTA_TRUNCATED);
+
+    std::vector<DeltaEntry> entries;
+    ASSERT_TRUE(decodeDelta(frame->payload, entries));
+    ASSERT_EQ(entries.size(), 3u);
+    EXPECT_EQ(entries[0].seq, 41u);
+    EXPECT_EQ(entries[0].senderID, 7);
+    EXPECT_EQ(entries[0].text, "hello");
+    EXPECT_TRUE(entries[1].text.empty());
+    EXPECT_EQ(entries[2].seq, 1ull << 40);
+    EXPECT_EQ(entries[2].text, std::string_view("with\0zero", 9));
+}
+
+TEST(FrameTest, truncated_delta_is_error) {
+    std::string payload;
+    appendDeltaEntry(payload, 1, 2, "cut here");
+    payload.pop_back();
+
+    std::vector<DeltaEntry> entries;
+    EXPECT_FALSE(decodeDelta(payload, entries));
+    EXPECT_FALSE(decodeDelta(std::string_view(payload).substr(0, 10), entries));
+}
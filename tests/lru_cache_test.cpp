@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db/lru_cache.hpp"
+
+
+TEST(LRUCacheTest, evicts_least_recently_used) {
+    // arrange
+    ShardedLRUCache<int, std::string> cache(2, 1);
+    cache.put(1, "one", cache.epoch());
+    cache.put(2, "two", cache.epoch());
+
+    // act
+    cache.get(1);
+    cache.put(3, "three", cache.epoch());
+
+    // assert
+    EXPECT_EQ(cache.get(1), "one");
+    EXPECT_FALSE(cache.get(2).has_value());
+    EXPECT_EQ(cache.get(3), "three");
+    EXPECT_EQ(cache.stats().evictions, 1u);
+}
+
+TEST(LRUCacheTest, counts_hit_ratio) {
+    // arrange
+    ShardedLRUCache<int, int> cache(16);
+    cache.put(1, 10, cache.epoch());
+
+    // act
+    cache.get(1);
+    cache.get(1);
+    cache.get(1);
+    cache.get(2);
+
+    // assert
+    CacheStats stats = cache.stats();
+    EXPECT_EQ(stats.hits, 3u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_DOUBLE_EQ(stats.hitRatio(), 0.75);
+}
+
+TEST(LRUCacheTest, put_loaded_before_erase_is_ignored) {
+    // arrange
+    ShardedLRUCache<int, std::string> cache(16);
+    uint64_t epoch = cache.epoch(); // промах, значение читается из БД
+
+    // act
+    cache.erase(1);                 // тем временем запись изменили
+    cache.put(1, "stale", epoch);
+
+    // assert
+    EXPECT_FALSE(cache.get(1).has_value());
+}
+
+TEST(LRUCacheTest, concurrent_access_stays_bounded) {
+    // arrange
+    ShardedLRUCache<int, int> cache(64, 4);
+    std::vector<std::thread> threads;
+    std::atomic<int> wrong{0};
+
+    // act
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&cache, &wrong, t] () {
+            for (int i = 0; i < 10000; ++i) {
+                int key = (i * 7 + t) % 256;
+                if (auto value = cache.get(key)) {
+                    if (*value != key * 2) wrong.fetch_add(1);
+                }
+                else {
+                    cache.put(key, key * 2, cache.epoch());
+                }
+                if (i % 100 == 0) cache.erase(key);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // assert
+    EXPECT_EQ(wrong.load(), 0);
+    EXPECT_LE(cache.size(), cache.capacity());
+}
@@ -0,0 +1,251 @@
+#include <gtest/gtest.h>
+
+#include "db/db.hpp"
+#include "db/message_persister.hpp"
+#include "chat/chat.hpp"
+#include "usr/user.hpp"
+#include "message/message.hpp"
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <vector>
+
+class MessagePersisterTest : public ::testing::Test {
+protected:
+    std::shared_ptr<DB> db;
+    ID_t chatID = 0;
+    ID_t senderID = 0;
+
+public:
+    void SetUp() override {
+        db = std::make_shared<DB>();
+        DBOptions options;
+        options.migrations = std::string(PROJECT_SOURCE_DIR) + "/assets/sql/migrations";
+        db->init(
+            ":memory:", 
+            std::string(PROJECT_SOURCE_DIR) + "/assets/sql/createDB.sql",
+            options
+        );
+
+        std::vector<User> users;
+        users.emplace_back("Alice", "password1");
+        users.emplace_back("Bob", "password2");
+        for (User& user : users) db->save(user);
+
+        Chat chat(db, users, ChatType::Type::PERSONAL);
+        db->save(chat);
+
+        chatID = *chat.getID();
+        senderID = *users[0].getID();
+    }
+
+    void TearDown() override {
+        db.reset();
+    }
+};
+
+TEST_F(MessagePersisterTest, commits_messages_in_batches) {
+    // arrange
+    constexpr int Messages_Count = 100;
+    PersisterOptions options;
+    options.batchSize = 32;
+    options.flushInterval = std::chrono::milliseconds(50);
+
+    MessagePersister persister(db, options);
+    std::vector<std::future<std::optional<ID_t> > > results;
+
+    // act
+    for (int i = 0; i < Messages_Count; ++i) {
+        results.push_back(persister.persist(Message(chatID, senderID, "msg " + std::to_string(i))));
+    }
+
+    // assert
+    std::optional<ID_t> previous;
+    for (auto& result : results) {
+        auto id = result.get();
+        ASSERT_TRUE(id.has_value());
+        if (previous) {
+            EXPECT_GT(*id, *previous);
+        }
+        previous = id;
+    }
+
+    auto stats = persister.stats();
+    EXPECT_EQ(stats.saved, static_cast<uint64_t>(Messages_Count));
+    EXPECT_LT(stats.batches, static_cast<uint64_t>(Messages_Count));
+}
+
+TEST_F(MessagePersisterTest, fails_only_message_of_missing_chat) {
+    // arrange
+    MessagePersister persister(db);
+
+    // act
+    auto good = persister.persist(Message(chatID, senderID, "hello"));
+    auto bad = persister.persist(Message(chatID + 100, senderID, "nowhere"));
+
+    // assert
+    EXPECT_TRUE(good.get().has_value());
+    EXPECT_FALSE(bad.get().has_value());
+    EXPECT_EQ(persister.stats().failed, 1u);
+}
+
+TEST_F(MessagePersisterTest, flush_waits_for_commit) {
+    // arrange
+    PersisterOptions options;
+    options.flushInterval = std::chrono::seconds(10);
+    MessagePersister persister(db, options);
+
+    // act
+    auto result = persister.persist(Message(chatID, senderID, "hello"));
+    persister.flush();
+
+    // assert
+    EXPECT_EQ(result.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_TRUE(db->findMessage(chatID, "hello").has_value());
+}
+
+TEST_F(MessagePersisterTest, stop_commits_queued_messages) {
+    // arrange
+    PersisterOptions options;
+    options.flushInterval = std::chrono::seconds(10);
+    auto persister = std::make_unique<MessagePersister>(db, options);
+
+    // act
+    auto result = persister->persist(Message(chatID, senderID, "last words"));
+    persister.reset();
+
+    // assert
+    EXPECT_TRUE(result.get().has_value());
+}
+
+TEST_F(MessagePersisterTest, enqueue_gives_generator_ids_before_commit) {
+    // arrange
+    PersisterOptions options;
+    options.flushInterval = std::chrono::seconds(10);
+    options.ids = std::make_shared<SnowflakeGenerator>(7);
+    MessagePersister persister(db, options);
+
+    std::vector<std::optional<ID_t> > saved(3);
+    ASSERT_TRUE(persister.loadChat(chatID));
+    ASSERT_TRUE(persister.loadChat(chatID + 100));
+
+    // act
+    std::vector<Message> messages;
+    for (size_t i = 0; i < saved.size(); ++i) {
+        messages.emplace_back(chatID, senderID, "early " + std::to_string(i));
+        persister.enqueue(messages.back(), [&saved, i] (const Message& message) { saved[i] = message.getID(); });
+    }
+    Message bad(chatID + 100, senderID, "nowhere");
+    auto queued = persister.enqueue(bad, [&] (const Message& message) {
+        EXPECT_FALSE(message.getID().has_value());
+    });
+    persister.flush();
+
+    // assert
+    ASSERT_EQ(queued, MessagePersister::Enqueued::QUEUED);
+    ASSERT_TRUE(bad.getID().has_value());
+    for (size_t i = 0; i < messages.size(); ++i) {
+        auto id = messages[i].getID();
+        ASSERT_TRUE(id.has_value());
+        EXPECT_EQ(SnowflakeGenerator::nodeOf(*id), 7);
+        EXPECT_EQ(saved[i], id);
+        EXPECT_EQ(messages[i].getSeq(), static_cast<int64_t>(i + 1));
+        if (i > 0) {
+            EXPECT_GT(*id, *messages[i - 1].getID());
+        }
+
+        auto message = db->findMessage(chatID, *id);
+        ASSERT_TRUE(message.has_value());
+        EXPECT_EQ(message->getText(), "early " + std::to_string(i));
+        EXPECT_EQ(message->getSeq(), messages[i].getSeq());
+    }
+    EXPECT_FALSE(db->findMessage(chatID + 100, *bad.getID()).has_value());
+}
+
+TEST_F(MessagePersisterTest, continues_chat_seq_of_the_store) {
+    // arrange
+    Message earlier(chatID, senderID, "before the restart");
+    db->save(earlier);
+    MessagePersister persister(db);
+
+    // act
+    auto first = persister.persist(Message(chatID, senderID, "first"));
+    auto second = persister.persist(Message(chatID, senderID, "second"));
+    auto firstID = first.get();
+    auto secondID = second.get();
+
+    // assert
+    EXPECT_EQ(earlier.getSeq(), 1);
+    ASSERT_TRUE(firstID.has_value());
+    ASSERT_TRUE(secondID.has_value());
+    EXPECT_EQ(db->findMessage(chatID, *firstID)->getSeq(), 2);
+    EXPECT_EQ(db->findMessage(chatID, *secondID)->getSeq(), 3);
+    EXPECT_EQ(db->lastSeq(chatID), 3);
+}
+
+TEST_F(MessagePersisterTest, enqueue_does_not_read_the_store_of_an_unknown_chat) {
+    // arrange
+    Message earlier(chatID, senderID, "before the restart");
+    db->save(earlier);
+
+    PersisterOptions options;
+    options.ids = std::make_shared<SnowflakeGenerator>(1);
+    MessagePersister persister(db, options);
+
+    bool called = false;
+    Message message(chatID, senderID, "after the restart");
+
+    // act
+    auto unknown = persister.enqueue(message, [&] (const Message&) { called = true; });
+    bool loaded = persister.loadChat(chatID);
+    auto queued = persister.enqueue(message, [&] (const Message&) { called = true; });
+    persister.flush();
+
+    // assert
+    EXPECT_EQ(unknown, MessagePersister::Enqueued::UNKNOWN_CHAT);
+    EXPECT_TRUE(loaded);
+    EXPECT_EQ(queued, MessagePersister::Enqueued::QUEUED);
+    EXPECT_TRUE(called);
+    EXPECT_EQ(message.getSeq(), 2);
+    EXPECT_EQ(db->lastSeq(chatID), 2);
+}
+
+TEST_F(MessagePersisterTest, forgets_saved_chats_over_capacity) {
+    // arrange
+    std::vector<User> users;
+    users.emplace_back("Carol", "password3");
+    users.emplace_back("Dave", "password4");
+    for (User& user : users) db->save(user);
+    Chat chat(db, users, ChatType::Type::PERSONAL);
+    db->save(chat);
+    ID_t otherID = *chat.getID();
+
+    PersisterOptions options;
+    options.chatCapacity = 1;
+    options.ids = std::make_shared<SnowflakeGenerator>(1);
+    MessagePersister persister(db, options);
+
+    Message first(chatID, senderID, "first");
+    Message other(otherID, *users[0].getID(), "other");
+    Message second(chatID, senderID, "second");
+
+    // act
+    persister.loadChat(chatID);
+    persister.enqueue(first, {});
+    persister.flush();
+
+    persister.loadChat(otherID);
+    persister.enqueue(other, {});
+    auto forgotten = persister.enqueue(second, {});
+    persister.loadChat(chatID);
+    persister.enqueue(second, {});
+    persister.flush();
+
+    // assert
+    EXPECT_EQ(forgotten, MessagePersister::Enqueued::UNKNOWN_CHAT);
+    EXPECT_EQ(first.getSeq(), 1);
+    EXPECT_EQ(other.getSeq(), 1);
+    EXPECT_EQ(second.getSeq(), 2);
+    EXPECT_EQ(db->lastSeq(chatID), 2);
+}
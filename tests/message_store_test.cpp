@@ -0,0 +1,340 @@
+#include <gtest/gtest.h>
+
+#include "db/message_store.hpp"
+#include "db/segmented_log_store.hpp"
+#include "db/message_persister.hpp"
+#include "message/message.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+class SegmentedLogStoreTest : public ::testing::Test {
+protected:
+    std::filesystem::path dir = std::filesystem::path(::testing::TempDir()) / "consolet_message_log";
+    std::unique_ptr<SegmentedLogStore> store;
+
+public:
+    void SetUp() override {
+        std::filesystem::remove_all(dir);
+        reopen();
+    }
+
+    void TearDown() override {
+        store.reset();
+        std::filesystem::remove_all(dir);
+    }
+
+    void reopen(LogStoreOptions options = {}) {
+        store.reset();
+        store = std::make_unique<SegmentedLogStore>(dir, options);
+    }
+
+    std::vector<ID_t> saveMessages(ID_t chatID, int count) {
+        std::vector<Message> messages;
+        for (int i = 0; i < count; ++i) {
+            messages.emplace_back(chatID, 1, "message " + std::to_string(i));
+        }
+        store->saveBatch(messages);
+
+        std::vector<ID_t> ids;
+        for (const Message& message : messages) ids.push_back(*message.getID());
+        return ids;
+    }
+
+    /// открытые процессом сегменты лога
+    size_t openSegments() {
+        size_t count = 0;
+        for (const auto& entry : std::filesystem::directory_iterator("/proc/self/fd")) {
+            std::error_code error;
+            auto target = std::filesystem::read_symlink(entry.path(), error);
+            if (!error && target.extension() == ".log" && target.string().starts_with(dir.string())) ++count;
+        }
+        return count;
+    }
+};
+
+TEST_F(SegmentedLogStoreTest, saves_and_finds_messages) {
+    // arrange
+    std::vector<Message> messages{
+        Message(1, 10, "hello"),
+        Message(2, 20, "other chat"),
+        Message(1, 11, "world")
+    };
+
+    // act
+    size_t saved = store->saveBatch(messages);
+
+    // assert
+    EXPECT_EQ(saved, 3u);
+    for (const Message& message : messages) {
+        ASSERT_TRUE(message.isSavedToDB());
+        auto found = store->findMessage(message.getChatID(), *message.getID());
+        ASSERT_TRUE(found.has_value());
+        EXPECT_EQ(*found, message);
+    }
+    EXPECT_LT(*messages[0].getID(), *messages[2].getID());
+    EXPECT_FALSE(store->findMessage(2, *messages[0].getID()).has_value());
+}
+
+TEST_F(SegmentedLogStoreTest, pages_history_newest_first) {
+    // arrange
+    LogStoreOptions options;
+    options.indexInterval = 4;
+    reopen(options);
+    auto ids = saveMessages(1, 130);
+
+    // act
+    auto first = store->fetchHistory(1, std::numeric_limits<ID_t>::max(), 50);
+    auto second = store->fetchHistory(1, *first.back().getID(), 50);
+    auto since = store->fetchSince(1, ids[9], 5);
+
+    // assert
+    ASSERT_EQ(first.size(), 50u);
+    EXPECT_EQ(*first.front().getID(), ids[129]);
+    EXPECT_EQ(*first.back().getID(), ids[80]);
+    ASSERT_EQ(second.size(), 50u);
+    EXPECT_EQ(*second.front().getID(), ids[79]);
+    EXPECT_EQ(second.front().getText(), "message 79");
+
+    ASSERT_EQ(since.size(), 5u);
+    EXPECT_EQ(*since.front().getID(), ids[10]);
+    EXPECT_EQ(*since.back().getID(), ids[14]);
+}
+
+TEST_F(SegmentedLogStoreTest, rolls_segments_and_reads_sealed_ones) {
+    // arrange
+    LogStoreOptions options;
+    options.segmentBytes = 1024;
+    options.indexInterval = 3;
+    reopen(options);
+    auto ids = saveMessages(1, 200);
+    store.reset();
+
+    /// без .idx сегмент сканируется заново
+    for (const auto& entry : std::filesystem::directory_iterator(dir / "1")) {
+        if (entry.path().extension() == ".idx") {
+            std::filesystem::remove(entry.path());
+            break;
+        }
+    }
+
+    // act
+    reopen(options);
+    auto history = store->fetchHistory(1, std::numeric_limits<ID_t>::max(), 200);
+    auto since = store->fetchSince(1, 0, 200);
+    auto more = saveMessages(1, 1);
+
+    // assert
+    EXPECT_GT(store->segmentCount(1), 5u);
+    ASSERT_EQ(history.size(), 200u);
+    ASSERT_EQ(since.size(), 200u);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        EXPECT_EQ(*history[ids.size() - 1 - i].getID(), ids[i]);
+        EXPECT_EQ(*since[i].getID(), ids[i]);
+    }
+    EXPECT_GT(more[0], ids.back());
+}
+
+TEST_F(SegmentedLogStoreTest, deleted_messages_stay_deleted_after_reopen) {
+    // arrange
+    auto ids = saveMessages(1, 3);
+
+    // act
+    bool deleted = store->deleteMessage(1, ids[1]);
+    bool again = store->deleteMessage(1, ids[1]);
+    reopen();
+
+    // assert
+    EXPECT_TRUE(deleted);
+    EXPECT_FALSE(again);
+    EXPECT_FALSE(store->findMessage(1, ids[1]).has_value());
+    auto history = store->fetchHistory(1, std::numeric_limits<ID_t>::max(), 10);
+    ASSERT_EQ(history.size(), 2u);
+    EXPECT_EQ(*history[0].getID(), ids[2]);
+    EXPECT_EQ(*history[1].getID(), ids[0]);
+}
+
+TEST_F(SegmentedLogStoreTest, torn_tail_is_cut_on_open) {
+    // arrange
+    auto ids = saveMessages(7, 2);
+    store.reset();
+
+    auto segment = std::filesystem::directory_iterator(dir / "7")->path();
+    std::ofstream(segment, std::ios::binary | std::ios::app) << "half of a record";
+
+    // act
+    reopen();
+    auto next = saveMessages(7, 1);
+
+    // assert
+    auto history = store->fetchHistory(7, std::numeric_limits<ID_t>::max(), 10);
+    ASSERT_EQ(history.size(), 3u);
+    EXPECT_EQ(*history[0].getID(), next[0]);
+    EXPECT_EQ(*history[2].getID(), ids[0]);
+}
+
+TEST_F(SegmentedLogStoreTest, persister_writes_through_the_log) {
+    // arrange
+    auto log = std::make_shared<SegmentedLogStore>(dir / "persister");
+    MessagePersister persister(log);
+
+    // act
+    auto id = persister.persist(Message(3, 1, "through the persister")).get();
+
+    // assert
+    ASSERT_TRUE(id.has_value());
+    auto found = log->findMessage(3, *id);
+    ASSERT_TRUE(found.has_value());
+    EXPECT_EQ(found->getText(), "through the persister");
+}
+
+TEST_F(SegmentedLogStoreTest, keeps_given_ids_growing_within_a_chat) {
+    // arrange
+    std::vector<Message> given{Message(1, 1, "first"), Message(1, 1, "second")};
+    given[0].setID(1000);
+    given[1].setID(2000);
+
+    std::vector<Message> older{Message(1, 1, "too old")};
+    older[0].setID(1500);
+
+    // act
+    size_t saved = store->saveBatch(given);
+    size_t rejected = store->saveBatch(older);
+    auto own = saveMessages(1, 1);
+
+    // assert
+    EXPECT_EQ(saved, 2u);
+    EXPECT_EQ(rejected, 0u);
+    EXPECT_FALSE(older[0].isSavedToDB());
+    EXPECT_EQ(store->findMessage(1, 2000)->getText(), "second");
+    EXPECT_GT(own[0], 2000);
+}
+
+TEST_F(SegmentedLogStoreTest, numbers_messages_per_chat_and_fetches_since_seq) {
+    // arrange
+    LogStoreOptions options;
+    options.segmentBytes = 1024;
+    options.indexInterval = 3;
+    reopen(options);
+    saveMessages(1, 100);
+    saveMessages(2, 5);
+    store.reset();
+
+    // act
+    reopen(options);
+    auto more = saveMessages(1, 1);
+    auto tail = store->fetchSinceSeq(1, 95, 100);
+    auto middle = store->fetchSinceSeq(1, 10, 5);
+    auto found = store->findMessage(1, more[0]);
+
+    // assert
+    EXPECT_EQ(store->lastSeq(1), 101);
+    EXPECT_EQ(store->lastSeq(2), 5);
+    EXPECT_EQ(store->lastSeq(3), 0);
+
+    ASSERT_EQ(tail.size(), 6u);
+    EXPECT_EQ(tail.front().getSeq(), 96);
+    EXPECT_EQ(tail.front().getText(), "message 95");
+    EXPECT_EQ(tail.back().getID(), more[0]);
+
+    ASSERT_EQ(middle.size(), 5u);
+    EXPECT_EQ(middle.front().getSeq(), 11);
+    EXPECT_EQ(middle.back().getSeq(), 15);
+    EXPECT_EQ(found->getSeq(), 101);
+    EXPECT_TRUE(store->fetchSinceSeq(1, 101, 10).empty());
+}
+
+TEST_F(SegmentedLogStoreTest, keeps_given_seqs_growing_within_a_chat) {
+    // arrange
+    std::vector<Message> given{Message(1, 1, "first")};
+    given[0].setSeq(10);
+
+    std::vector<Message> older{Message(1, 1, "too old")};
+    older[0].setSeq(10);
+
+    // act
+    store->saveBatch(given);
+    size_t rejected = store->saveBatch(older);
+    saveMessages(1, 1);
+
+    // assert
+    EXPECT_EQ(rejected, 0u);
+    EXPECT_EQ(store->lastSeq(1), 11);
+    auto since = store->fetchSinceSeq(1, 0, 10);
+    ASSERT_EQ(since.size(), 2u);
+    EXPECT_EQ(since[0].getText(), "first");
+}
+
+TEST_F(SegmentedLogStoreTest, opens_chats_on_first_use_and_keeps_ids_unique) {
+    // arrange
+    auto first = saveMessages(1, 3);
+    auto second = saveMessages(2, 3);
+    reopen();
+    size_t openAfterReopen = openSegments();
+
+    // act
+    auto third = saveMessages(3, 1);
+    std::filesystem::remove(dir / "ids");
+    reopen();
+    auto fourth = saveMessages(4, 1);
+
+    // assert
+    EXPECT_EQ(openAfterReopen, 0u);
+    EXPECT_GT(third[0], second.back());
+    EXPECT_GT(fourth[0], third[0]);
+    EXPECT_EQ(store->lastSeq(1), 3);
+    EXPECT_EQ(store->findMessage(2, second[1])->getText(), "message 1");
+}
+
+TEST_F(SegmentedLogStoreTest, closes_least_recently_used_segments) {
+    // arrange
+    LogStoreOptions options;
+    options.maxOpenFiles = 2;
+    reopen(options);
+
+    // act
+    for (ID_t chatID = 1; chatID <= 5; ++chatID) saveMessages(chatID, 2);
+    size_t openAfterWrites = openSegments();
+    auto history = store->fetchHistory(1, std::numeric_limits<ID_t>::max(), 10);
+    auto more = saveMessages(2, 1);
+    reopen(options);
+
+    // assert
+    EXPECT_EQ(openAfterWrites, 2u);
+    EXPECT_LE(openSegments(), 2u);
+    EXPECT_EQ(history.size(), 2u);
+    EXPECT_EQ(store->lastSeq(2), 3);
+    for (ID_t chatID = 1; chatID <= 5; ++chatID) {
+        EXPECT_EQ(store->fetchSince(chatID, 0, 10).size(), chatID == 2 ? 3u : 2u);
+    }
+    EXPECT_EQ(store->findMessage(2, more[0])->getText(), "message 0");
+}
+
+TEST_F(SegmentedLogStoreTest, keeps_messages_written_before_a_failed_segment_roll) {
+    // arrange
+    LogStoreOptions options;
+    options.segmentBytes = 100;
+    reopen(options);
+
+    /// следующий сегмент не откроется: на его месте каталог
+    auto blocked = dir / "1" / "00000000000000000030.log";
+    std::filesystem::create_directories(blocked);
+    std::vector<Message> messages{Message(1, 1, "first"), Message(1, 1, "second"), Message(1, 1, "third")};
+    for (size_t i = 0; i < messages.size(); ++i) messages[i].setID(10 * (i + 1));
+
+    // act
+    size_t saved = store->saveBatch(messages);
+    std::filesystem::remove(blocked);
+    auto more = saveMessages(1, 1);
+
+    // assert
+    EXPECT_EQ(saved, 2u);
+    EXPECT_TRUE(messages[0].isSavedToDB());
+    EXPECT_TRUE(messages[1].isSavedToDB());
+    EXPECT_FALSE(messages[2].isSavedToDB());
+    EXPECT_EQ(store->findMessage(1, *messages[1].getID())->getText(), "second");
+    EXPECT_EQ(store->lastSeq(1), 3);
+    EXPECT_GT(more[0], *messages[1].getID());
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include "server/recent_messages/recent_messages.hpp"
+#include "message/message.hpp"
+
+#include <string>
+
+static Message numbered(ID_t chatID, int64_t seq) {
+    Message message(chatID, 1, "message " + std::to_string(seq));
+    message.setID(seq * 10);
+    message.setSeq(seq);
+    return message;
+}
+
+TEST(RecentMessagesTest, answers_since_seq_oldest_first) {
+    // arrange
+    RecentMessages recent(16);
+    for (int64_t seq = 1; seq <= 5; ++seq) recent.add(numbered(3, seq));
+
+    // act
+    auto all = recent.since(3, 0, 100);
+    auto tail = recent.since(3, 3, 100);
+    auto limited = recent.since(3, 0, 2);
+    auto nothing = recent.since(3, 5, 100);
+
+    // assert
+    ASSERT_TRUE(all.has_value());
+    ASSERT_EQ(all->size(), 5u);
+    EXPECT_EQ(all->front().getSeq(), 1);
+    ASSERT_EQ(tail->size(), 2u);
+    EXPECT_EQ(tail->front().getText(), "message 4");
+    EXPECT_EQ(limited->size(), 2u);
+    ASSERT_TRUE(nothing.has_value());
+    EXPECT_TRUE(nothing->empty());
+    EXPECT_EQ(recent.lastSeq(3), 5);
+}
+
+TEST(RecentMessagesTest, older_range_and_unknown_chat_go_to_the_store) {
+    // arrange
+    RecentMessages recent(4);
+    for (int64_t seq = 1; seq <= 10; ++seq) recent.add(numbered(3, seq));
+
+    // act
+    auto covered = recent.since(3, 6, 100);
+    auto evicted = recent.since(3, 5, 100);
+
+    // assert
+    ASSERT_TRUE(covered.has_value());
+    EXPECT_EQ(covered->size(), 4u);
+    EXPECT_FALSE(evicted.has_value());
+    EXPECT_FALSE(recent.since(4, 0, 100).has_value());
+    EXPECT_EQ(recent.lastSeq(4), 0);
+}
+
+TEST(RecentMessagesTest, stops_at_a_seq_not_added_yet) {
+    // arrange
+    RecentMessages recent(16);
+    recent.add(numbered(3, 1));
+    recent.add(numbered(3, 3));
+
+    // act
+    auto before = recent.since(3, 0, 100);
+    recent.add(numbered(3, 2));
+    auto after = recent.since(3, 0, 100);
+
+    // assert
+    ASSERT_EQ(before->size(), 1u);
+    EXPECT_EQ(recent.lastSeq(3), 3);
+    ASSERT_EQ(after->size(), 3u);
+    EXPECT_EQ(after->back().getSeq(), 3);
+}
+
+TEST(RecentMessagesTest, drops_the_chat_written_longest_ago) {
+    // arrange
+    /// 64 корзины по одному чату: чаты 1 и 65 делят корзину
+    RecentMessages recent(16, 64);
+    recent.add(numbered(1, 1));
+
+    // act
+    recent.add(numbered(65, 1));
+
+    // assert
+    EXPECT_FALSE(recent.since(1, 0, 10).has_value());
+    EXPECT_TRUE(recent.since(65, 0, 10).has_value());
+}
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include "db/snowflake.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+TEST(SnowflakeGeneratorTest, ids_carry_time_and_node) {
+    // arrange
+    SnowflakeGenerator generator(42);
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+
+    // act
+    ID_t id = generator.next();
+
+    // assert
+    EXPECT_GT(id, 0);
+    EXPECT_EQ(SnowflakeGenerator::nodeOf(id), 42);
+    EXPECT_NEAR(SnowflakeGenerator::timestampOf(id), now, 1000);
+}
+
+TEST(SnowflakeGeneratorTest, ids_grow_past_the_sequence_of_one_millisecond) {
+    // arrange
+    SnowflakeGenerator generator(1);
+    constexpr int Ids_Count = 3 * (SnowflakeGenerator::Max_Sequence + 1);
+
+    // act
+    std::vector<ID_t> ids;
+    for (int i = 0; i < Ids_Count; ++i) ids.push_back(generator.next());
+
+    // assert
+    for (size_t i = 1; i < ids.size(); ++i) {
+        ASSERT_GT(ids[i], ids[i - 1]);
+        ASSERT_EQ(SnowflakeGenerator::nodeOf(ids[i]), 1);
+    }
+}
+
+TEST(SnowflakeGeneratorTest, threads_get_unique_ids) {
+    // arrange
+    constexpr int Threads_Count = 8;
+    constexpr int Ids_Per_Thread = 20000;
+    SnowflakeGenerator generator(3);
+    std::vector<std::vector<ID_t> > ids(Threads_Count);
+
+    // act
+    std::vector<std::thread> threads;
+    for (int t = 0; t < Threads_Count; ++t) {
+        threads.emplace_back([&, t] () {
+            for (int i = 0; i < Ids_Per_Thread; ++i) ids[t].push_back(generator.next());
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    // assert
+    std::unordered_set<ID_t> unique;
+    for (const auto& threadIDs : ids) {
+        EXPECT_TRUE(std::is_sorted(threadIDs.begin(), threadIDs.end()));
+        unique.insert(threadIDs.begin(), threadIDs.end());
+    }
+    EXPECT_EQ(unique.size(), static_cast<size_t>(Threads_Count * Ids_Per_Thread));
+}
+
+TEST(SnowflakeGeneratorTest, nodes_do_not_collide) {
+    // arrange
+    SnowflakeGenerator first(1);
+    SnowflakeGenerator second(2);
+
+    // act
+    std::unordered_set<ID_t> ids;
+    for (int i = 0; i < 10000; ++i) {
+        ids.insert(first.next());
+        ids.insert(second.next());
+    }
+
+    // assert
+    EXPECT_EQ(ids.size(), 20000u);
+    EXPECT_THROW(SnowflakeGenerator(SnowflakeGenerator::Max_Node + 1), std::invalid_argument);
+}
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "exec/task.hpp"
+#include "exec/offload.hpp"
+#include "server/reactor/reactor.hpp"
+
+
+/// поток-"реактор" для тестов: post() копит задачи, drain() выполняет их здесь
+struct ManualHome {
+    std::mutex mtx;
+    std::vector<std::function<void()> > tasks;
+
+    void post(std::function<void()> task) {
+        std::scoped_lock lock(mtx);
+        tasks.emplace_back(std::move(task));
+    }
+
+    bool drain() {
+        std::vector<std::function<void()> > ready;
+        {
+            std::scoped_lock lock(mtx);
+            ready.swap(tasks);
+        }
+        for (auto& task : ready) task();
+        return !ready.empty();
+    }
+};
+
+Task<int> answer() {
+    co_return 42;
+}
+
+Task<int> twice() {
+    int value = co_await answer();
+    co_return value * 2;
+}
+
+Task<void> failing() {
+    throw std::runtime_error("boom");
+    co_return;
+}
+
+TEST(TaskTest, is_lazy_and_returns_value_through_chain) {
+    // arrange
+    Task<int> task = twice();
+
+    // act
+    bool started_early = task.done();
+    task.start();
+
+    // assert
+    EXPECT_FALSE(started_early);
+    ASSERT_TRUE(task.done());
+    EXPECT_EQ(task.result(), 84);
+}
+
+TEST(TaskTest, rethrows_exception_in_awaiting_coroutine) {
+    // arrange
+    bool caught = false;
+    auto outer = [&caught] () -> Task<void> {
+        try {
+            co_await failing();
+        }
+        catch (const std::runtime_error&) {
+            caught = true;
+        }
+    };
+
+    // act
+    Task<void> task = outer();
+    task.start();
+
+    // assert
+    EXPECT_TRUE(task.done());
+    EXPECT_TRUE(caught);
+}
+
+TEST(TaskTest, offload_runs_on_executor_and_resumes_at_home) {
+    // arrange
+    Executor executor(2);
+    ManualHome home;
+    std::thread::id worker_id;
+    std::thread::id resumed_id;
+
+    auto request = [&] () -> Task<int> {
+        int value = co_await offload(executor, home, [&worker_id] () {
+            worker_id = std::this_thread::get_id();
+            return 7;
+        });
+        resumed_id = std::this_thread::get_id();
+        co_return value;
+    };
+
+    // act
+    Task<int> task = request();
+    task.start();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!task.done() && std::chrono::steady_clock::now() < deadline) {
+        if (!home.drain()) std::this_thread::yield();
+    }
+
+    // assert
+    ASSERT_TRUE(task.done());
+    EXPECT_EQ(task.result(), 7);
+    EXPECT_NE(worker_id, std::this_thread::get_id());
+    EXPECT_EQ(resumed_id, std::this_thread::get_id());
+}
+
+TEST(TaskTest, reactor_sleep_resumes_after_delay) {
+    // arrange
+    Reactor reactor;
+    std::thread loop(&Reactor::run, &reactor);
+    std::promise<std::chrono::milliseconds> slept;
+    Task<void> task;
+
+    auto sleeper = [&reactor, &slept] () -> Task<void> {
+        auto begin = std::chrono::steady_clock::now();
+        co_await reactor.sleepFor(std::chrono::milliseconds(150));
+        slept.set_value(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - begin));
+    };
+
+    // act
+    reactor.post([&task, &sleeper] () {
+        task = sleeper();
+        task.start();
+    });
+    auto result = slept.get_future();
+    auto status = result.wait_for(std::chrono::seconds(5));
+
+    reactor.stop();
+    loop.join();
+
+    // assert
+    ASSERT_EQ(status, std::future_status::ready);
+    EXPECT_GE(result.get(), std::chrono::milliseconds(100));
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include "server/reactor/timer_wheel.hpp"
+
+#include <vector>
+
+using namespace std::chrono_literals;
+
+class TimerWheelTest : public ::testing::Test {
+protected:
+    TimerWheel::Clock::time_point start = TimerWheel::Clock::now();
+    TimerWheel wheel{100ms, 8, start};
+};
+
+TEST_F(TimerWheelTest, fires_after_delay) {
+    int fired = 0;
+    wheel.schedule(250ms, [&fired] () { ++fired; }, start);
+
+    wheel.advance(start + 200ms);
+    EXPECT_EQ(fired, 0);
+
+    wheel.advance(start + 300ms);
+    EXPECT_EQ(fired, 1);
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST_F(TimerWheelTest, fires_after_several_rounds) {
+    int fired = 0;
+    wheel.schedule(2000ms, [&fired] () { ++fired; }, start);
+
+    wheel.advance(start + 1900ms);
+    EXPECT_EQ(fired, 0);
+
+    wheel.advance(start + 2000ms);
+    EXPECT_EQ(fired, 1);
+}
+
+TEST_F(TimerWheelTest, cancelled_timer_does_not_fire) {
+    int fired = 0;
+    TimerId id = wheel.schedule(100ms, [&fired] () { ++fired; }, start);
+
+    EXPECT_TRUE(wheel.cancel(id));
+    EXPECT_FALSE(wheel.cancel(id));
+
+    wheel.advance(start + 1s);
+    EXPECT_EQ(fired, 0);
+}
+
+TEST_F(TimerWheelTest, fires_in_deadline_order) {
+    std::vector<int> order;
+    wheel.schedule(300ms, [&order] () { order.push_back(3); }, start);
+    wheel.schedule(100ms, [&order] () { order.push_back(1); }, start);
+    wheel.schedule(200ms, [&order] () { order.push_back(2); }, start);
+
+    wheel.advance(start + 1s);
+
+    EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+}
+
+TEST_F(TimerWheelTest, callback_can_reschedule) {
+    int fired = 0;
+    std::function<void()> tick = [&] () {
+        if (++fired < 3) wheel.schedule(100ms, tick, start);
+    };
+    wheel.schedule(100ms, tick, start);
+
+    wheel.advance(start + 1s);
+
+    EXPECT_EQ(fired, 3);
+}
+
+TEST_F(TimerWheelTest, wait_timeout) {
+    EXPECT_EQ(wheel.waitTimeout(start), -1);
+
+    wheel.schedule(500ms, [] () {}, start);
+
+    EXPECT_EQ(wheel.waitTimeout(start), 100);
+    EXPECT_EQ(wheel.waitTimeout(start + 150ms), 0);
+}
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+
+#include "db/db.hpp"
+#include "db/async_db.hpp"
+#include "db/unread_tracker.hpp"
+#include "chat/chat.hpp"
+#include "usr/user.hpp"
+#include "message/message.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class UnreadTrackerTest : public ::testing::Test {
+protected:
+    std::shared_ptr<DB> db;
+    std::unique_ptr<AsyncDB> async_db;
+    std::vector<User> users;
+    ID_t chatID = 0;
+
+public:
+    void SetUp() override {
+        db = std::make_shared<DB>();
+        DBOptions options;
+        options.migrations = std::string(PROJECT_SOURCE_DIR) + "/assets/sql/migrations";
+        db->init(
+            ":memory:", 
+            std::string(PROJECT_SOURCE_DIR) + "/assets/sql/createDB.sql",
+            options
+        );
+        async_db = std::make_unique<AsyncDB>(db, 2);
+
+        users.emplace_back("Alice", "password1");
+        users.emplace_back("Bob", "password2");
+        for (User& user : users) db->save(user);
+
+        Chat chat(db, users, ChatType::Type::PERSONAL);
+        db->save(chat);
+        chatID = *chat.getID();
+    }
+
+    void TearDown() override {
+        async_db.reset();
+        db.reset();
+    }
+
+    ID_t alice() const { return *users[0].getID(); }
+    ID_t bob() const { return *users[1].getID(); }
+
+    int64_t unreadOf(ID_t userID) {
+        auto chats = db->listChats(userID);
+        return chats.empty() ? -1 : chats.front().unread;
+    }
+};
+
+TEST_F(UnreadTrackerTest, members_of_a_new_chat_get_counters) {
+    // act
+    auto chats = db->listChats(alice());
+
+    // assert
+    ASSERT_EQ(chats.size(), 1u);
+    EXPECT_EQ(chats[0].chatID, chatID);
+    EXPECT_EQ(chats[0].title, "Bob");
+    EXPECT_EQ(chats[0].unread, 0);
+}
+
+TEST_F(UnreadTrackerTest, counts_messages_of_others_and_clears_them_on_read) {
+    // arrange
+    std::vector<UnreadIncrement> posted{UnreadIncrement{chatID, alice(), {1, 2, 3}}};
+    std::vector<ReadReceipt> partial{ReadReceipt{bob(), chatID, 1}};
+    std::vector<ReadReceipt> all{ReadReceipt{bob(), chatID, 3}};
+
+    // act
+    db->updateUnread(posted, {});
+    int64_t before = unreadOf(bob());
+    db->updateUnread({}, partial);
+    int64_t afterPartial = unreadOf(bob());
+    db->updateUnread({}, all);
+
+    // assert
+    EXPECT_EQ(before, 3);
+    EXPECT_EQ(afterPartial, 2);
+    EXPECT_EQ(unreadOf(bob()), 0);
+    EXPECT_EQ(unreadOf(alice()), 0);
+}
+
+TEST_F(UnreadTrackerTest, receipt_before_the_message_is_not_undone) {
+    // arrange
+    std::vector<ReadReceipt> reads{ReadReceipt{bob(), chatID, 2}};
+    std::vector<UnreadIncrement> posted{UnreadIncrement{chatID, alice(), {1, 2, 3}}};
+
+    // act
+    db->updateUnread({}, reads);
+    db->updateUnread(posted, {});
+
+    // assert
+    EXPECT_EQ(unreadOf(bob()), 1);
+}
+
+TEST_F(UnreadTrackerTest, read_marks_the_range_of_others_messages) {
+    // arrange
+    for (int i = 0; i < 3; ++i) {
+        Message message(chatID, i == 1 ? bob() : alice(), "message " + std::to_string(i));
+        db->save(message);
+    }
+    std::vector<ReadReceipt> reads{ReadReceipt{bob(), chatID, 2}};
+
+    // act
+    db->updateUnread({}, reads);
+    auto marked = db->query<int64_t, int64_t>(
+        "SELECT seq, is_read FROM MessagesHistory WHERE chat_id = ? ORDER BY seq", chatID
+    );
+
+    // assert
+    ASSERT_EQ(marked.size(), 3u);
+    EXPECT_EQ(std::get<1>(marked[0]), 1);
+    EXPECT_EQ(std::get<1>(marked[1]), 0); // своё сообщение
+    EXPECT_EQ(std::get<1>(marked[2]), 0);
+}
+
+TEST_F(UnreadTrackerTest, coalesces_receipts_and_applies_them_on_flush) {
+    // arrange
+    auto tracker = std::make_unique<UnreadTracker>(*async_db);
+    for (int64_t seq = 1; seq <= 100; ++seq) tracker->posted(chatID, alice(), seq);
+
+    // act
+    for (int64_t seq = 1; seq <= 60; ++seq) tracker->read(bob(), chatID, seq);
+    async_db->submit([&] (DB& db) { tracker->flush(db); }).get();
+    int64_t flushed = unreadOf(bob());
+
+    tracker->posted(chatID, bob(), 101);
+    tracker.reset();
+
+    // assert
+    EXPECT_EQ(flushed, 40);
+    EXPECT_EQ(unreadOf(bob()), 0);
+    EXPECT_EQ(unreadOf(alice()), 1);
+}
+
+TEST_F(UnreadTrackerTest, flush_waits_for_the_timer_and_takes_the_whole_burst) {
+    // arrange
+    std::vector<std::function<void()> > timers;
+    auto tracker = std::make_unique<UnreadTracker>(*async_db, std::chrono::milliseconds(20), 
+        [&timers] (std::chrono::milliseconds, std::function<void()> callback) {
+            timers.push_back(std::move(callback));
+        }
+    );
+
+    // act
+    for (int64_t seq = 1; seq <= 30; ++seq) tracker->posted(chatID, alice(), seq);
+    tracker->read(bob(), chatID, 10);
+    int64_t beforeTimer = unreadOf(bob());
+
+    timers.front()();
+    for (int attempt = 0; attempt < 100 && unreadOf(bob()) != 20; ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // assert
+    EXPECT_EQ(timers.size(), 1u);
+    EXPECT_EQ(beforeTimer, 0);
+    EXPECT_EQ(unreadOf(bob()), 20);
+}
+
+TEST_F(UnreadTrackerTest, chat_list_query_uses_the_primary_key) {
+    // arrange
+    std::string plan;
+
+    // act
+    db->executeWithCallback([&plan] (sqlite3_stmt* stmt) {
+        plan += reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        plan += '\n';
+        return true;
+    }, 
+        "EXPLAIN QUERY PLAN SELECT u.chat_id, u.unread FROM UnreadCounters u "
+        "JOIN Chat c ON c.id = u.chat_id WHERE u.user_id = ? ORDER BY u.chat_id ASC", 
+        ID_t{1}
+    );
+
+    // assert
+    EXPECT_NE(plan.find("USING PRIMARY KEY (user_id=?)"), std::string::npos) << plan;
+    EXPECT_EQ(plan.find("TEMP B-TREE"), std::string::npos) << plan;
+}